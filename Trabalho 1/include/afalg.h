@@ -0,0 +1,11 @@
+#ifndef AFALG_H
+#define AFALG_H
+
+#include <stddef.h>
+#include "digest.h"
+
+int afAlgAvailable(void);
+
+int afAlgHashFile(const char *path, const int *algorithms, size_t count, char hex[][DIGEST_MAX_HEX_LEN + 1]);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <sys/stat.h>
+#include "pipeline.h"
+
+// Separador entre o caminho do arquivo e o do membro nos caminhos virtuais ("arquivo.tar!/dir/ficheiro")
+#define ARCHIVE_MEMBER_SEPARATOR "!/"
+
+typedef struct
+{
+    const char *name;     // Caminho do membro dentro do arquivo
+    struct stat stat;     // Tamanho, permissões e datas do membro (as que o formato guarda)
+} ArchiveMember;
+
+// Chamada para cada ficheiro regular do arquivo, com os dados do membro em source. -1 para parar.
+typedef int (*ArchiveVisitor)(void *context, const ArchiveMember *member, PipelineSource *source);
+
+int walkArchive(const char *path, ArchiveVisitor visitor, void *context);
+
+#endif
\ No newline at end of file
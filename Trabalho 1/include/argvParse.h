@@ -3,6 +3,6 @@
 
 #include "flags.h"
 
-int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, char **outputFileName, char **targetLocation);
+int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, char **outputFileName, int **targetArgs, int *targetCount);
 
 #endif
\ No newline at end of file
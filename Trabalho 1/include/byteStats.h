@@ -0,0 +1,22 @@
+#ifndef BYTESTATS_H
+#define BYTESTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Histograma dos bytes de um ficheiro, para a entropia e a proporção de caracteres imprimíveis
+typedef struct
+{
+    uint64_t counts[256];
+    uint64_t total;
+} ByteStats;
+
+void initByteStats(ByteStats *stats);
+
+void consumeByteStats(void *context, const unsigned char *data, size_t length);
+
+double byteStatsEntropy(const ByteStats *stats);
+
+double byteStatsPrintableRatio(const ByteStats *stats);
+
+#endif
\ No newline at end of file
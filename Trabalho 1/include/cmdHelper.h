@@ -1,8 +1,14 @@
 #ifndef CMDHELPER_H
 #define CMDHELPER_H
 
+#include <stddef.h>
+
 int runCmd(char *cmdArgv[], int cmdArgc);
 int routeCmd(char *cmdArgv[], int *PIPEREAD_FILENO);
+int routeCmdInput(char *cmdArgv[], const void *input, size_t length, int *PIPEREAD_FILENO);
 int readRoutedCmdOutput(char **buffer, int PIPEREAD_FILENO);
+int runReportingCmd(char *cmdArgv[], int cmdArgc, char **report);
+int sendReport(const char *report);
+int isReportingChild(void);
 
 #endif
\ No newline at end of file
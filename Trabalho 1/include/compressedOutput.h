@@ -0,0 +1,32 @@
+#ifndef COMPRESSEDOUTPUT_H
+#define COMPRESSEDOUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Formato do output comprimido ("-z"): uma sequência de blocos independentes, cada um com um cabeçalho
+ * de 16 bytes ("FZB1", tamanho original, tamanho guardado e FNV-1a do original) seguido dos dados.
+ * Guardado == original indica um bloco não comprimido. Os blocos terminam sempre no fim de uma linha, por
+ * isso os blocos de vários processos podem ser acrescentados ao mesmo ficheiro, e os tamanhos permitem
+ * saltar de bloco em bloco sem descomprimir.
+ */
+#define FRAME_MAGIC "FZB1"
+#define FRAME_HEADER_SIZE 16
+#define FRAME_BLOCK_SIZE (256 << 10)
+
+typedef struct
+{
+    uint32_t rawLength;
+    uint32_t storedLength;
+    uint32_t checksum;
+} FrameHeader;
+
+FILE *openCompressedOutput(const char *path);
+
+int parseFrameHeader(const unsigned char *data, size_t available, FrameHeader *header);
+
+int decodeFrame(const FrameHeader *header, const unsigned char *payload, unsigned char *output);
+
+#endif
\ No newline at end of file
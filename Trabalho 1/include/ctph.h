@@ -0,0 +1,59 @@
+#ifndef CTPH_H
+#define CTPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sumário por partes desencadeadas pelo contexto (CTPH, como o ssdeep): "tamanho:parte1:parte2", em que
+ * cada carácter resume um pedaço do ficheiro cujo fim é escolhido pelo hash rolante dos últimos 7 bytes.
+ * A parte 1 usa pedaços de "tamanho" bytes (em média) e a parte 2 o dobro.
+ */
+#define CTPH_SPAMSUM_LENGTH 64
+#define CTPH_NUM_BLOCKHASHES 31
+#define CTPH_ROLLING_WINDOW 7
+#define CTPH_MAX_RESULT (2 * CTPH_SPAMSUM_LENGTH + 20)
+
+typedef struct
+{
+    uint32_t h;
+    uint32_t halfh;
+    char digest[CTPH_SPAMSUM_LENGTH];
+    char halfdigest;
+    unsigned int dlen;
+} CtphBlockHash;
+
+// Estado do cálculo, alimentado pela leitura dos sumários
+typedef struct
+{
+    unsigned int bhstart;
+    unsigned int bhend;
+    CtphBlockHash bh[CTPH_NUM_BLOCKHASHES];
+    uint64_t totalSize;
+
+    unsigned char window[CTPH_ROLLING_WINDOW];
+    uint32_t h1, h2, h3;
+    uint32_t n;
+} CtphState;
+
+// Sumário lido de texto, com as repetições de mais de 3 caracteres iguais já removidas (para comparar)
+typedef struct
+{
+    uint32_t blockSize;
+    char part1[CTPH_SPAMSUM_LENGTH + 1];
+    char part2[CTPH_SPAMSUM_LENGTH + 1];
+    size_t length1;
+    size_t length2;
+} CtphDigest;
+
+void initCtph(CtphState *state);
+
+void consumeCtph(void *context, const unsigned char *data, size_t length);
+
+void ctphResult(const CtphState *state, char result[CTPH_MAX_RESULT]);
+
+int parseCtph(const char *text, size_t length, CtphDigest *digest);
+
+int compareCtph(const CtphDigest *a, const CtphDigest *b);
+
+#endif
\ No newline at end of file
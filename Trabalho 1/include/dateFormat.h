@@ -0,0 +1,8 @@
+#ifndef DATEFORMAT_H
+#define DATEFORMAT_H
+
+#include <time.h>
+
+int GetFormattedDate(struct tm *ts, char **formattedDate);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Algoritmos de sumário criptográfico suportados
+#define DIGEST_MD5 0
+#define DIGEST_SHA1 1
+#define DIGEST_SHA256 2
+#define DIGEST_COUNT 3
+
+// Sumários calculados numa única leitura: os pedidos mais o do conteúdo
+#define DIGEST_MAX_PER_FILE (DIGEST_COUNT + 1)
+
+// Maior sumário em hexadecimal (SHA-256), sem o terminador
+#define DIGEST_MAX_HEX_LEN 64
+
+typedef struct
+{
+    int algorithm;
+    uint64_t length;        // Bytes processados
+    unsigned char block[64]; // Bloco parcial ainda por processar
+    size_t blockUsed;
+    uint32_t state[8];
+} DigestCtx;
+
+int digestFromName(const char *name);
+
+const char *digestName(int algorithm);
+
+void digestInit(DigestCtx *ctx, int algorithm);
+
+void digestUpdate(DigestCtx *ctx, const void *data, size_t length);
+
+void digestFinalHex(DigestCtx *ctx, char hex[DIGEST_MAX_HEX_LEN + 1]);
+
+#endif
\ No newline at end of file
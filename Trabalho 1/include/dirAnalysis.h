@@ -2,7 +2,9 @@
 #define DIRANALYSIS_H
 
 #include <stdio.h>
+#include "flags.h"
+#include "summary.h"
 
-int analyseDir(char *cmdArgv[], int cmdArgc, char *hashFunctions, FILE *outputFile, char *targetLocation);
+int analyseDir(char *cmdArgv[], int cmdArgc, Flags *flags, Summary *summary, char *hashFunctions, FILE *outputFile, char *targetLocation, char *merkleDigest);
 
 #endif
\ No newline at end of file
@@ -3,19 +3,30 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <sys/stat.h>
+#include "dateFormat.h"
+#include "flags.h"
+#include "pipeline.h"
+#include "summary.h"
 
-int checkPathType(const char *path);
+// Máximo de análises feitas na mesma leitura que os sumários (incluindo o sumário "ctph" e o tipo dos membros de arquivos)
+#define FILE_ANALYSIS_MAX_STAGES 5
+
+// Bytes do início de um membro de arquivo passados ao comando "file"
+#define FILE_TYPE_SAMPLE (64 << 10)
 
-int GetFormattedDate(struct tm *ts, char **formattedDate);
+int checkPathType(const char *path);
 
 int getFileCmdInfo(char **buffer, char *targetLocation);
 
 int getStatCmdInfo(char **buffer, char *targetLocation);
 
-int calculateHash(char **buffer, char *hashCmd, char *targetLocation);
+int processHashes(char **buffer, Flags *flags, char *hashFunctions, char *targetLocation, PipelineSource *source,
+                  char *contentDigest, const PipelineStage *extraStages, size_t extraCount);
 
-int processHashes(char **buffer, char *hashFunctions, char *targetLocation);
+int analyseFile(Flags *flags, char *hashFunctions, FILE *outputFile, char *targetLocation, const struct stat *fileStat,
+                char *contentDigest);
 
-int analyseFile(char *hashFunctions, FILE *outputFile, char *targetLocation);
+int summariseFile(Summary *summary, const struct stat *fileStat, char *targetLocation);
 
 #endif
\ No newline at end of file
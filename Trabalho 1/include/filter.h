@@ -0,0 +1,50 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Tipos de entrada aceites por "--type"
+#define FILTER_TYPE_FILE 0x1 // 'f' - ficheiro regular
+#define FILTER_TYPE_LINK 0x2 // 'l' - ligação simbólica para ficheiro regular
+
+typedef struct GlobDFA GlobDFA;
+
+typedef struct
+{
+    // Globs lidos dos argumentos, compilados em DFA por compileFilter()
+    char **includeGlobs;
+    size_t includeCount;
+    char **excludeGlobs;
+    size_t excludeCount;
+    GlobDFA *include;
+    GlobDFA *exclude;
+
+    // Predicados sobre os metadados (-1 / 0 quando não usados)
+    off_t minSize;
+    off_t maxSize;
+    time_t newerThan;
+    time_t olderThan;
+    unsigned int types;
+} Filter;
+
+void initFilter(Filter *filter);
+
+int addFilterGlob(Filter *filter, int exclude, const char *glob);
+
+int parseFilterSize(off_t *size, const char *arg);
+
+int parseFilterDate(time_t *date, const char *arg);
+
+int parseFilterTypes(unsigned int *types, const char *arg);
+
+int compileFilter(Filter *filter);
+
+int filterExcludes(const Filter *filter, const char *path);
+
+int filterAccepts(const Filter *filter, const char *path, const struct stat *fileStat, int isLink);
+
+void freeFilter(Filter *filter);
+
+#endif
\ No newline at end of file
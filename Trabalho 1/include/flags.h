@@ -1,12 +1,53 @@
 #ifndef FLAGS_H
 #define FLAGS_H
 
+#include <stdint.h>
+#include "filter.h"
+#include "hashSet.h"
+#include "signatures.h"
+
+// Ordem pela qual as entradas de um diretório são processadas
+#define ORDER_READDIR 0 // Ordem devolvida pelo readdir()
+#define ORDER_INODE 1   // Ordenar pelo número do inode
+#define ORDER_EXTENT 2  // Ordenar pelo primeiro extent físico (FIEMAP)
+
+// Implementação usada para calcular os sumários
+#define HASH_BACKEND_USER 0   // No próprio processo
+#define HASH_BACKEND_AF_ALG 1 // Crypto API do kernel (AF_ALG), com splice()
+
 typedef struct
 {
     unsigned int targetIsFolder : 1;
     unsigned int calculateHash : 1;
     unsigned int writeToFile : 1;
     unsigned int logExecution : 1;
+    unsigned int traversalOrder : 2;
+    unsigned int summaryMode : 1;
+    unsigned int hashBackend : 1;
+    unsigned int merkleDigests : 1;
+    unsigned int entropyAnalysis : 1;
+    unsigned int timelineMode : 1;
+    unsigned int compressOutput : 1;
+    unsigned int skipKnown : 1;
+    unsigned int intoArchives : 1;
+    unsigned int unorderedOutput : 1; // Com "-j" ou "--shards", escrever o output pela ordem em que termina
+    unsigned int summaryTopN;
+    unsigned int jobs; // Threads de análise de ficheiros por processo ("-j")
+    unsigned int similarMinScore; // Pontuação mínima das semelhanças de "--similar"
+    unsigned int minJobs;      // Limite inferior da concorrência adaptativa com "-j"
+    unsigned int maxOpenFiles; // Descritores para os ficheiros em análise, 0 para usar o RLIMIT_NOFILE
+    size_t maxBufferMemory;    // Memória dos buffers de leitura dos ficheiros em análise
+    uint64_t maxReadRate;      // Bytes lidos por segundo por toda a análise, 0 sem limite
+    unsigned int maxIops;      // Leituras por segundo por toda a análise, 0 sem limite
+    unsigned int maxCpu;       // Percentagem de um core usada por cada thread de sumários
+    unsigned int shards;       // Processos de análise com "--shards", 0 para a análise por diretório
+    char *indexPath;         // Índice a escrever com "--index", NULL se não for pedido
+    char *verifyPath;        // Índice a verificar com "--verify", NULL se não for pedido
+    char *similarPath;       // Output de referência de "--similar", NULL se não for pedido
+    char *profilePath;       // Relatório de "--profile", NULL se não for pedido
+    Signatures *signatures; // Assinaturas de "--signatures", NULL se não forem pedidas
+    HashSet *knownFiles;    // Conjunto de "--known", NULL se não for pedido
+    Filter filter;
 } Flags;
 
 
@@ -0,0 +1,65 @@
+#ifndef HASHSET_H
+#define HASHSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "digest.h"
+
+/*
+ * Conjunto de sumários de ficheiros conhecidos (estilo NSRL) para "--known", escrito por forensic-hashset:
+ *   cabeçalho (inteiros em little-endian) | filtro de Bloom | sumários ordenados
+ * Todos os sumários têm o mesmo tamanho (MD5, SHA-1 ou SHA-256). O filtro de Bloom tem blocos de 64 bytes
+ * (uma linha de cache): cada sumário marca HASHSET_BLOOM_PROBES bits num único bloco.
+ */
+#define HASHSET_MAGIC "FRNSHSH1"
+#define HASHSET_VERSION 1
+#define HASHSET_BLOOM_BLOCK 64
+#define HASHSET_BLOOM_PROBES 7
+#define HASHSET_BLOOM_BITS_PER_DIGEST 10
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t digestLength;
+    uint64_t digestCount;
+    uint64_t bloomOffset;
+    uint64_t bloomBlocks;
+    uint64_t tableOffset;
+    uint64_t reserved[2];
+} HashSetHeader;
+
+// Conjunto aberto com mmap(), partilhado (pela page cache) por todos os processos da análise
+typedef struct
+{
+    const unsigned char *base;
+    size_t size;
+    HashSetHeader header; // Já na ordem de bytes da máquina
+    const unsigned char *bloom;
+    const unsigned char *table;
+    int algorithm;
+} HashSet;
+
+// Verificação de um ficheiro, alimentada pela leitura dos sumários
+typedef struct
+{
+    const HashSet *set;
+    DigestCtx digest;
+} KnownCheck;
+
+int buildHashSet(FILE *input, const char *path, size_t *count, size_t *rejected);
+
+HashSet *openHashSet(const char *path);
+
+void closeHashSet(HashSet *set);
+
+int hashSetContains(const HashSet *set, const unsigned char *digest);
+
+void initKnownCheck(KnownCheck *check, const HashSet *set);
+
+void consumeKnownCheck(void *context, const unsigned char *data, size_t length);
+
+int knownCheckMatches(KnownCheck *check);
+
+#endif
\ No newline at end of file
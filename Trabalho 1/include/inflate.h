@@ -0,0 +1,59 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define INFLATE_WINDOW_SIZE 32768
+#define INFLATE_INPUT_SIZE (64 << 10)
+#define INFLATE_FAST_BITS 10
+
+// Tabela de um código de Huffman canónico: consulta direta dos códigos até INFLATE_FAST_BITS bits
+typedef struct
+{
+    uint16_t count[16];
+    uint16_t symbol[288];
+    uint16_t fast[1 << INFLATE_FAST_BITS]; // Símbolo << 4 | comprimento, 0 se o código for mais longo
+} InflateHuffman;
+
+/*
+ * Descompressão de um stream deflate (RFC 1951) à medida que o output é pedido, com memória fixa:
+ * a janela de 32 KiB, um buffer de input e as tabelas do bloco atual.
+ */
+typedef struct
+{
+    ssize_t (*read)(void *context, unsigned char *buffer, size_t size);
+    void *context;
+
+    unsigned char input[INFLATE_INPUT_SIZE];
+    size_t inputPos;
+    size_t inputLength;
+    int inputEnded;
+
+    uint64_t bitBuffer;
+    unsigned int bitCount;
+    unsigned int padBits; // Bits a 0 acrescentados depois do fim do input
+
+    unsigned char window[INFLATE_WINDOW_SIZE];
+    uint64_t total;
+
+    int inBlock;    // Dentro de um bloco comprimido com Huffman
+    int finalBlock; // O bloco atual é o último
+    int finished;
+    size_t storedRemaining;
+    size_t copyLength;
+    size_t copyDistance;
+    InflateHuffman literals;
+    InflateHuffman distances;
+} Inflater;
+
+void initInflater(Inflater *inflater, ssize_t (*read)(void *context, unsigned char *buffer, size_t size), void *context);
+
+void restartInflater(Inflater *inflater);
+
+ssize_t inflateRead(Inflater *inflater, unsigned char *buffer, size_t size);
+
+ssize_t inflateTakeBytes(Inflater *inflater, unsigned char *buffer, size_t size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef IOGOVERNOR_H
+#define IOGOVERNOR_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Descritores abertos por cada ficheiro em análise (o ficheiro e o pipe do comando "file")
+#define IO_GOVERNOR_FDS_PER_FILE 4
+
+// Memória de leitura por omissão para todos os ficheiros em análise ao mesmo tempo
+#define IO_GOVERNOR_DEFAULT_MEMORY (256UL << 20)
+
+/*
+ * Limite adaptativo (AIMD) do número de ficheiros lidos ao mesmo tempo, entre um mínimo e um máximo. Em cada
+ * intervalo são medidos o débito e a latência por byte: enquanto a latência não cresce o limite sobe (a dobrar
+ * até ao primeiro sinal de saturação, depois de um em um), quando cresce sem ganho de débito o limite desce
+ * para metade. Os limites de descritores e de memória dos buffers aplicam-se sempre.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+
+    unsigned int minLimit;
+    unsigned int maxLimit;
+    unsigned int limit;
+    int slowStart;
+
+    unsigned int inFlight;
+    unsigned int fileCap; // Pelo limite de descritores
+    size_t memoryCap;
+    size_t memoryInUse;
+
+    // Medições do intervalo atual
+    struct timespec intervalStart;
+    uint64_t intervalBytes;
+    uint64_t intervalFiles;
+    double intervalLatency;
+    double lastThroughput;
+    double baseCost; // Menor latência por byte observada
+} IoGovernor;
+
+void initIoGovernor(IoGovernor *governor, unsigned int minLimit, unsigned int maxLimit, unsigned int maxOpenFiles, size_t memoryCap);
+
+void acquireIoSlot(IoGovernor *governor, size_t memory);
+
+void releaseIoSlot(IoGovernor *governor, size_t memory, uint64_t bytes, double latency);
+
+void destroyIoGovernor(IoGovernor *governor);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+// Tamanho máximo do resultado de lzCompress() para dados que não comprimem
+#define LZ_COMPRESS_BOUND(length) ((length) + (length) / 255 + 16)
+
+size_t lzCompress(const unsigned char *src, size_t srcLength, unsigned char *dst, size_t dstCapacity);
+
+long lzDecompress(const unsigned char *src, size_t srcLength, unsigned char *dst, size_t dstCapacity);
+
+#endif
\ No newline at end of file
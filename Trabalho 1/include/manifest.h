@@ -0,0 +1,100 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "digest.h"
+
+// Maior sumário em bytes (SHA-256)
+#define MANIFEST_DIGEST_BYTES (DIGEST_MAX_HEX_LEN / 2)
+
+// Metadados de um ficheiro guardados no índice
+typedef struct
+{
+    const char *path;
+    const char *fileType;
+    uint64_t size;
+    uint32_t mode;
+    int64_t atime;
+    int64_t ctime;
+    int64_t mtime;
+    size_t digestCount;
+    unsigned char digestLength[DIGEST_MAX_PER_FILE];
+    unsigned char digests[DIGEST_MAX_PER_FILE][MANIFEST_DIGEST_BYTES];
+} ManifestRecord;
+
+/*
+ * Formato do índice (inteiros na ordem de bytes da máquina):
+ *   cabeçalho | blocos de dados | primeiras chaves dos blocos | índice de blocos | índice de sumários
+ * Os blocos têm os registos ordenados pelo caminho, com o prefixo comum à chave anterior omitido e os
+ * valores em varint. O índice de sumários está ordenado por (tamanho, sumário) e aponta para o registo.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t recordCount;
+    uint64_t blockCount;
+    uint64_t blockIndexOffset;
+    uint64_t digestCount;
+    uint64_t digestIndexOffset;
+    uint64_t reserved;
+} ManifestHeader;
+
+typedef struct
+{
+    uint64_t offset;
+    uint64_t keyOffset;
+    uint32_t length;
+    uint32_t keyLength;
+    uint32_t entryCount;
+    uint32_t reserved;
+} ManifestBlock;
+
+typedef struct
+{
+    unsigned char digest[MANIFEST_DIGEST_BYTES];
+    uint32_t block;
+    uint16_t entry;
+    uint8_t length;
+    uint8_t reserved;
+} ManifestDigest;
+
+// Índice aberto para leitura com mmap()
+typedef struct
+{
+    const unsigned char *base;
+    size_t size;
+    const ManifestHeader *header;
+    const ManifestBlock *blocks;
+    const ManifestDigest *digests;
+} Manifest;
+
+typedef void (*ManifestVisitor)(const ManifestRecord *record, void *context);
+
+int openManifestLog(const char *indexPath);
+
+int appendManifestRecord(const ManifestRecord *record);
+
+int writeManifestRecords(const void *records, size_t length);
+
+void captureManifestRecords(void);
+
+unsigned char *takeManifestRecords(size_t *length);
+
+int buildManifest(const char *indexPath);
+
+int parseManifestDigest(const char *hex, unsigned char digest[MANIFEST_DIGEST_BYTES]);
+
+int openManifest(Manifest *manifest, const char *path);
+
+int findManifestPath(const Manifest *manifest, const char *path, ManifestVisitor visit, void *context);
+
+int scanManifestPrefix(const Manifest *manifest, const char *prefix, ManifestVisitor visit, void *context);
+
+int findManifestDigest(const Manifest *manifest, const unsigned char *digest, size_t length, ManifestVisitor visit, void *context);
+
+void closeManifest(Manifest *manifest);
+
+#endif
\ No newline at end of file
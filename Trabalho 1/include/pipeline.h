@@ -0,0 +1,29 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Consumidor dos blocos lidos de um ficheiro (sumário, ...), sempre chamado pela ordem do ficheiro
+typedef struct
+{
+    void (*consume)(void *context, const unsigned char *data, size_t length);
+    void *context;
+} PipelineStage;
+
+// Origem dos dados lidos (ficheiro, membro de um arquivo, ...). read() devolve 0 no fim.
+typedef struct
+{
+    ssize_t (*read)(void *context, unsigned char *buffer, size_t size);
+    void *context;
+    uint64_t size; // Tamanho esperado, UINT64_MAX se não for conhecido
+} PipelineSource;
+
+int runReadPipeline(const char *path, PipelineStage *stages, size_t stageCount);
+
+int runSourcePipeline(PipelineSource *source, PipelineStage *stages, size_t stageCount);
+
+size_t readPipelineFootprint(uint64_t fileSize);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <time.h>
+
+// Etapas da análise medidas com "--profile"
+typedef enum
+{
+    PROFILE_READDIR, // Cada readdir()
+    PROFILE_STAT,    // Metadados (stat/lstat)
+    PROFILE_TYPE,    // Deteção do tipo (comando "file")
+    PROFILE_HASH,    // Leitura do conteúdo: sumários e restantes análises da mesma leitura
+    PROFILE_OUTPUT,  // Escrita da linha de cada ficheiro (no output ou, com -j ou --shards, no buffer de reordenação)
+    PROFILE_STAGES
+} ProfileStage;
+
+int openProfile(const char *reportPath);
+
+void forkProfile(void);
+
+void profileStart(struct timespec *start);
+
+void profileEnd(ProfileStage stage, const struct timespec *start);
+
+unsigned char *takeProfile(size_t *length);
+
+int addProfile(const unsigned char *record, size_t length);
+
+int closeProfile(void);
+
+void discardProfile(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <stdio.h>
+#include "flags.h"
+
+int runShards(Flags *flags, char *hashFunctions, FILE *outputFile, char *targets[], int targetCount);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Automato de Aho-Corasick com as assinaturas de "--signatures"
+typedef struct Signatures Signatures;
+
+// Pesquisa das assinaturas num ficheiro, alimentada pela leitura dos sumários
+typedef struct
+{
+    const Signatures *signatures;
+    uint32_t state;
+    unsigned char *matched; // Conjunto (bits) das regras já encontradas
+    size_t matchCount;
+} SignatureScan;
+
+Signatures *loadSignatures(const char *path);
+
+void freeSignatures(Signatures *signatures);
+
+int initSignatureScan(SignatureScan *scan, const Signatures *signatures);
+
+void consumeSignatureScan(void *context, const unsigned char *data, size_t length);
+
+char *signatureMatches(const SignatureScan *scan);
+
+void freeSignatureScan(SignatureScan *scan);
+
+#endif
\ No newline at end of file
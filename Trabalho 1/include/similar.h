@@ -0,0 +1,8 @@
+#ifndef SIMILAR_H
+#define SIMILAR_H
+
+#include <stdio.h>
+
+int findSimilar(const char *referencePath, const char *manifestPath, unsigned int minScore, FILE *outputFile);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+// Intervalos do histograma de idades (data de modificação)
+#define SUMMARY_AGE_BUCKETS 6
+
+typedef struct
+{
+    char *key;
+    unsigned long long files;
+    unsigned long long bytes;
+} SummaryBucket;
+
+// Tabela de dispersão (endereçamento aberto) de chave -> contadores
+typedef struct
+{
+    SummaryBucket *buckets;
+    size_t capacity;
+    size_t count;
+} SummaryMap;
+
+typedef struct
+{
+    char *path;
+    off_t size;
+} SummaryFile;
+
+typedef struct
+{
+    unsigned long long files;
+    unsigned long long bytes;
+    SummaryMap byType;
+    SummaryMap byTopDir;
+    SummaryMap byExtension;
+    unsigned long long ageHistogram[SUMMARY_AGE_BUCKETS];
+
+    // Min-heap com os topN maiores ficheiros
+    SummaryFile *largest;
+    size_t largestCount;
+    size_t topN;
+} Summary;
+
+int initSummary(Summary *summary, size_t topN);
+
+int addToSummary(Summary *summary, const char *path, const char *fileType, const struct stat *fileStat);
+
+int mergeSummary(Summary *summary, const Summary *other, const char *topDir);
+
+char *serializeSummary(const Summary *summary);
+
+int parseSummary(Summary *summary, const char *buffer);
+
+void printSummary(const Summary *summary, FILE *outputFile);
+
+void freeSummary(Summary *summary);
+
+#endif
\ No newline at end of file
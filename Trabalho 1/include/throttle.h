@@ -0,0 +1,20 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Sinais para abrandar (limites a metade) e acelerar (limites a dobrar) uma análise em curso
+#define THROTTLE_SLOWER_SIGNAL (SIGRTMIN)
+#define THROTTLE_FASTER_SIGNAL (SIGRTMIN + 1)
+
+int openThrottle(uint64_t readRate, unsigned int iops, unsigned int cpuPercent);
+
+void throttleRead(size_t bytes);
+
+void throttleCpu(const struct timespec *cpuStart);
+
+void closeThrottle(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+int openTimelineLog(void);
+
+int addTimelineEvents(const char *path, const struct stat *fileStat);
+
+int writeTimelineEvents(const void *events, size_t length);
+
+void captureTimelineEvents(void);
+
+unsigned char *takeTimelineEvents(size_t *length);
+
+int writeTimeline(FILE *outputFile);
+
+void discardTimeline(void);
+
+#endif
\ No newline at end of file
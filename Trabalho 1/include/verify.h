@@ -0,0 +1,9 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdio.h>
+#include "filter.h"
+
+int verifyManifest(const char *indexPath, char *targetLocation, const Filter *filter, unsigned int jobs, FILE *outputFile);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+#define _GNU_SOURCE // splice, tee, F_SETPIPE_SZ
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/if_alg.h>
+#include <sys/socket.h>
+#include "afalg.h"
+#include "throttle.h"
+
+// Tamanho pedido para os pipes intermédios (o kernel pode dar menos)
+#define AFALG_PIPE_SIZE (1 << 20)
+
+// Nomes dos algoritmos na crypto API do kernel e tamanho do sumário em bytes
+static const char *KERNEL_NAMES[DIGEST_COUNT] = {"md5", "sha1", "sha256"};
+static const size_t DIGEST_BYTES[DIGEST_COUNT] = {16, 20, 32};
+
+// Posto a 1 (por qualquer thread, uma única vez) quando o kernel não tem AF_ALG ou um dos algoritmos
+static int unavailable = 0;
+
+int afAlgAvailable(void)
+{
+    return !__atomic_load_n(&unavailable, __ATOMIC_RELAXED);
+}
+
+// Só a falta de suporte no kernel desliga o AF_ALG no processo; avisar apenas da primeira vez.
+static void markUnavailable(void)
+{
+    int error = errno;
+    if (__atomic_exchange_n(&unavailable, 1, __ATOMIC_RELAXED) == 0)
+    {
+        errno = error;
+        perror("AF_ALG hash error, using userspace hashes");
+    }
+}
+
+// Abrir um socket de operação AF_ALG para o algoritmo. -1 se o kernel não o suportar.
+static int openAlgSocket(int algorithm)
+{
+    struct sockaddr_alg address;
+    memset(&address, 0, sizeof(address));
+    address.salg_family = AF_ALG;
+    strcpy((char *)address.salg_type, "hash");
+    strcpy((char *)address.salg_name, KERNEL_NAMES[algorithm]);
+
+    int tfm = socket(AF_ALG, SOCK_SEQPACKET, 0);
+    if (tfm == -1)
+    {
+        markUnavailable();
+        return -1;
+    }
+
+    int op = -1;
+    if (bind(tfm, (struct sockaddr *)&address, sizeof(address)) == 0)
+        op = accept(tfm, NULL, 0);
+    else
+        markUnavailable();
+
+    close(tfm);
+    return op;
+}
+
+// Passar exactamente length bytes do pipe para o socket, sem cópias para o espaço do utilizador.
+static int drainPipe(int pipeRead, int op, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t moved = splice(pipeRead, NULL, op, NULL, length, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved <= 0)
+        {
+            if (moved == -1 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        length -= moved;
+    }
+    return 0;
+}
+
+/*
+ * Calcular os sumários na crypto API do kernel: o ficheiro é passado com splice() para um pipe,
+ * duplicado com tee() para os pipes dos restantes algoritmos e enviado por splice() para cada
+ * socket AF_ALG. Os dados nunca são copiados para o processo.
+ */
+int afAlgHashFile(const char *path, const int *algorithms, size_t count, char hex[][DIGEST_MAX_HEX_LEN + 1])
+{
+    int ops[DIGEST_MAX_PER_FILE];
+    int pipes[DIGEST_MAX_PER_FILE][2];
+    size_t opened = 0, piped = 0;
+    int ret = -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (; opened < count; opened++)
+        if ((ops[opened] = openAlgSocket(algorithms[opened])) == -1)
+            goto cleanup;
+
+    // Os pipes ficam todos com a capacidade do primeiro, para o tee() copiar sempre o bloco inteiro
+    size_t chunk = 0;
+    for (; piped < count; piped++)
+    {
+        if (pipe(pipes[piped]) == -1)
+            goto cleanup;
+        int size = fcntl(pipes[piped][1], F_SETPIPE_SZ, (piped == 0) ? AFALG_PIPE_SIZE : (int)chunk);
+        if (piped == 0)
+            chunk = (size > 0) ? (size_t)size : (size_t)getpagesize() * 16;
+    }
+
+    while (1)
+    {
+        ssize_t in = splice(fd, NULL, pipes[0][1], NULL, chunk, SPLICE_F_MOVE);
+        if (in == -1 && errno == EINTR)
+            continue;
+        if (in == -1)
+            goto cleanup;
+        if (in == 0)
+            break;
+        throttleRead(in);
+
+        for (size_t i = 1; i < count; i++)
+            if (tee(pipes[0][0], pipes[i][1], in, 0) != in)
+                goto cleanup;
+
+        for (size_t i = 0; i < count; i++)
+            if (drainPipe(pipes[i][0], ops[i], in) != 0)
+                goto cleanup;
+    }
+
+    // A leitura do socket termina o cálculo e devolve o sumário
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned char digest[DIGEST_MAX_HEX_LEN / 2];
+        if (read(ops[i], digest, DIGEST_BYTES[algorithms[i]]) != (ssize_t)DIGEST_BYTES[algorithms[i]])
+            goto cleanup;
+        for (size_t b = 0; b < DIGEST_BYTES[algorithms[i]]; b++)
+            sprintf(hex[i] + b * 2, "%02x", digest[b]);
+    }
+    ret = 0;
+
+cleanup:
+    for (size_t i = 0; i < opened; i++)
+        close(ops[i]);
+    for (size_t i = 0; i < piped; i++)
+    {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    close(fd);
+
+    return ret;
+}
\ No newline at end of file
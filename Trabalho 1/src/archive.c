@@ -0,0 +1,789 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "archive.h"
+#include "inflate.h"
+#include "throttle.h"
+
+#define TAR_BLOCK 512
+#define TAR_NAME_MAX 4096       // Caminhos longos (GNU "L" e pax) aceites
+#define TAR_PAX_MAX (64 << 10)  // Cabeçalhos pax maiores são ignorados
+#define ARCHIVE_SCRATCH (64 << 10)
+
+// O fim do diretório central de um zip está nos últimos 22 bytes mais o comentário (até 64 KiB)
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD_SEARCH (ZIP_EOCD_SIZE + 65535)
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+
+/*
+ * Auxiliares
+ */
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void buildCrcTable(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        crcTable[i] = crc;
+    }
+}
+
+static uint32_t crc32Update(uint32_t crc, const unsigned char *data, size_t length)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t le16(const unsigned char *bytes)
+{
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static uint32_t le32(const unsigned char *bytes)
+{
+    return le16(bytes) | ((uint32_t)le16(bytes + 2) << 16);
+}
+
+static uint64_t le64(const unsigned char *bytes)
+{
+    return le32(bytes) | ((uint64_t)le32(bytes + 4) << 32);
+}
+
+// Dados inválidos ou truncados
+static ssize_t corrupt(void)
+{
+    errno = EIO;
+    return -1;
+}
+
+// Leituras do arquivo, respeitando os limites de "--max-read-rate" e "--max-iops"
+static ssize_t readRaw(int fd, unsigned char *buffer, size_t size)
+{
+    ssize_t readBytes;
+    while ((readBytes = read(fd, buffer, size)) == -1 && errno == EINTR)
+        ;
+    if (readBytes > 0)
+        throttleRead(readBytes);
+    return readBytes;
+}
+
+static ssize_t preadFull(int fd, unsigned char *buffer, size_t size, off_t offset)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t readBytes = pread(fd, buffer + total, size - total, offset + total);
+        if (readBytes == -1 && errno == EINTR)
+            continue;
+        if (readBytes == -1)
+            return -1;
+        if (readBytes == 0)
+            break;
+        throttleRead(readBytes);
+        total += readBytes;
+    }
+    return total;
+}
+
+/*
+ * gzip (RFC 1952), com vários membros seguidos
+ */
+
+typedef struct
+{
+    Inflater inflater;
+    int fd;
+    uint32_t crc;
+    uint32_t size;
+    int ended;
+} GzipStream;
+
+static ssize_t readGzipInput(void *context, unsigned char *buffer, size_t size)
+{
+    return readRaw(((GzipStream *)context)->fd, buffer, size);
+}
+
+static int skipGzipBytes(GzipStream *gzip, size_t length, int untilZero)
+{
+    unsigned char byte;
+    for (size_t i = 0; untilZero || i < length; i++)
+    {
+        if (inflateTakeBytes(&gzip->inflater, &byte, 1) != 1)
+            return -1;
+        if (untilZero && byte == 0)
+            break;
+    }
+    return 0;
+}
+
+// Cabeçalho de um membro, depois dos dois bytes de identificação
+static int readGzipHeader(GzipStream *gzip)
+{
+    unsigned char header[8];
+    if (inflateTakeBytes(&gzip->inflater, header, 8) != 8 || header[0] != 8 || (header[1] & 0xe0) != 0)
+        return -1;
+
+    int flags = header[1];
+    unsigned char extra[2];
+    if ((flags & 0x04) && (inflateTakeBytes(&gzip->inflater, extra, 2) != 2 || skipGzipBytes(gzip, le16(extra), 0) != 0))
+        return -1;
+    if ((flags & 0x08) && skipGzipBytes(gzip, 0, 1) != 0) // Nome
+        return -1;
+    if ((flags & 0x10) && skipGzipBytes(gzip, 0, 1) != 0) // Comentário
+        return -1;
+    if ((flags & 0x02) && skipGzipBytes(gzip, 2, 0) != 0) // CRC do cabeçalho
+        return -1;
+
+    restartInflater(&gzip->inflater);
+    gzip->crc = 0;
+    gzip->size = 0;
+    return 0;
+}
+
+static ssize_t readGzip(GzipStream *gzip, unsigned char *buffer, size_t size)
+{
+    while (size > 0 && !gzip->ended)
+    {
+        ssize_t produced = inflateRead(&gzip->inflater, buffer, size);
+        if (produced < 0)
+            return corrupt();
+        if (produced > 0)
+        {
+            gzip->crc = crc32Update(gzip->crc, buffer, produced);
+            gzip->size += produced;
+            return produced;
+        }
+
+        // Fim de um membro: verificar o CRC e o tamanho, e continuar se vier outro membro a seguir
+        unsigned char trailer[8], magic[2];
+        if (inflateTakeBytes(&gzip->inflater, trailer, 8) != 8 || le32(trailer) != gzip->crc || le32(trailer + 4) != gzip->size)
+            return corrupt();
+        if (inflateTakeBytes(&gzip->inflater, magic, 2) != 2 || magic[0] != 0x1f || magic[1] != 0x8b)
+            gzip->ended = 1;
+        else if (readGzipHeader(gzip) != 0)
+            return corrupt();
+    }
+    return 0;
+}
+
+/*
+ * tar (v7, ustar, GNU e pax)
+ */
+
+typedef struct
+{
+    int fd;
+    GzipStream *gzip; // NULL se o tar não estiver comprimido
+} TarStream;
+
+// Dados de um membro, limitados ao seu tamanho
+typedef struct
+{
+    TarStream *tar;
+    uint64_t remaining;
+} TarMember;
+
+static ssize_t readTar(TarStream *tar, unsigned char *buffer, size_t size)
+{
+    return (tar->gzip != NULL) ? readGzip(tar->gzip, buffer, size) : readRaw(tar->fd, buffer, size);
+}
+
+static ssize_t readTarFull(TarStream *tar, unsigned char *buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t readBytes = readTar(tar, buffer + total, size - total);
+        if (readBytes == -1)
+            return -1;
+        if (readBytes == 0)
+            break;
+        total += readBytes;
+    }
+    return total;
+}
+
+static int skipTar(TarStream *tar, uint64_t length, unsigned char *scratch)
+{
+    if (tar->gzip == NULL)
+        return (lseek(tar->fd, length, SEEK_CUR) == -1) ? -1 : 0;
+
+    while (length > 0)
+    {
+        ssize_t readBytes = readTar(tar, scratch, (length < ARCHIVE_SCRATCH) ? length : ARCHIVE_SCRATCH);
+        if (readBytes <= 0)
+            return -1;
+        length -= readBytes;
+    }
+    return 0;
+}
+
+static ssize_t readTarMember(void *context, unsigned char *buffer, size_t size)
+{
+    TarMember *member = context;
+    if (size > member->remaining)
+        size = member->remaining;
+    if (size == 0)
+        return 0;
+
+    ssize_t readBytes = readTar(member->tar, buffer, size);
+    if (readBytes <= 0)
+        return corrupt();
+    member->remaining -= readBytes;
+    return readBytes;
+}
+
+// Campo numérico em octal, ou em base 256 (extensão GNU para valores grandes)
+static int parseTarNumber(const unsigned char *field, size_t length, uint64_t *value)
+{
+    *value = 0;
+    if (field[0] & 0x80)
+    {
+        if (field[0] & 0x40)
+            return -1;
+        *value = field[0] & 0x3f;
+        for (size_t i = 1; i < length; i++)
+        {
+            if (*value >> 55)
+                return -1;
+            *value = (*value << 8) | field[i];
+        }
+        return 0;
+    }
+
+    size_t i = 0;
+    while (i < length && field[i] == ' ')
+        i++;
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+        *value = (*value << 3) | (field[i] - '0');
+    for (; i < length; i++)
+        if (field[i] != ' ' && field[i] != '\0')
+            return -1;
+    return 0;
+}
+
+// Um bloco é um cabeçalho se a soma dos bytes (com o campo da soma a espaços) coincidir com a guardada.
+static int isTarHeader(const unsigned char *header)
+{
+    uint64_t stored;
+    if (parseTarNumber(header + 148, 8, &stored) != 0)
+        return 0;
+
+    uint64_t sum = 0;
+    int64_t signedSum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++)
+    {
+        unsigned char byte = (i >= 148 && i < 156) ? ' ' : header[i];
+        sum += byte;
+        signedSum += (signed char)byte;
+    }
+    return stored == sum || (int64_t)stored == signedSum;
+}
+
+static int isZeroBlock(const unsigned char *block)
+{
+    for (int i = 0; i < TAR_BLOCK; i++)
+        if (block[i] != 0)
+            return 0;
+    return 1;
+}
+
+/*
+ * Registos "comprimento chave=valor\n" de um cabeçalho pax: só interessam o caminho e o tamanho.
+ * Devolve -1 se um registo estiver mal formado; os registos seguintes são ignorados.
+ */
+static int parsePax(char *data, size_t length, char *path, uint64_t *size, int *hasSize)
+{
+    data[length] = '\0';
+    size_t position = 0;
+    while (position < length)
+    {
+        char *end;
+        unsigned long recordLength = strtoul(data + position, &end, 10);
+        if (end == data + position || *end != ' ' || recordLength == 0 || recordLength > length - position)
+            return -1;
+
+        // O comprimento inclui o próprio campo: um valor curto demais deixaria a chave depois do fim do registo
+        char *key = end + 1;
+        char *recordEnd = data + position + recordLength - 1;
+        if (key >= recordEnd)
+            return -1;
+
+        char *equals = memchr(key, '=', recordEnd - key);
+        if (equals != NULL && equals < recordEnd)
+        {
+            size_t valueLength = recordEnd - equals - 1;
+            if (equals - key == 4 && strncmp(key, "path", 4) == 0 && valueLength < TAR_NAME_MAX)
+            {
+                memcpy(path, equals + 1, valueLength);
+                path[valueLength] = '\0';
+            }
+            else if (equals - key == 4 && strncmp(key, "size", 4) == 0)
+            {
+                *size = strtoull(equals + 1, NULL, 10);
+                *hasSize = 1;
+            }
+        }
+        position += recordLength;
+    }
+    return 0;
+}
+
+static uint64_t tarPadding(uint64_t size)
+{
+    return (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+}
+
+/*
+ * Percorrer os cabeçalhos pela ordem do arquivo, entregando cada ficheiro regular ao visitor sem o extrair.
+ * firstHeader é o primeiro bloco, quando já foi lido para reconhecer o formato.
+ */
+static int walkTar(TarStream *tar, const unsigned char *firstHeader, ArchiveVisitor visitor, void *context)
+{
+    unsigned char header[TAR_BLOCK];
+    char *longName = malloc(TAR_NAME_MAX);
+    char *paxPath = malloc(TAR_NAME_MAX);
+    char *pax = malloc(TAR_PAX_MAX + 1);
+    char *name = malloc(TAR_NAME_MAX + 1);
+    unsigned char *scratch = malloc(ARCHIVE_SCRATCH);
+    if (longName == NULL || paxPath == NULL || pax == NULL || name == NULL || scratch == NULL)
+    {
+        free(longName);
+        free(paxPath);
+        free(pax);
+        free(name);
+        free(scratch);
+        return -1;
+    }
+    longName[0] = '\0';
+    paxPath[0] = '\0';
+    uint64_t paxSize = 0;
+    int badPax = 0;
+    int hasPaxSize = 0;
+
+    int ret = 0;
+    for (int first = 1;; first = 0)
+    {
+        if (first && firstHeader != NULL)
+            memcpy(header, firstHeader, TAR_BLOCK);
+        else
+        {
+            ssize_t readBytes = readTarFull(tar, header, TAR_BLOCK);
+            if (readBytes == 0)
+                break;
+            if (readBytes != TAR_BLOCK)
+            {
+                ret = -1;
+                break;
+            }
+        }
+
+        // Fim do arquivo. Num tar comprimido o resto é lido para verificar o CRC do gzip.
+        if (isZeroBlock(header))
+        {
+            if (tar->gzip != NULL && skipTar(tar, UINT64_MAX, scratch) != 0 && !tar->gzip->ended)
+                ret = -1;
+            break;
+        }
+        if (!isTarHeader(header))
+        {
+            ret = -1;
+            break;
+        }
+
+        uint64_t size, mode, mtime;
+        if (parseTarNumber(header + 124, 12, &size) != 0 || parseTarNumber(header + 100, 8, &mode) != 0 ||
+            parseTarNumber(header + 136, 12, &mtime) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        char type = header[156];
+
+        // Nomes longos (GNU) e cabeçalhos pax aplicam-se ao membro seguinte
+        if (type == 'L' || (type == 'x' && size <= TAR_PAX_MAX))
+        {
+            char *target = (type == 'L') ? longName : pax;
+            size_t keep = (type == 'L') ? ((size < TAR_NAME_MAX) ? size : TAR_NAME_MAX - 1) : size;
+            if (readTarFull(tar, (unsigned char *)target, keep) != (ssize_t)keep ||
+                skipTar(tar, size - keep + tarPadding(size), scratch) != 0)
+            {
+                ret = -1;
+                break;
+            }
+            if (type == 'L')
+                longName[keep] = '\0';
+            else if (parsePax(pax, size, paxPath, &paxSize, &hasPaxSize) != 0)
+                badPax = 1;
+            continue;
+        }
+
+        if (hasPaxSize)
+            size = paxSize;
+
+        if (type == '0' || type == '\0' || type == '7')
+        {
+            if (longName[0] != '\0')
+                strcpy(name, longName);
+            else if (paxPath[0] != '\0')
+                strcpy(name, paxPath);
+            else if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != '\0')
+                sprintf(name, "%.155s/%.100s", (const char *)header + 345, (const char *)header);
+            else
+                sprintf(name, "%.100s", (const char *)header);
+
+            // O membro é analisado na mesma, com o que o cabeçalho pax tinha de válido
+            if (badPax)
+                fprintf(stderr, "Malformed pax header for archive member '%s', ignoring it\n", name);
+
+            ArchiveMember member;
+            memset(&member, 0, sizeof(ArchiveMember));
+            member.name = name;
+            member.stat.st_mode = S_IFREG | (mode & 07777);
+            member.stat.st_size = size;
+            member.stat.st_mtime = mtime;
+            member.stat.st_atime = mtime;
+            member.stat.st_ctime = mtime;
+
+            TarMember data = {tar, size};
+            PipelineSource source = {readTarMember, &data, size};
+            if (visitor(context, &member, &source) != 0)
+            {
+                ret = -1;
+                break;
+            }
+            size = data.remaining;
+            if (skipTar(tar, size + tarPadding(member.stat.st_size), scratch) != 0)
+            {
+                ret = -1;
+                break;
+            }
+        }
+        else if (skipTar(tar, size + tarPadding(size), scratch) != 0)
+        {
+            ret = -1;
+            break;
+        }
+
+        longName[0] = '\0';
+        paxPath[0] = '\0';
+        hasPaxSize = 0;
+        badPax = 0;
+    }
+
+    free(longName);
+    free(paxPath);
+    free(pax);
+    free(name);
+    free(scratch);
+    return ret;
+}
+
+// tar.gz: o primeiro bloco descomprimido decide se é um tar (um .gz de outro ficheiro não é um arquivo)
+static int walkGzipTar(int fd, ArchiveVisitor visitor, void *context)
+{
+    GzipStream *gzip = malloc(sizeof(GzipStream));
+    if (gzip == NULL)
+        return -1;
+    gzip->fd = fd;
+    gzip->ended = 0;
+    initInflater(&gzip->inflater, readGzipInput, gzip);
+
+    unsigned char magic[2], header[TAR_BLOCK];
+    TarStream tar = {fd, gzip};
+    int ret = -1;
+    if (inflateTakeBytes(&gzip->inflater, magic, 2) == 2 && readGzipHeader(gzip) == 0)
+    {
+        ssize_t readBytes = readTarFull(&tar, header, TAR_BLOCK);
+        if (readBytes == TAR_BLOCK && isTarHeader(header))
+            ret = walkTar(&tar, header, visitor, context);
+        else
+            ret = (readBytes == -1) ? -1 : 0;
+    }
+
+    free(gzip);
+    return ret;
+}
+
+/*
+ * zip (com zip64), pelo diretório central
+ */
+
+typedef struct
+{
+    int fd;
+    off_t position;
+    uint64_t compressedRemaining;
+    uint64_t remaining;
+    int method;
+    Inflater *inflater;
+    uint32_t crc;
+    uint32_t expectedCrc;
+} ZipMember;
+
+static ssize_t readZipInput(void *context, unsigned char *buffer, size_t size)
+{
+    ZipMember *member = context;
+    if (size > member->compressedRemaining)
+        size = member->compressedRemaining;
+    if (size == 0)
+        return 0;
+
+    ssize_t readBytes = preadFull(member->fd, buffer, size, member->position);
+    if (readBytes > 0)
+    {
+        member->position += readBytes;
+        member->compressedRemaining -= readBytes;
+    }
+    return readBytes;
+}
+
+static ssize_t readZipMember(void *context, unsigned char *buffer, size_t size)
+{
+    ZipMember *member = context;
+    if (size > member->remaining)
+        size = member->remaining;
+    if (size == 0)
+        return 0;
+
+    ssize_t readBytes = (member->method == ZIP_STORED) ? readZipInput(member, buffer, size)
+                                                       : inflateRead(member->inflater, buffer, size);
+    if (readBytes <= 0)
+        return corrupt();
+    member->crc = crc32Update(member->crc, buffer, readBytes);
+    member->remaining -= readBytes;
+    if (member->remaining == 0 && member->crc != member->expectedCrc)
+        return corrupt();
+    return readBytes;
+}
+
+// Data do MS-DOS (hora local, com resolução de 2 segundos)
+static time_t dosTime(uint32_t time, uint32_t date)
+{
+    struct tm ts;
+    memset(&ts, 0, sizeof(struct tm));
+    ts.tm_sec = (time & 0x1f) * 2;
+    ts.tm_min = (time >> 5) & 0x3f;
+    ts.tm_hour = time >> 11;
+    ts.tm_mday = date & 0x1f;
+    ts.tm_mon = ((date >> 5) & 0x0f) - 1;
+    ts.tm_year = (date >> 9) + 80;
+    ts.tm_isdst = -1;
+    return mktime(&ts);
+}
+
+// Campos extra de uma entrada: tamanhos e posição zip64 (0x0001) e data Unix (0x5455)
+static void parseZipExtra(const unsigned char *extra, size_t length, uint64_t *compressed, uint64_t *size,
+                          uint64_t *offset, time_t *mtime)
+{
+    for (size_t position = 0; position + 4 <= length;)
+    {
+        uint32_t id = le16(extra + position);
+        size_t fieldLength = le16(extra + position + 2);
+        const unsigned char *field = extra + position + 4;
+        if (position + 4 + fieldLength > length)
+            break;
+
+        if (id == 0x0001)
+        {
+            size_t used = 0;
+            if (*size == 0xffffffff && used + 8 <= fieldLength)
+                *size = le64(field + used), used += 8;
+            if (*compressed == 0xffffffff && used + 8 <= fieldLength)
+                *compressed = le64(field + used), used += 8;
+            if (*offset == 0xffffffff && used + 8 <= fieldLength)
+                *offset = le64(field + used);
+        }
+        else if (id == 0x5455 && fieldLength >= 5 && (field[0] & 1))
+            *mtime = (int32_t)le32(field + 1);
+
+        position += 4 + fieldLength;
+    }
+}
+
+static int findCentralDirectory(int fd, off_t fileSize, uint64_t *entries, uint64_t *offset, uint64_t *size)
+{
+    size_t tailLength = (fileSize < ZIP_EOCD_SEARCH) ? (size_t)fileSize : ZIP_EOCD_SEARCH;
+    unsigned char *tail = malloc(tailLength);
+    if (tail == NULL || tailLength < ZIP_EOCD_SIZE || preadFull(fd, tail, tailLength, fileSize - tailLength) != (ssize_t)tailLength)
+    {
+        free(tail);
+        return -1;
+    }
+
+    long end = -1;
+    for (long i = tailLength - ZIP_EOCD_SIZE; i >= 0 && end == -1; i--)
+        if (memcmp(tail + i, "PK\5\6", 4) == 0 && (size_t)i + ZIP_EOCD_SIZE + le16(tail + i + 20) <= tailLength)
+            end = i;
+    if (end == -1)
+    {
+        free(tail);
+        return -1;
+    }
+
+    *entries = le16(tail + end + 10);
+    *size = le32(tail + end + 12);
+    *offset = le32(tail + end + 16);
+
+    // Com mais de 65535 entradas ou mais de 4 GiB os valores estão no registo zip64
+    if ((*entries == 0xffff || *size == 0xffffffff || *offset == 0xffffffff) && end >= 20 &&
+        memcmp(tail + end - 20, "PK\6\7", 4) == 0)
+    {
+        unsigned char record[56];
+        if (preadFull(fd, record, 56, le64(tail + end - 20 + 8)) != 56 || memcmp(record, "PK\6\6", 4) != 0)
+        {
+            free(tail);
+            return -1;
+        }
+        *entries = le64(record + 32);
+        *size = le64(record + 40);
+        *offset = le64(record + 48);
+    }
+
+    free(tail);
+    return (*offset + *size <= (uint64_t)fileSize) ? 0 : -1;
+}
+
+static int walkZip(int fd, const char *path, off_t fileSize, ArchiveVisitor visitor, void *context)
+{
+    uint64_t entries, offset, centralSize;
+    if (findCentralDirectory(fd, fileSize, &entries, &offset, &centralSize) != 0)
+        return -1;
+
+    // Uma entrada do diretório central tem no máximo 3 campos de 64 KiB (nome, extra e comentário)
+    unsigned char *entry = malloc(ZIP_CENTRAL_SIZE + 2 * 65536);
+    char *name = malloc(65536);
+    Inflater *inflater = malloc(sizeof(Inflater));
+    if (entry == NULL || name == NULL || inflater == NULL)
+    {
+        free(entry);
+        free(name);
+        free(inflater);
+        return -1;
+    }
+
+    int ret = 0;
+    for (uint64_t n = 0; ret == 0 && n < entries; n++)
+    {
+        if (preadFull(fd, entry, ZIP_CENTRAL_SIZE, offset) != ZIP_CENTRAL_SIZE || memcmp(entry, "PK\1\2", 4) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        size_t nameLength = le16(entry + 28), extraLength = le16(entry + 30), commentLength = le16(entry + 32);
+        if (preadFull(fd, entry + ZIP_CENTRAL_SIZE, nameLength + extraLength, offset + ZIP_CENTRAL_SIZE) != (ssize_t)(nameLength + extraLength))
+        {
+            ret = -1;
+            break;
+        }
+        offset += ZIP_CENTRAL_SIZE + nameLength + extraLength + commentLength;
+
+        memcpy(name, entry + ZIP_CENTRAL_SIZE, nameLength);
+        name[nameLength] = '\0';
+        if (nameLength == 0 || name[nameLength - 1] == '/')
+            continue;
+
+        int flags = le16(entry + 8), method = le16(entry + 10);
+        uint64_t compressed = le32(entry + 20), size = le32(entry + 24), localOffset = le32(entry + 42);
+        time_t mtime = dosTime(le16(entry + 12), le16(entry + 14));
+        parseZipExtra(entry + ZIP_CENTRAL_SIZE + nameLength, extraLength, &compressed, &size, &localOffset, &mtime);
+
+        // Permissões Unix, quando o arquivo foi criado em Unix. Ligações simbólicas e afins não são ficheiros.
+        mode_t mode = S_IFREG | 0644;
+        if ((le16(entry + 4) >> 8) == 3 && (le32(entry + 38) >> 16) != 0)
+            mode = le32(entry + 38) >> 16;
+        if ((mode & S_IFMT) != 0 && !S_ISREG(mode))
+            continue;
+
+        if ((flags & 1) || (method != ZIP_STORED && method != ZIP_DEFLATED))
+        {
+            printf("Membro '%s%s%s' cifrado ou com compressão não suportada, ignorado\n", path, ARCHIVE_MEMBER_SEPARATOR, name);
+            continue;
+        }
+
+        unsigned char local[ZIP_LOCAL_SIZE];
+        if (preadFull(fd, local, ZIP_LOCAL_SIZE, localOffset) != ZIP_LOCAL_SIZE || memcmp(local, "PK\3\4", 4) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        uint64_t dataOffset = localOffset + ZIP_LOCAL_SIZE + le16(local + 26) + le16(local + 28);
+        if (dataOffset + compressed > (uint64_t)fileSize || (method == ZIP_STORED && compressed != size))
+        {
+            ret = -1;
+            break;
+        }
+
+        ArchiveMember member;
+        memset(&member, 0, sizeof(ArchiveMember));
+        member.name = name;
+        member.stat.st_mode = S_IFREG | (mode & 07777);
+        member.stat.st_size = size;
+        member.stat.st_mtime = mtime;
+        member.stat.st_atime = mtime;
+        member.stat.st_ctime = mtime;
+
+        ZipMember data = {fd, dataOffset, compressed, size, method, inflater, 0, le32(entry + 16)};
+        if (method == ZIP_DEFLATED)
+            initInflater(inflater, readZipInput, &data);
+        PipelineSource source = {readZipMember, &data, size};
+        if (visitor(context, &member, &source) != 0)
+            ret = -1;
+    }
+
+    free(entry);
+    free(name);
+    free(inflater);
+    return ret;
+}
+
+/*
+ * Reconhecer o formato pelos primeiros bytes e percorrer os membros. Devolve 0 também se o ficheiro não for
+ * um arquivo suportado, -1 se o arquivo estiver corrompido ou não puder ser lido.
+ */
+int walkArchive(const char *path, ArchiveVisitor visitor, void *context)
+{
+    pthread_once(&crcOnce, buildCrcTable);
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open() error");
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct stat fileStat;
+    unsigned char header[TAR_BLOCK];
+    ssize_t length = (fstat(fd, &fileStat) == 0) ? preadFull(fd, header, TAR_BLOCK, 0) : -1;
+
+    int ret = (length == -1) ? -1 : 0;
+    if (length >= 4 && (memcmp(header, "PK\3\4", 4) == 0 || memcmp(header, "PK\5\6", 4) == 0))
+        ret = walkZip(fd, path, fileStat.st_size, visitor, context);
+    else if (length >= 3 && header[0] == 0x1f && header[1] == 0x8b && header[2] == 8)
+        ret = walkGzipTar(fd, visitor, context);
+    else if (length == TAR_BLOCK && isTarHeader(header))
+    {
+        TarStream tar = {fd, NULL};
+        ret = walkTar(&tar, NULL, visitor, context);
+    }
+
+    close(fd);
+    return ret;
+}
\ No newline at end of file
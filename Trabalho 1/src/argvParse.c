@@ -1,10 +1,71 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "argvParse.h"
 
-int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, char **outputFileName, char **targetLocation)
+// Máximo de processos de análise de "--shards"
+#define MAX_SHARDS 1024
+
+/*
+ * Validar a lista de "-h" (nomes separados por ',') uma única vez, com uma mensagem própria para nomes
+ * desconhecidos, repetidos ou a mais, em vez de cada ficheiro ignorar o que não consegue calcular.
+ */
+static int checkHashFunctions(const char *list)
 {
+    char *copy = malloc(strlen(list) + 1);
+    if (copy == NULL)
+        return -1;
+    strcpy(copy, list);
+
+    int seen[DIGEST_MAX_PER_FILE] = {0}; // Um por algoritmo, o último para "ctph"
+    size_t count = 0;
+    int ret = 0;
+    char *savePtr = NULL;
+    for (char *name = strtok_r(copy, ",", &savePtr); name != NULL && ret == 0; name = strtok_r(NULL, ",", &savePtr))
+    {
+        int algorithm = (strcmp(name, "ctph") == 0) ? DIGEST_COUNT : digestFromName(name);
+        if (algorithm == -1)
+        {
+            printf("'%s' is not a valid hash function!\n", name);
+            ret = -1;
+        }
+        else if (seen[algorithm])
+        {
+            printf("Função de hash '%s' repetida após \"-h\"!\n", name);
+            ret = -1;
+        }
+        else if (count == DIGEST_MAX_PER_FILE)
+        {
+            printf("Demasiadas funções de hash após \"-h\" (no máximo %d)!\n", DIGEST_MAX_PER_FILE);
+            ret = -1;
+        }
+        else
+        {
+            seen[algorithm] = 1;
+            count++;
+        }
+    }
+    if (ret == 0 && count == 0)
+    {
+        printf("Tipo de hash após \"-h\" em falta!\n");
+        ret = -1;
+    }
+
+    free(copy);
+    return ret;
+}
+
+int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, char **outputFileName, int **targetArgs, int *targetCount)
+{
+    // Posições dos alvos em argv, pela ordem da linha de comandos
+    if ((*targetArgs = malloc(argc * sizeof(int))) == NULL)
+        return -1;
+    *targetCount = 0;
+
+    const char *signaturesPath = NULL;
+    const char *knownPath = NULL;
+
     // Percorrer todos os argumentos, saltando o primeiro (nome do programa).
     for (int i = 1; i < argc; i++)
     {
@@ -16,6 +77,18 @@ int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, ch
         else if (strcmp(argv[i], "-v") == 0)
             flags->logExecution = 1;
 
+        // Se encontrarmos a flag "-z", marcá-la
+        else if (strcmp(argv[i], "-z") == 0)
+            flags->compressOutput = 1;
+
+        // Se encontrarmos a flag "--unordered", marcá-la
+        else if (strcmp(argv[i], "--unordered") == 0)
+            flags->unorderedOutput = 1;
+
+        // Se encontrarmos a flag "-e", marcá-la
+        else if (strcmp(argv[i], "-e") == 0)
+            flags->entropyAnalysis = 1;
+
         // Se encontrarmos a flag "-h":
         else if (strcmp(argv[i], "-h") == 0)
         {
@@ -25,7 +98,9 @@ int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, ch
             {
                 // Se existir, marcar a flag e guardar o tipo de hashes a calcular.
                 flags->calculateHash = 1;
-                if ((*hashFunctions = malloc(strlen(argv[i] + 1))) == NULL)
+                if (checkHashFunctions(argv[i]) != 0)
+                    return -1;
+                if ((*hashFunctions = malloc(strlen(argv[i]) + 1)) == NULL)
                     return -1;
                 strcpy(*hashFunctions, argv[i]);
             }
@@ -46,7 +121,7 @@ int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, ch
             {
                 // Se existir, marcar a flag e guardar o nome do ficheiro onde escrever.
                 flags->writeToFile = 1;
-                if ((*outputFileName = malloc(strlen(argv[i] + 1))) == NULL)
+                if ((*outputFileName = malloc(strlen(argv[i]) + 1)) == NULL)
                     return -1;
                 strcpy(*outputFileName, argv[i]);
             }
@@ -58,21 +133,437 @@ int readArguments(int argc, char *argv[], Flags *flags, char **hashFunctions, ch
             }
         }
 
-        // Se o argumento actual não corresponder a nenhuma flag, assumir que é o ficheiro/diretório a analisar.
-        else
+        // Se encontrarmos a flag "-j":
+        else if (strcmp(argv[i], "-j") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o número de threads.
+            i++;
+            char *end = NULL;
+            if (i < argc)
+                flags->jobs = strtoul(argv[i], &end, 10);
+
+            if (end == NULL || end == argv[i] || *end != '\0' || flags->jobs == 0)
+            {
+                // Se não existir ou for inválido, terminar execução.
+                printf("Número de threads após \"-j\" em falta ou inválido!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos uma das flags de limites da concorrência, seguidas de um número:
+        else if (strcmp(argv[i], "--min-jobs") == 0 || strcmp(argv[i], "--max-open-files") == 0)
+        {
+            const char *option = argv[i];
+            i++;
+            char *end = NULL;
+            unsigned long value = (i < argc) ? strtoul(argv[i], &end, 10) : 0;
+            if (i >= argc || end == argv[i] || *end != '\0' || value == 0 || value > UINT_MAX)
+            {
+                printf("Número após \"%s\" em falta ou inválido!\n", option);
+                return -1;
+            }
+            if (strcmp(option, "--min-jobs") == 0)
+                flags->minJobs = value;
+            else
+                flags->maxOpenFiles = value;
+        }
+
+        // Se encontrarmos a flag "--max-buffer-mem":
+        else if (strcmp(argv[i], "--max-buffer-mem") == 0)
+        {
+            // Verificar se existe um argumento seguinte com a memória (n[K|M|G]).
+            i++;
+            off_t memory;
+            if (i >= argc || parseFilterSize(&memory, argv[i]) != 0 || memory <= 0)
+            {
+                printf("Memória após \"--max-buffer-mem\" em falta ou inválida!\n");
+                return -1;
+            }
+            flags->maxBufferMemory = memory;
+        }
+
+        // Se encontrarmos a flag "--max-read-rate":
+        else if (strcmp(argv[i], "--max-read-rate") == 0)
+        {
+            // Verificar se existe um argumento seguinte com os bytes por segundo (n[K|M|G]).
+            i++;
+            off_t rate;
+            if (i >= argc || parseFilterSize(&rate, argv[i]) != 0 || rate <= 0)
+            {
+                printf("Débito após \"--max-read-rate\" em falta ou inválido!\n");
+                return -1;
+            }
+            flags->maxReadRate = rate;
+        }
+
+        // Se encontrarmos a flag "--max-iops":
+        else if (strcmp(argv[i], "--max-iops") == 0)
+        {
+            i++;
+            char *end = NULL;
+            unsigned long iops = (i < argc) ? strtoul(argv[i], &end, 10) : 0;
+            if (i >= argc || end == argv[i] || *end != '\0' || iops == 0 || iops > UINT_MAX)
+            {
+                printf("Número após \"--max-iops\" em falta ou inválido!\n");
+                return -1;
+            }
+            flags->maxIops = iops;
+        }
+
+        // Se encontrarmos a flag "--max-cpu":
+        else if (strcmp(argv[i], "--max-cpu") == 0)
+        {
+            // Verificar se existe um argumento seguinte com a percentagem (1 a 100).
+            i++;
+            char *end = NULL;
+            unsigned long percent = (i < argc) ? strtoul(argv[i], &end, 10) : 0;
+            if (i >= argc || end == argv[i] || *end != '\0' || percent < 1 || percent > 100)
+            {
+                printf("Percentagem inválida após \"--max-cpu\" (1 a 100)!\n");
+                return -1;
+            }
+            flags->maxCpu = percent;
+        }
+
+        // Se encontrarmos a flag "--shards":
+        else if (strcmp(argv[i], "--shards") == 0)
         {
-            size_t length = strlen(argv[i]) + 1;
-            *targetLocation = malloc(length);
-            memcpy(*targetLocation, argv[i], length);
+            // Verificar se existe um argumento seguinte com o número de processos de análise.
+            i++;
+            char *end = NULL;
+            unsigned long shards = (i < argc) ? strtoul(argv[i], &end, 10) : 0;
+            if (i >= argc || end == argv[i] || *end != '\0' || shards == 0 || shards > MAX_SHARDS)
+            {
+                printf("Número de processos após \"--shards\" em falta ou inválido (1 a %d)!\n", MAX_SHARDS);
+                return -1;
+            }
+            flags->shards = shards;
+        }
+
+        // Se encontrarmos a flag "--order":
+        else if (strcmp(argv[i], "--order") == 0)
+        {
+            // Verificar se existe um argumento seguinte com a ordem pretendida.
+            i++;
+            if (i < argc && strcmp(argv[i], "inode") == 0)
+                flags->traversalOrder = ORDER_INODE;
+            else if (i < argc && strcmp(argv[i], "extent") == 0)
+                flags->traversalOrder = ORDER_EXTENT;
+            else
+            {
+                // Se não existir ou for inválido, terminar execução.
+                printf("Ordem após \"--order\" em falta ou inválida (inode, extent)!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--hash-backend=...", guardar a implementação dos sumários
+        else if (strncmp(argv[i], "--hash-backend=", strlen("--hash-backend=")) == 0)
+        {
+            const char *backend = argv[i] + strlen("--hash-backend=");
+            if (strcmp(backend, "user") == 0)
+                flags->hashBackend = HASH_BACKEND_USER;
+            else if (strcmp(backend, "af_alg") == 0)
+                flags->hashBackend = HASH_BACKEND_AF_ALG;
+            else
+            {
+                printf("Implementação de hash inválida: '%s' (user, af_alg)\n", backend);
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--merkle", marcá-la
+        else if (strcmp(argv[i], "--merkle") == 0)
+            flags->merkleDigests = 1;
+
+        // Se encontrarmos a flag "--index":
+        else if (strcmp(argv[i], "--index") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o ficheiro do índice.
+            i++;
+            if (i < argc)
+                flags->indexPath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Ficheiro do índice após \"--index\" em falta!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--verify":
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o índice a verificar.
+            i++;
+            if (i < argc)
+                flags->verifyPath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Ficheiro do índice após \"--verify\" em falta!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--similar":
+        else if (strcmp(argv[i], "--similar") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o output de referência.
+            i++;
+            if (i < argc)
+                flags->similarPath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Output de referência após \"--similar\" em falta!\n");
+                return -1;
+            }
         }
+
+        // Se encontrarmos a flag "--profile":
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o ficheiro do relatório.
+            i++;
+            if (i < argc)
+                flags->profilePath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Ficheiro do relatório após \"--profile\" em falta!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--min-score":
+        else if (strcmp(argv[i], "--min-score") == 0)
+        {
+            // Verificar se existe um argumento seguinte com a pontuação (1 a 100).
+            i++;
+            char *end = NULL;
+            unsigned long score = (i < argc) ? strtoul(argv[i], &end, 10) : 0;
+            if (i >= argc || *end != '\0' || score < 1 || score > 100)
+            {
+                printf("Pontuação inválida após \"--min-score\" (1 a 100)!\n");
+                return -1;
+            }
+            flags->similarMinScore = score;
+        }
+
+        // Se encontrarmos a flag "--signatures":
+        else if (strcmp(argv[i], "--signatures") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o ficheiro das assinaturas.
+            i++;
+            if (i < argc)
+                signaturesPath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Ficheiro de assinaturas após \"--signatures\" em falta!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--known":
+        else if (strcmp(argv[i], "--known") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o conjunto de ficheiros conhecidos.
+            i++;
+            if (i < argc)
+                knownPath = argv[i];
+            else
+            {
+                // Se não existir, terminar execução.
+                printf("Conjunto de ficheiros conhecidos após \"--known\" em falta!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos a flag "--skip-known", marcá-la
+        else if (strcmp(argv[i], "--skip-known") == 0)
+            flags->skipKnown = 1;
+
+        // Se encontrarmos a flag "--into-archives", marcá-la
+        else if (strcmp(argv[i], "--into-archives") == 0)
+            flags->intoArchives = 1;
+
+        // Se encontrarmos a flag "--timeline", marcá-la
+        else if (strcmp(argv[i], "--timeline") == 0)
+            flags->timelineMode = 1;
+
+        // Se encontrarmos a flag "--summary", marcá-la
+        else if (strcmp(argv[i], "--summary") == 0)
+            flags->summaryMode = 1;
+
+        // Se encontrarmos a flag "--top":
+        else if (strcmp(argv[i], "--top") == 0)
+        {
+            // Verificar se existe um argumento seguinte com o número de maiores ficheiros a listar.
+            i++;
+            char *end = NULL;
+            if (i < argc)
+                flags->summaryTopN = strtoul(argv[i], &end, 10);
+
+            if (end == NULL || end == argv[i] || *end != '\0')
+            {
+                // Se não existir ou for inválido, terminar execução.
+                printf("Número após \"--top\" em falta ou inválido!\n");
+                return -1;
+            }
+        }
+
+        // Se encontrarmos uma das flags de filtragem, todas seguidas de um valor:
+        else if (strcmp(argv[i], "--include") == 0 || strcmp(argv[i], "--exclude") == 0 ||
+                 strcmp(argv[i], "--min-size") == 0 || strcmp(argv[i], "--max-size") == 0 ||
+                 strcmp(argv[i], "--newer") == 0 || strcmp(argv[i], "--older") == 0 ||
+                 strcmp(argv[i], "--type") == 0)
+        {
+            const char *option = argv[i];
+            i++;
+            if (i >= argc)
+            {
+                printf("Valor após \"%s\" em falta!\n", option);
+                return -1;
+            }
+
+            int ret;
+            if (strcmp(option, "--include") == 0)
+                ret = addFilterGlob(&flags->filter, 0, argv[i]);
+            else if (strcmp(option, "--exclude") == 0)
+                ret = addFilterGlob(&flags->filter, 1, argv[i]);
+            else if (strcmp(option, "--min-size") == 0)
+                ret = parseFilterSize(&flags->filter.minSize, argv[i]);
+            else if (strcmp(option, "--max-size") == 0)
+                ret = parseFilterSize(&flags->filter.maxSize, argv[i]);
+            else if (strcmp(option, "--newer") == 0)
+                ret = parseFilterDate(&flags->filter.newerThan, argv[i]);
+            else if (strcmp(option, "--older") == 0)
+                ret = parseFilterDate(&flags->filter.olderThan, argv[i]);
+            else
+                ret = parseFilterTypes(&flags->filter.types, argv[i]);
+
+            if (ret != 0)
+            {
+                printf("Valor inválido após \"%s\": '%s'\n", option, argv[i]);
+                return -1;
+            }
+        }
+
+        // Se o argumento actual não corresponder a nenhuma flag, assumir que é um ficheiro/diretório a analisar.
+        else
+            (*targetArgs)[(*targetCount)++] = i;
     }
 
     // Se após ler os argumentos, o alvo a analisar continuar vazio, terminar execução.
-    if (*targetLocation == NULL)
+    if (*targetCount == 0)
     {
         printf("Ficheiro a analisar em falta!\n");
         return -1;
     }
 
+    // A verificação e a comparação de outputs têm um único alvo.
+    if ((flags->verifyPath != NULL || flags->similarPath != NULL) && *targetCount > 1)
+    {
+        printf("\"--verify\" e \"--similar\" só aceitam um alvo!\n");
+        return -1;
+    }
+
+    // Os processos de análise leem diretamente as entradas dos diretórios, sem processos filhos que reportem ao pai
+    // nem threads por diretório.
+    if (flags->shards > 0 && (flags->summaryMode || flags->merkleDigests || flags->verifyPath != NULL ||
+                              flags->similarPath != NULL || flags->jobs > 1))
+    {
+        printf("\"--shards\" não pode ser usado com \"--summary\", \"--merkle\", \"--verify\", \"--similar\" ou \"-j\"!\n");
+        return -1;
+    }
+
+    // Só o output para ficheiro é comprimido.
+    if (flags->compressOutput && !flags->writeToFile)
+    {
+        printf("\"-z\" só pode ser usado com \"-o\"!\n");
+        return -1;
+    }
+
+    // Os dois modos usam o canal de relatório dos processos filhos, não podem ser combinados.
+    if (flags->summaryMode && flags->merkleDigests)
+    {
+        printf("\"--merkle\" e \"--summary\" não podem ser usados em simultâneo!\n");
+        return -1;
+    }
+
+    // O modo resumo não analisa cada ficheiro, não há registos para o índice.
+    if (flags->summaryMode && flags->indexPath != NULL)
+    {
+        printf("\"--index\" e \"--summary\" não podem ser usados em simultâneo!\n");
+        return -1;
+    }
+
+    // Nem lê o conteúdo dos ficheiros, onde são procuradas as assinaturas.
+    if (flags->summaryMode && signaturesPath != NULL)
+    {
+        printf("\"--signatures\" e \"--summary\" não podem ser usados em simultâneo!\n");
+        return -1;
+    }
+
+    // A linha temporal substitui as linhas por ficheiro, não pode ser combinada com os outros modos.
+    if (flags->timelineMode && (flags->summaryMode || flags->merkleDigests || flags->indexPath != NULL))
+    {
+        printf("\"--timeline\" não pode ser usado com \"--summary\", \"--merkle\" ou \"--index\"!\n");
+        return -1;
+    }
+
+    // A verificação substitui a análise, não pode ser combinada com os modos que mudam o output.
+    if (flags->verifyPath != NULL && (flags->summaryMode || flags->timelineMode || flags->merkleDigests ||
+                                      flags->indexPath != NULL || signaturesPath != NULL))
+    {
+        printf("\"--verify\" não pode ser usado com \"--summary\", \"--timeline\", \"--merkle\", \"--index\" ou \"--signatures\"!\n");
+        return -1;
+    }
+
+    // A comparação de outputs também substitui a análise.
+    if (flags->similarPath != NULL && (flags->summaryMode || flags->timelineMode || flags->merkleDigests ||
+                                       flags->indexPath != NULL || flags->verifyPath != NULL || signaturesPath != NULL))
+    {
+        printf("\"--similar\" não pode ser usado com \"--summary\", \"--timeline\", \"--merkle\", \"--index\", \"--verify\" ou \"--signatures\"!\n");
+        return -1;
+    }
+
+    // Os ficheiros conhecidos são identificados pelo sumário do conteúdo, que só é lido na análise normal.
+    if (knownPath != NULL && (flags->summaryMode || flags->timelineMode || flags->verifyPath != NULL || flags->similarPath != NULL))
+    {
+        printf("\"--known\" não pode ser usado com \"--summary\", \"--timeline\", \"--verify\" ou \"--similar\"!\n");
+        return -1;
+    }
+
+    // Só a análise é medida.
+    if (flags->profilePath != NULL && (flags->verifyPath != NULL || flags->similarPath != NULL))
+    {
+        printf("\"--profile\" não pode ser usado com \"--verify\" ou \"--similar\"!\n");
+        return -1;
+    }
+
+    if (flags->skipKnown && knownPath == NULL)
+    {
+        printf("\"--skip-known\" só pode ser usado com \"--known\"!\n");
+        return -1;
+    }
+
+    // Mapear o conjunto de ficheiros conhecidos, partilhado pela page cache entre todos os processos.
+    if (knownPath != NULL && (flags->knownFiles = openHashSet(knownPath)) == NULL)
+    {
+        printf("Não foi possível abrir o conjunto de ficheiros conhecidos '%s'!\n", knownPath);
+        return -1;
+    }
+
+    // Compilar as assinaturas num autómato de Aho-Corasick, uma única vez por processo.
+    if (signaturesPath != NULL && (flags->signatures = loadSignatures(signaturesPath)) == NULL)
+        return -1;
+
+    // Compilar os globs de filtragem num DFA no processo inicial; os processos filhos usam as mesmas tabelas.
+    if (compileFilter(&flags->filter) != 0)
+        return -1;
+
     return 0;
 }
\ No newline at end of file
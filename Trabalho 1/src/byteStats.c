@@ -0,0 +1,66 @@
+#include <math.h>
+#include <string.h>
+#include "byteStats.h"
+
+// Histogramas parciais intercalados, para bytes repetidos não dependerem do incremento anterior
+#define BYTE_STATS_LANES 4
+
+void initByteStats(ByteStats *stats)
+{
+    memset(stats, 0, sizeof(ByteStats));
+}
+
+/*
+ * Consumidor da leitura do ficheiro. Cada byte de um grupo de quatro conta numa tabela diferente: com uma
+ * só tabela, sequências do mesmo byte (zeros, texto) serializam os incrementos no mesmo contador.
+ */
+void consumeByteStats(void *context, const unsigned char *data, size_t length)
+{
+    ByteStats *stats = context;
+    uint32_t lanes[BYTE_STATS_LANES][256];
+    memset(lanes, 0, sizeof(lanes));
+
+    size_t i = 0;
+    for (; i + BYTE_STATS_LANES <= length; i += BYTE_STATS_LANES)
+    {
+        lanes[0][data[i]]++;
+        lanes[1][data[i + 1]]++;
+        lanes[2][data[i + 2]]++;
+        lanes[3][data[i + 3]]++;
+    }
+    for (; i < length; i++)
+        lanes[0][data[i]]++;
+
+    for (int byte = 0; byte < 256; byte++)
+        stats->counts[byte] += (uint64_t)lanes[0][byte] + lanes[1][byte] + lanes[2][byte] + lanes[3][byte];
+    stats->total += length;
+}
+
+// Entropia de Shannon em bits por byte (0 a 8)
+double byteStatsEntropy(const ByteStats *stats)
+{
+    if (stats->total == 0)
+        return 0;
+
+    double entropy = 0;
+    for (int byte = 0; byte < 256; byte++)
+    {
+        if (stats->counts[byte] == 0)
+            continue;
+        double probability = (double)stats->counts[byte] / stats->total;
+        entropy -= probability * log2(probability);
+    }
+    return entropy;
+}
+
+// Proporção de bytes ASCII imprimíveis ou de espaçamento (tab, mudança de linha)
+double byteStatsPrintableRatio(const ByteStats *stats)
+{
+    if (stats->total == 0)
+        return 0;
+
+    uint64_t printable = stats->counts['\t'] + stats->counts['\n'] + stats->counts['\r'];
+    for (int byte = 0x20; byte < 0x7f; byte++)
+        printable += stats->counts[byte];
+    return (double)printable / stats->total;
+}
\ No newline at end of file
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // pipe2
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,9 @@
 
 #define BUFFER_SIZE 512
 
+// Variável de ambiente com o fd onde um processo filho deve escrever o seu relatório
+#define REPORT_FD_ENV "FORENSIC_REPORT_FD"
+
 int runCmd(char *cmdArgv[], int cmdArgc)
 {
     int infoPipe[2];
@@ -96,8 +100,10 @@ int routeCmd(char *cmdArgv[], int *PIPEREAD_FILENO)
     // Criar pipe para ligar file a forensic
     // Ao chamar pipe(), são adicionados file descriptors à file table
     // 0 - stdin, 1 - stdout, 2 - stderr, 3 - pipeIn[0] (read), 4 - pipeIn[1] (write)
+    // O_CLOEXEC: com "-j" outras threads podem fazer fork() ao mesmo tempo, e os seus filhos não devem herdar
+    // o pipe (o read() só veria EOF quando também esses terminassem). O dup2() no filho limpa a flag.
     int pipeIn[2];
-    if (pipe(pipeIn) == -1)
+    if (pipe2(pipeIn, O_CLOEXEC) == -1)
     {
         perror("pipe() error");
         return -1;
@@ -141,6 +147,67 @@ int routeCmd(char *cmdArgv[], int *PIPEREAD_FILENO)
     return 0;
 }
 
+/*
+ * Igual a routeCmd(), mas com os dados indicados no stdin do comando. Os dados são escritos no pipe antes do
+ * fork(), por isso só é escrito o que cabe no pipe, sem bloquear nem SIGPIPE se o comando não ler tudo.
+ */
+int routeCmdInput(char *cmdArgv[], const void *input, size_t length, int *PIPEREAD_FILENO)
+{
+    int pipeOut[2];
+    if (pipe2(pipeOut, O_CLOEXEC) == -1)
+    {
+        perror("pipe() error");
+        return -1;
+    }
+    fcntl(pipeOut[1], F_SETFL, O_NONBLOCK);
+
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t count = write(pipeOut[1], (const char *)input + written, length - written);
+        if (count <= 0)
+            break;
+        written += count;
+    }
+    close(pipeOut[1]);
+
+    int pipeIn[2];
+    if (pipe2(pipeIn, O_CLOEXEC) == -1)
+    {
+        perror("pipe() error");
+        close(pipeOut[0]);
+        return -1;
+    }
+
+    pid_t pid;
+    if ((pid = fork()) < 0)
+    {
+        perror("fork() error");
+        close(pipeOut[0]);
+        close(pipeIn[0]);
+        close(pipeIn[1]);
+        return -1;
+    }
+    else if (pid == 0)
+    {
+        dup2(pipeOut[0], STDIN_FILENO);
+        dup2(pipeIn[1], STDOUT_FILENO);
+
+        if (execvp(cmdArgv[0], cmdArgv) == -1)
+        {
+            perror("execvp() error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    close(pipeOut[0]);
+    close(pipeIn[1]);
+    waitpid(pid, NULL, 0);
+    *PIPEREAD_FILENO = pipeIn[0];
+
+    return 0;
+}
+
 int readRoutedCmdOutput(char **buffer, int PIPEREAD_FILENO)
 {
     // Abrir o "ficheiro" pipe-read
@@ -148,6 +215,7 @@ int readRoutedCmdOutput(char **buffer, int PIPEREAD_FILENO)
     if (fileOutput == NULL)
     {
         perror("fdopen() error");
+        close(PIPEREAD_FILENO);
         return -1;
     }
 
@@ -161,9 +229,103 @@ int readRoutedCmdOutput(char **buffer, int PIPEREAD_FILENO)
         sprintf(*buffer, "%s%s", *buffer, tempBuffer);
     }
 
-    // Fechar ficheiro e pipe
+    // Fechar ficheiro (fecha também o pipe: um segundo close() poderia fechar o fd que outra thread acabou de abrir)
     fclose(fileOutput);
-    close(PIPEREAD_FILENO);
 
     return 0;
+}
+
+int runReportingCmd(char *cmdArgv[], int cmdArgc, char **report)
+{
+    // Pipe por onde o filho envia o relatório, separado do stdout (onde continua a escrever o output normal)
+    // O_CLOEXEC como em routeCmd(): só este filho deve herdar o pipe, não os de outras threads
+    int reportPipe[2];
+    if (pipe2(reportPipe, O_CLOEXEC) == -1)
+    {
+        perror("pipe() error");
+        return -1;
+    }
+
+    pid_t pid;
+    if ((pid = fork()) < 0) // Ocorreu um erro
+    {
+        perror("fork() error");
+        close(reportPipe[0]);
+        close(reportPipe[1]);
+        return -1;
+    }
+    else if (pid == 0) // Corre apenas no processo filho
+    {
+        // O filho não herda o fd de relatório deste processo, apenas o seu próprio.
+        char *parentFd = getenv(REPORT_FD_ENV);
+        if (parentFd != NULL)
+            close(atoi(parentFd));
+
+        // Indicar ao filho qual o fd de escrita do relatório.
+        char fdString[16];
+        sprintf(fdString, "%d", reportPipe[1]);
+        setenv(REPORT_FD_ENV, fdString, 1);
+        fcntl(reportPipe[1], F_SETFD, 0); // O fd de escrita tem de sobreviver ao execvp()
+        close(reportPipe[0]);
+
+        if (execvp(cmdArgv[0], cmdArgv) == -1)
+        {
+            perror("execvp() error");
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(cmdArgv[cmdArgc - 1]);
+
+    // Execução do pai continua aqui.
+    // Ler o relatório até EOF antes do waitpid(), para o filho nunca ficar bloqueado com o pipe cheio.
+    close(reportPipe[1]);
+
+    size_t length = 0;
+    ssize_t readBytes;
+    *report = malloc(BUFFER_SIZE + 1);
+    while (*report != NULL && (readBytes = read(reportPipe[0], *report + length, BUFFER_SIZE)) > 0)
+    {
+        length += readBytes;
+        *report = realloc(*report, length + BUFFER_SIZE + 1);
+    }
+    close(reportPipe[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    if (*report == NULL)
+        return -1;
+    (*report)[length] = '\0';
+
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+int sendReport(const char *report)
+{
+    // Só os processos lançados por runReportingCmd() têm onde escrever o relatório.
+    char *fdString = getenv(REPORT_FD_ENV);
+    if (fdString == NULL)
+        return -1;
+
+    int fd = atoi(fdString);
+    size_t length = strlen(report);
+    while (length > 0)
+    {
+        ssize_t written = write(fd, report, length);
+        if (written == -1)
+        {
+            perror("write() error");
+            return -1;
+        }
+        report += written;
+        length -= written;
+    }
+    close(fd);
+
+    return 0;
+}
+
+int isReportingChild(void)
+{
+    return getenv(REPORT_FD_ENV) != NULL;
 }
\ No newline at end of file
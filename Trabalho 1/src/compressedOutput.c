@@ -0,0 +1,242 @@
+#define _GNU_SOURCE // fopencookie
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "compressedOutput.h"
+#include "lz.h"
+
+// Blocos em memória: um a ser preenchido e os restantes à espera da compressão
+#define FRAME_SLOTS 3
+
+typedef struct
+{
+    int fd;
+
+    unsigned char *slots[FRAME_SLOTS];
+    size_t length[FRAME_SLOTS];
+    int full[FRAME_SLOTS];
+    size_t filling;    // Bloco a ser preenchido pelas escritas
+    size_t compressed; // Próximo bloco a comprimir
+    int closing;
+    int error;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} CompressedOutput;
+
+static uint32_t frameChecksum(const unsigned char *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static void putU32(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t getU32(const unsigned char *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int parseFrameHeader(const unsigned char *data, size_t available, FrameHeader *header)
+{
+    if (available < FRAME_HEADER_SIZE || memcmp(data, FRAME_MAGIC, 4) != 0)
+        return -1;
+    header->rawLength = getU32(data + 4);
+    header->storedLength = getU32(data + 8);
+    header->checksum = getU32(data + 12);
+    if (header->rawLength > FRAME_BLOCK_SIZE || header->storedLength > LZ_COMPRESS_BOUND(FRAME_BLOCK_SIZE))
+        return -1;
+    return 0;
+}
+
+// Descomprimir um bloco para output (com pelo menos rawLength bytes) e validar o checksum.
+int decodeFrame(const FrameHeader *header, const unsigned char *payload, unsigned char *output)
+{
+    if (header->storedLength == header->rawLength)
+        memcpy(output, payload, header->rawLength);
+    else if (lzDecompress(payload, header->storedLength, output, header->rawLength) != (long)header->rawLength)
+        return -1;
+    return (frameChecksum(output, header->rawLength) == header->checksum) ? 0 : -1;
+}
+
+// Cada bloco é escrito com um único write(), para os blocos de processos diferentes não se misturarem.
+static int writeFrame(int fd, const unsigned char *raw, size_t rawLength, unsigned char *frame)
+{
+    size_t storedLength = lzCompress(raw, rawLength, frame + FRAME_HEADER_SIZE, LZ_COMPRESS_BOUND(FRAME_BLOCK_SIZE));
+    if (storedLength == 0 || storedLength >= rawLength)
+    {
+        memcpy(frame + FRAME_HEADER_SIZE, raw, rawLength);
+        storedLength = rawLength;
+    }
+
+    memcpy(frame, FRAME_MAGIC, 4);
+    putU32(frame + 4, rawLength);
+    putU32(frame + 8, storedLength);
+    putU32(frame + 12, frameChecksum(raw, rawLength));
+
+    size_t length = FRAME_HEADER_SIZE + storedLength;
+    return (write(fd, frame, length) == (ssize_t)length) ? 0 : -1;
+}
+
+// A compressão e a escrita correm nesta thread, em paralelo com a análise.
+static void *compressWorker(void *arg)
+{
+    CompressedOutput *out = arg;
+    unsigned char *frame = malloc(FRAME_HEADER_SIZE + LZ_COMPRESS_BOUND(FRAME_BLOCK_SIZE));
+
+    pthread_mutex_lock(&out->lock);
+    while (1)
+    {
+        size_t slot = out->compressed;
+        while (!out->full[slot] && !out->closing)
+            pthread_cond_wait(&out->changed, &out->lock);
+        if (!out->full[slot])
+            break;
+        pthread_mutex_unlock(&out->lock);
+
+        int ret = (frame == NULL) ? -1 : writeFrame(out->fd, out->slots[slot], out->length[slot], frame);
+
+        pthread_mutex_lock(&out->lock);
+        if (ret != 0)
+            out->error = 1;
+        out->full[slot] = 0;
+        out->length[slot] = 0;
+        out->compressed = (slot + 1) % FRAME_SLOTS;
+        pthread_cond_broadcast(&out->changed);
+    }
+    pthread_mutex_unlock(&out->lock);
+
+    free(frame);
+    return NULL;
+}
+
+/*
+ * Entregar o bloco a ser preenchido à compressão, até ao fim da última linha completa (ou inteiro, no fecho
+ * ou se uma linha não couber num bloco). O resto passa para o bloco seguinte.
+ */
+static void submitBlock(CompressedOutput *out, int final)
+{
+    size_t slot = out->filling;
+    size_t cut = out->length[slot];
+    if (!final)
+    {
+        while (cut > 0 && out->slots[slot][cut - 1] != '\n')
+            cut--;
+        if (cut == 0)
+            cut = out->length[slot];
+    }
+    if (cut == 0)
+        return;
+
+    size_t next = (slot + 1) % FRAME_SLOTS;
+    pthread_mutex_lock(&out->lock);
+    while (out->full[next])
+        pthread_cond_wait(&out->changed, &out->lock);
+    pthread_mutex_unlock(&out->lock);
+
+    memcpy(out->slots[next], out->slots[slot] + cut, out->length[slot] - cut);
+    out->length[next] = out->length[slot] - cut;
+
+    pthread_mutex_lock(&out->lock);
+    out->length[slot] = cut;
+    out->full[slot] = 1;
+    out->filling = next;
+    pthread_cond_broadcast(&out->changed);
+    pthread_mutex_unlock(&out->lock);
+}
+
+static ssize_t cookieWrite(void *cookie, const char *data, size_t size)
+{
+    CompressedOutput *out = cookie;
+    if (out->error)
+        return 0;
+
+    for (size_t written = 0; written < size;)
+    {
+        size_t slot = out->filling;
+        size_t chunk = FRAME_BLOCK_SIZE - out->length[slot];
+        if (chunk > size - written)
+            chunk = size - written;
+        memcpy(out->slots[slot] + out->length[slot], data + written, chunk);
+        out->length[slot] += chunk;
+        written += chunk;
+
+        if (out->length[slot] == FRAME_BLOCK_SIZE)
+            submitBlock(out, 0);
+    }
+    return size;
+}
+
+static int cookieClose(void *cookie)
+{
+    CompressedOutput *out = cookie;
+    submitBlock(out, 1);
+
+    pthread_mutex_lock(&out->lock);
+    out->closing = 1;
+    pthread_cond_broadcast(&out->changed);
+    pthread_mutex_unlock(&out->lock);
+    pthread_join(out->thread, NULL);
+
+    int ret = (out->error || close(out->fd) != 0) ? EOF : 0;
+    for (size_t i = 0; i < FRAME_SLOTS; i++)
+        free(out->slots[i]);
+    pthread_mutex_destroy(&out->lock);
+    pthread_cond_destroy(&out->changed);
+    free(out);
+
+    return ret;
+}
+
+// Abrir o ficheiro (em modo append) como um FILE normal, cujas escritas são comprimidas por blocos.
+FILE *openCompressedOutput(const char *path)
+{
+    CompressedOutput *out = calloc(1, sizeof(CompressedOutput));
+    if (out == NULL)
+        return NULL;
+
+    int ret = 0;
+    for (size_t i = 0; i < FRAME_SLOTS; i++)
+        if ((out->slots[i] = malloc(FRAME_BLOCK_SIZE)) == NULL)
+            ret = -1;
+
+    if (ret == 0 && (out->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) == -1)
+    {
+        perror("open() error");
+        ret = -1;
+    }
+    else if (ret == 0)
+    {
+        pthread_mutex_init(&out->lock, NULL);
+        pthread_cond_init(&out->changed, NULL);
+        if (pthread_create(&out->thread, NULL, compressWorker, out) != 0)
+        {
+            perror("pthread_create() error");
+            close(out->fd);
+            ret = -1;
+        }
+    }
+
+    cookie_io_functions_t functions = {NULL, cookieWrite, NULL, cookieClose};
+    FILE *file = (ret == 0) ? fopencookie(out, "a", functions) : NULL;
+    if (file == NULL)
+    {
+        for (size_t i = 0; i < FRAME_SLOTS; i++)
+            free(out->slots[i]);
+        free(out);
+        return NULL;
+    }
+    return file;
+}
\ No newline at end of file
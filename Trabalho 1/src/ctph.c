@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include "ctph.h"
+
+#define CTPH_MIN_BLOCKSIZE 3
+#define CTPH_HASH_PRIME 0x01000193
+#define CTPH_HASH_INIT 0x28021967
+
+// Tamanho médio dos pedaços do i-ésimo sumário
+#define CTPH_BLOCKSIZE(i) ((uint32_t)CTPH_MIN_BLOCKSIZE << (i))
+
+static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*
+ * Cálculo
+ *
+ * São mantidos em simultâneo os sumários de vários tamanhos de pedaço, porque o tamanho certo depende do
+ * tamanho do ficheiro, que só é conhecido no fim. Os tamanhos demasiado pequenos vão sendo descartados.
+ */
+
+void initCtph(CtphState *state)
+{
+    memset(state, 0, sizeof(CtphState));
+    state->bhend = 1;
+    state->bh[0].h = CTPH_HASH_INIT;
+    state->bh[0].halfh = CTPH_HASH_INIT;
+}
+
+static uint32_t rollSum(const CtphState *state)
+{
+    return state->h1 + state->h2 + state->h3;
+}
+
+static void forkBlockHash(CtphState *state)
+{
+    if (state->bhend >= CTPH_NUM_BLOCKHASHES)
+        return;
+
+    const CtphBlockHash *last = &state->bh[state->bhend - 1];
+    CtphBlockHash *next = &state->bh[state->bhend++];
+    next->h = last->h;
+    next->halfh = last->halfh;
+    next->halfdigest = '\0';
+    next->dlen = 0;
+}
+
+static void reduceBlockHash(CtphState *state)
+{
+    if (state->bhend - state->bhstart < 2)
+        return;
+    if ((uint64_t)CTPH_BLOCKSIZE(state->bhstart) * CTPH_SPAMSUM_LENGTH >= state->totalSize)
+        return;
+    if (state->bh[state->bhstart + 1].dlen < CTPH_SPAMSUM_LENGTH / 2)
+        return;
+    state->bhstart++;
+}
+
+static void stepCtph(CtphState *state, unsigned char c)
+{
+    // Hash rolante dos últimos CTPH_ROLLING_WINDOW bytes
+    state->h2 -= state->h1;
+    state->h2 += CTPH_ROLLING_WINDOW * (uint32_t)c;
+    state->h1 += c;
+    state->h1 -= state->window[state->n % CTPH_ROLLING_WINDOW];
+    state->window[state->n % CTPH_ROLLING_WINDOW] = c;
+    state->n++;
+    state->h3 = (state->h3 << 5) ^ c;
+    uint32_t h = rollSum(state);
+
+    for (unsigned int i = state->bhstart; i < state->bhend; i++)
+    {
+        state->bh[i].h = (state->bh[i].h * CTPH_HASH_PRIME) ^ c;
+        state->bh[i].halfh = (state->bh[i].halfh * CTPH_HASH_PRIME) ^ c;
+    }
+
+    // Fim de um pedaço: acrescentar um carácter ao sumário de cada tamanho em que o hash rolante o indica
+    for (unsigned int i = state->bhstart; i < state->bhend; i++)
+    {
+        CtphBlockHash *bh = &state->bh[i];
+        if (h % CTPH_BLOCKSIZE(i) != CTPH_BLOCKSIZE(i) - 1)
+            break;
+        if (bh->dlen == 0)
+            forkBlockHash(state);
+
+        bh->digest[bh->dlen] = B64[bh->h % 64];
+        bh->halfdigest = B64[bh->halfh % 64];
+        if (bh->dlen < CTPH_SPAMSUM_LENGTH - 1)
+        {
+            bh->dlen++;
+            bh->h = CTPH_HASH_INIT;
+            if (bh->dlen < CTPH_SPAMSUM_LENGTH / 2)
+            {
+                bh->halfh = CTPH_HASH_INIT;
+                bh->halfdigest = '\0';
+            }
+        }
+        else
+            reduceBlockHash(state);
+    }
+}
+
+void consumeCtph(void *context, const unsigned char *data, size_t length)
+{
+    CtphState *state = context;
+    state->totalSize += length;
+    for (size_t i = 0; i < length; i++)
+        stepCtph(state, data[i]);
+}
+
+void ctphResult(const CtphState *state, char result[CTPH_MAX_RESULT])
+{
+    uint32_t h = rollSum(state);
+
+    // Menor tamanho de pedaço que produz no máximo CTPH_SPAMSUM_LENGTH caracteres, com pelo menos metade
+    unsigned int bi = state->bhstart;
+    while (bi + 1 < CTPH_NUM_BLOCKHASHES && (uint64_t)CTPH_BLOCKSIZE(bi) * CTPH_SPAMSUM_LENGTH < state->totalSize)
+        bi++;
+    while (bi >= state->bhend)
+        bi--;
+    while (bi > state->bhstart && state->bh[bi].dlen < CTPH_SPAMSUM_LENGTH / 2)
+        bi--;
+
+    char *next = result + sprintf(result, "%u:", CTPH_BLOCKSIZE(bi));
+    memcpy(next, state->bh[bi].digest, state->bh[bi].dlen);
+    next += state->bh[bi].dlen;
+    if (h != 0)
+        *next++ = B64[state->bh[bi].h % 64];
+    *next++ = ':';
+
+    // Segunda parte: o dobro do tamanho, truncada a metade do comprimento
+    if (bi < state->bhend - 1)
+    {
+        const CtphBlockHash *bh = &state->bh[bi + 1];
+        unsigned int length = (bh->dlen > CTPH_SPAMSUM_LENGTH / 2 - 1) ? CTPH_SPAMSUM_LENGTH / 2 - 1 : bh->dlen;
+        memcpy(next, bh->digest, length);
+        next += length;
+        if (h != 0)
+            *next++ = B64[bh->halfh % 64];
+    }
+    else if (h != 0)
+        *next++ = B64[state->bh[bi].h % 64];
+    *next = '\0';
+}
+
+/*
+ * Comparação
+ */
+
+static int isB64(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+}
+
+// Copiar uma parte, mantendo no máximo 3 caracteres iguais seguidos. Devolve o tamanho lido, ou -1.
+static long copyPart(const char *text, size_t length, char *part, size_t *partLength)
+{
+    size_t i = 0;
+    *partLength = 0;
+    for (; i < length && isB64(text[i]); i++)
+    {
+        if (i >= CTPH_SPAMSUM_LENGTH)
+            return -1;
+        if (i < 3 || text[i] != text[i - 1] || text[i] != text[i - 2] || text[i] != text[i - 3])
+            part[(*partLength)++] = text[i];
+    }
+    part[*partLength] = '\0';
+    return i;
+}
+
+// Ler um sumário "tamanho:parte1:parte2" de length caracteres. Devolve -1 se não for um sumário válido.
+int parseCtph(const char *text, size_t length, CtphDigest *digest)
+{
+    size_t i = 0;
+    uint64_t blockSize = 0;
+    for (; i < length && text[i] >= '0' && text[i] <= '9' && blockSize <= UINT32_MAX; i++)
+        blockSize = blockSize * 10 + (text[i] - '0');
+    if (i == 0 || i >= length || text[i] != ':' || blockSize < CTPH_MIN_BLOCKSIZE || blockSize > UINT32_MAX)
+        return -1;
+    digest->blockSize = blockSize;
+    i++;
+
+    long used = copyPart(text + i, length - i, digest->part1, &digest->length1);
+    if (used == -1 || i + used >= length || text[i + used] != ':')
+        return -1;
+    i += used + 1;
+
+    used = copyPart(text + i, length - i, digest->part2, &digest->length2);
+    if (used == -1 || i + used != length)
+        return -1;
+    return 0;
+}
+
+// Distância de edição com inserções e remoções de custo 1 e substituições de custo 2
+static unsigned int editDistance(const char *a, size_t lengthA, const char *b, size_t lengthB)
+{
+    unsigned int rows[2][CTPH_SPAMSUM_LENGTH + 1];
+    unsigned int *previous = rows[0], *current = rows[1];
+
+    for (size_t j = 0; j <= lengthB; j++)
+        previous[j] = j;
+    for (size_t i = 1; i <= lengthA; i++)
+    {
+        current[0] = i;
+        for (size_t j = 1; j <= lengthB; j++)
+        {
+            unsigned int cost = previous[j - 1] + ((a[i - 1] == b[j - 1]) ? 0 : 2);
+            if (previous[j] + 1 < cost)
+                cost = previous[j] + 1;
+            if (current[j - 1] + 1 < cost)
+                cost = current[j - 1] + 1;
+            current[j] = cost;
+        }
+        unsigned int *swap = previous;
+        previous = current;
+        current = swap;
+    }
+    return previous[lengthB];
+}
+
+static int hasCommonSubstring(const char *a, size_t lengthA, const char *b, size_t lengthB)
+{
+    for (size_t i = 0; i + CTPH_ROLLING_WINDOW <= lengthA; i++)
+        for (size_t j = 0; j + CTPH_ROLLING_WINDOW <= lengthB; j++)
+            if (memcmp(a + i, b + j, CTPH_ROLLING_WINDOW) == 0)
+                return 1;
+    return 0;
+}
+
+// Pontuação (0 a 100) de duas partes do mesmo tamanho de pedaço, que só são comparáveis se tiverem 7 caracteres em comum.
+static int scoreParts(const char *a, size_t lengthA, const char *b, size_t lengthB, uint64_t blockSize)
+{
+    if (!hasCommonSubstring(a, lengthA, b, lengthB))
+        return 0;
+
+    unsigned int score = editDistance(a, lengthA, b, lengthB);
+    score = score * CTPH_SPAMSUM_LENGTH / (lengthA + lengthB);
+    score = 100 * score / CTPH_SPAMSUM_LENGTH;
+    if (score >= 100)
+        return 0;
+    score = 100 - score;
+
+    // Em ficheiros pequenos as partes são curtas e a pontuação é limitada
+    if (blockSize >= (99 + CTPH_ROLLING_WINDOW) / CTPH_ROLLING_WINDOW * CTPH_MIN_BLOCKSIZE)
+        return score;
+    uint64_t cap = blockSize / CTPH_MIN_BLOCKSIZE * ((lengthA < lengthB) ? lengthA : lengthB);
+    return (score > cap) ? (int)cap : (int)score;
+}
+
+int compareCtph(const CtphDigest *a, const CtphDigest *b)
+{
+    uint64_t sizeA = a->blockSize, sizeB = b->blockSize;
+
+    if (sizeA == sizeB && a->length1 == b->length1 && a->length2 == b->length2 &&
+        memcmp(a->part1, b->part1, a->length1) == 0 && memcmp(a->part2, b->part2, a->length2) == 0)
+        return 100;
+
+    // Só são comparáveis partes com o mesmo tamanho de pedaço
+    if (sizeA == sizeB)
+    {
+        int score1 = scoreParts(a->part1, a->length1, b->part1, b->length1, sizeA);
+        int score2 = scoreParts(a->part2, a->length2, b->part2, b->length2, sizeA * 2);
+        return (score1 > score2) ? score1 : score2;
+    }
+    if (sizeA * 2 == sizeB)
+        return scoreParts(a->part2, a->length2, b->part1, b->length1, sizeB);
+    if (sizeB * 2 == sizeA)
+        return scoreParts(a->part1, a->length1, b->part2, b->length2, sizeA);
+    return 0;
+}
\ No newline at end of file
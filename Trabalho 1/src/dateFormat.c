@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dateFormat.h"
+
+// Datas das colunas do output, usadas também pelo forensic-query para os resultados poderem ser comparados
+int GetFormattedDate(struct tm *ts, char **formattedDate)
+{
+    // Até 11 dígitos no ano, 2 em cada um dos restantes campos, os separadores e o '\0'
+    *formattedDate = malloc(32);
+    if (*formattedDate == NULL)
+        return -1;
+    if (sprintf(*formattedDate, "%d-%d-%dT%d:%d:%d", ts->tm_year + 1900, ts->tm_mon, ts->tm_mday, ts->tm_hour, ts->tm_min, ts->tm_sec) < 0)
+    {
+        perror("sprintf() error: ");
+        return -1;
+    }
+    return 0;
+}
\ No newline at end of file
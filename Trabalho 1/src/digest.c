@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <string.h>
+#include "digest.h"
+
+static const char *DIGEST_NAMES[DIGEST_COUNT] = {"md5", "sha1", "sha256"};
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * MD5 (RFC 1321)
+ */
+
+static const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+static const unsigned char MD5_R[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+
+static void md5Block(uint32_t state[4], const unsigned char *block)
+{
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] | (uint32_t)block[i * 4 + 1] << 8 | (uint32_t)block[i * 4 + 2] << 16 | (uint32_t)block[i * 4 + 3] << 24;
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t f;
+        int g;
+        if (i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        }
+        else if (i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        uint32_t tmp = d;
+        d = c;
+        c = b;
+        b = b + ROTL(a + f + MD5_K[i] + w[g], MD5_R[i]);
+        a = tmp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+/*
+ * SHA-1 (FIPS 180-4)
+ */
+
+static void sha1Block(uint32_t state[5], const unsigned char *block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        uint32_t tmp = ROTL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROTL(b, 30);
+        b = a;
+        a = tmp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+/*
+ * SHA-256 (FIPS 180-4)
+ */
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void sha256Block(uint32_t state[8], const unsigned char *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + SHA256_K[i] + w[i];
+        uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/*
+ * Interface comum
+ */
+
+int digestFromName(const char *name)
+{
+    for (int i = 0; i < DIGEST_COUNT; i++)
+        if (strcmp(name, DIGEST_NAMES[i]) == 0)
+            return i;
+    return -1;
+}
+
+const char *digestName(int algorithm)
+{
+    return DIGEST_NAMES[algorithm];
+}
+
+void digestInit(DigestCtx *ctx, int algorithm)
+{
+    static const uint32_t MD5_INIT[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    static const uint32_t SHA1_INIT[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    static const uint32_t SHA256_INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memset(ctx, 0, sizeof(DigestCtx));
+    ctx->algorithm = algorithm;
+    if (algorithm == DIGEST_MD5)
+        memcpy(ctx->state, MD5_INIT, sizeof(MD5_INIT));
+    else if (algorithm == DIGEST_SHA1)
+        memcpy(ctx->state, SHA1_INIT, sizeof(SHA1_INIT));
+    else
+        memcpy(ctx->state, SHA256_INIT, sizeof(SHA256_INIT));
+}
+
+static void processBlock(DigestCtx *ctx, const unsigned char *block)
+{
+    if (ctx->algorithm == DIGEST_MD5)
+        md5Block(ctx->state, block);
+    else if (ctx->algorithm == DIGEST_SHA1)
+        sha1Block(ctx->state, block);
+    else
+        sha256Block(ctx->state, block);
+}
+
+void digestUpdate(DigestCtx *ctx, const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+    ctx->length += length;
+
+    // Completar o bloco parcial, se existir
+    if (ctx->blockUsed > 0)
+    {
+        size_t missing = sizeof(ctx->block) - ctx->blockUsed;
+        size_t copy = (length < missing) ? length : missing;
+        memcpy(ctx->block + ctx->blockUsed, bytes, copy);
+        ctx->blockUsed += copy;
+        bytes += copy;
+        length -= copy;
+
+        if (ctx->blockUsed < sizeof(ctx->block))
+            return;
+        processBlock(ctx, ctx->block);
+        ctx->blockUsed = 0;
+    }
+
+    // Processar os blocos completos directamente do buffer
+    while (length >= sizeof(ctx->block))
+    {
+        processBlock(ctx, bytes);
+        bytes += sizeof(ctx->block);
+        length -= sizeof(ctx->block);
+    }
+
+    memcpy(ctx->block, bytes, length);
+    ctx->blockUsed = length;
+}
+
+void digestFinalHex(DigestCtx *ctx, char hex[DIGEST_MAX_HEX_LEN + 1])
+{
+    // Padding: bit 1, zeros e o comprimento em bits (little-endian no MD5, big-endian nos SHA)
+    uint64_t bits = ctx->length * 8;
+    unsigned char padding[72] = {0x80};
+    size_t padLength = (ctx->blockUsed < 56) ? 56 - ctx->blockUsed : 120 - ctx->blockUsed;
+    for (int i = 0; i < 8; i++)
+        padding[padLength + i] = (ctx->algorithm == DIGEST_MD5) ? (unsigned char)(bits >> (8 * i)) : (unsigned char)(bits >> (56 - 8 * i));
+
+    uint64_t length = ctx->length;
+    digestUpdate(ctx, padding, padLength + 8);
+    ctx->length = length;
+
+    int words = (ctx->algorithm == DIGEST_MD5) ? 4 : (ctx->algorithm == DIGEST_SHA1) ? 5 : 8;
+    for (int i = 0; i < words; i++)
+    {
+        uint32_t word = ctx->state[i];
+        if (ctx->algorithm == DIGEST_MD5)
+            word = (word >> 24) | ((word >> 8) & 0xff00) | ((word << 8) & 0xff0000) | (word << 24);
+        sprintf(hex + i * 8, "%08x", word);
+    }
+}
\ No newline at end of file
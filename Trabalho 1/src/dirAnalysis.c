@@ -1,12 +1,649 @@
 #include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "digest.h"
 #include "fileAnalysis.h"
+#include "ioGovernor.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "timeline.h"
 #include "cmdHelper.h"
 #include "dirAnalysis.h"
 
-int analyseDir(char *argv[], int argc, char *hashFunctions, FILE *outputFile, char *targetLocation)
+// Número máximo de entradas lidas do diretório antes de serem ordenadas e processadas
+#define ORDER_BATCH_SIZE 4096
+
+// Com "-j", entradas vistas de uma vez para escolher os maiores ficheiros primeiro
+#define SCHEDULE_WINDOW 1024
+
+// Com "-j" e output ordenado, ficheiros que podem ser analisados à frente do primeiro por escrever, por thread
+#define REORDER_WINDOW_PER_THREAD 8
+
+// Com "-j" e output ordenado, memória do output à espera da sua vez a partir da qual só avança o primeiro
+#define REORDER_MAX_BYTES (16 << 20)
+
+typedef struct
+{
+    char *path;
+    ino_t inode;
+    uint64_t physical;
+
+    // Metadados, obtidos antes de processar o lote quando é preciso o tamanho para o escalonamento
+    struct stat stat;
+    int isLink;
+    int statState; // 0 por obter, 1 obtidos, -1 erro
+} DirEntry;
+
+// Sumário de um filho do diretório, para o sumário Merkle do diretório
+typedef struct
+{
+    char *name;
+    char type; // 'f' ficheiro, 'd' diretório, 'e' erro na análise (sem sumário)
+    char digest[DIGEST_MAX_HEX_LEN + 1];
+} MerkleChild;
+
+// Estado da análise de um diretório
+typedef struct
+{
+    char **argv;
+    int argc;
+    Flags *flags;
+    Summary *summary;
+    char *hashFunctions;
+    FILE *outputFile;
+
+    MerkleChild *children;
+    size_t childCount;
+    size_t childCapacity;
+
+    // Protege os filhos Merkle quando os ficheiros são analisados em paralelo (o resumo é acumulado por thread)
+    pthread_mutex_t lock;
+
+    // Com "-j", quantos ficheiros são lidos ao mesmo tempo
+    IoGovernor *governor;
+} DirWalk;
+
+// Output de uma entrada do lote, guardado até as entradas anteriores serem escritas
+typedef struct
+{
+    char *output;
+    size_t length;
+    int done;
+} ReorderSlot;
+
+// Ficheiros de um lote repartidos pelas threads de análise
+typedef struct
+{
+    DirWalk *walk;
+    DirEntry **files;
+    size_t count;
+    size_t next;
+    int ret;
+    pthread_mutex_t lock;
+
+    // Output ordenado: um lugar por entrada do lote (NULL com "--unordered"), escritos pela ordem do lote
+    DirEntry *batch;
+    size_t batchCount;
+    ReorderSlot *slots;
+    size_t released;      // Entradas do lote já escritas
+    size_t bufferedBytes; // Output guardado à espera das entradas anteriores
+    size_t window;
+    pthread_cond_t progress;
+
+    // Um sub-diretório está a ser analisado por um processo filho, que escreve no mesmo output
+    int childRunning;
+} FileJobs;
+
+// Uma thread de análise, com o seu resumo, juntado ao do diretório quando o lote termina
+typedef struct
+{
+    FileJobs *jobs;
+    Summary summary;
+} FileWorker;
+
+// Obter o endereço físico do primeiro extent do ficheiro (0 se não for possível).
+static uint64_t getFirstExtent(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd == -1)
+        return 0;
+
+    // Pedir ao sistema de ficheiros apenas o primeiro extent
+    char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    memset(buf, 0, sizeof(buf));
+    struct fiemap *fm = (struct fiemap *)buf;
+    fm->fm_start = 0;
+    fm->fm_length = FIEMAP_MAX_OFFSET;
+    fm->fm_extent_count = 1;
+
+    uint64_t physical = 0;
+    if (ioctl(fd, FS_IOC_FIEMAP, fm) == 0 && fm->fm_mapped_extents > 0)
+        physical = fm->fm_extents[0].fe_physical;
+
+    close(fd);
+    return physical;
+}
+
+static int compareByInode(const void *a, const void *b)
+{
+    const DirEntry *ea = a;
+    const DirEntry *eb = b;
+    return (ea->inode > eb->inode) - (ea->inode < eb->inode);
+}
+
+static int compareByExtent(const void *a, const void *b)
+{
+    const DirEntry *ea = a;
+    const DirEntry *eb = b;
+    // Entradas sem extent (vazias, diretórios, ...) ficam pela ordem do inode
+    if (ea->physical != eb->physical)
+        return (ea->physical > eb->physical) - (ea->physical < eb->physical);
+    return compareByInode(a, b);
+}
+
+static int addMerkleChild(DirWalk *walk, const char *path, char type, const char *digest)
+{
+    if (walk->childCount == walk->childCapacity)
+    {
+        size_t capacity = (walk->childCapacity == 0) ? 64 : walk->childCapacity * 2;
+        MerkleChild *children = realloc(walk->children, capacity * sizeof(MerkleChild));
+        if (children == NULL)
+            return -1;
+        walk->children = children;
+        walk->childCapacity = capacity;
+    }
+
+    const char *name = strrchr(path, '/');
+    name = (name == NULL) ? path : name + 1;
+
+    MerkleChild *child = &walk->children[walk->childCount];
+    if ((child->name = malloc(strlen(name) + 1)) == NULL)
+        return -1;
+    strcpy(child->name, name);
+    child->type = type;
+    strcpy(child->digest, digest);
+    walk->childCount++;
+
+    return 0;
+}
+
+// Uma entrada que não foi possível analisar fica no sumário do diretório com a marca de erro, em vez de desaparecer.
+static int addMerkleError(DirWalk *walk, const char *path)
+{
+    if (!walk->flags->merkleDigests)
+        return 0;
+
+    pthread_mutex_lock(&walk->lock);
+    int ret = addMerkleChild(walk, path, 'e', "");
+    pthread_mutex_unlock(&walk->lock);
+    return ret;
+}
+
+static int compareMerkleChildren(const void *a, const void *b)
+{
+    return strcmp(((const MerkleChild *)a)->name, ((const MerkleChild *)b)->name);
+}
+
+/*
+ * Sumário Merkle do diretório: SHA-256 sobre os filhos ordenados pelo nome, cada um como
+ * "nome\0" + tipo + sumário do filho (conteúdo do ficheiro ou sumário Merkle do sub-diretório, vazio com erro).
+ * Dois diretórios com o mesmo sumário têm a mesma árvore, independentemente da ordem do readdir().
+ */
+static void computeMerkleDigest(DirWalk *walk, char digest[DIGEST_MAX_HEX_LEN + 1])
+{
+    qsort(walk->children, walk->childCount, sizeof(MerkleChild), compareMerkleChildren);
+
+    DigestCtx ctx;
+    digestInit(&ctx, DIGEST_SHA256);
+    for (size_t i = 0; i < walk->childCount; i++)
+    {
+        digestUpdate(&ctx, walk->children[i].name, strlen(walk->children[i].name) + 1);
+        digestUpdate(&ctx, &walk->children[i].type, 1);
+        digestUpdate(&ctx, walk->children[i].digest, strlen(walk->children[i].digest));
+    }
+    digestFinalHex(&ctx, digest);
+}
+
+// Analisar o sub-diretório num processo filho e guardar o sumário Merkle que este devolve.
+static int merkleDir(DirWalk *walk, const char *path)
 {
+    char *report = NULL;
+    if (runReportingCmd(walk->argv, walk->argc, &report) != 0)
+    {
+        printf("Error running file command!\n");
+        free(report);
+        return -1;
+    }
+
+    char digest[DIGEST_MAX_HEX_LEN + 1];
+    int ret = -1;
+    if (sscanf(report, "M %64s", digest) == 1)
+        ret = addMerkleChild(walk, path, 'd', digest);
+    else
+        printf("Failed to read directory digest of '%s'\n", path);
+
+    free(report);
+    return ret;
+}
+
+// Analisar o sub-diretório num processo filho e juntar o resumo que este devolve.
+static int summariseDir(char *argv[], int argc, Summary *summary, const char *path)
+{
+    char *report = NULL;
+    if (runReportingCmd(argv, argc, &report) != 0)
+    {
+        printf("Error running file command!\n");
+        free(report);
+        return -1;
+    }
+
+    Summary childSummary;
+    int ret = -1;
+    if (initSummary(&childSummary, summary->topN) == 0 && parseSummary(&childSummary, report) == 0)
+    {
+        const char *name = strrchr(path, '/');
+        ret = mergeSummary(summary, &childSummary, (name == NULL) ? path : name + 1);
+    }
+
+    freeSummary(&childSummary);
+    free(report);
+    return ret;
+}
+
+// Obter os metadados uma única vez, antes de abrir o ficheiro, para avaliar os filtros.
+static int statEntry(DirEntry *entry)
+{
+    struct timespec start;
+    profileStart(&start);
+
+    entry->isLink = 0;
+    entry->statState = -1;
+    if (lstat(entry->path, &entry->stat) == -1)
+    {
+        perror("lstat() error");
+        return -1;
+    }
+    if (S_ISLNK(entry->stat.st_mode))
+    {
+        entry->isLink = 1;
+        if (stat(entry->path, &entry->stat) == -1)
+        {
+            perror("stat() error");
+            return -1;
+        }
+    }
+    entry->statState = 1;
+
+    profileEnd(PROFILE_STAT, &start);
+    return 0;
+}
+
+/*
+ * Analisar um ficheiro regular, com o output escrito em outputFile e, no modo resumo, acumulado em summary.
+ * Pode correr em várias threads em simultâneo, cada uma com o seu resumo.
+ */
+static int analyseFileEntry(DirWalk *walk, DirEntry *entry, FILE *outputFile, Summary *summary)
+{
+    char *path = entry->path;
+    if (!filterAccepts(&walk->flags->filter, path, &entry->stat, entry->isLink))
+        return 0;
+
+    if (summary != NULL) // Modo resumo: apenas acumular
+    {
+        char *fileString = NULL;
+        if (getFileCmdInfo(&fileString, path) == -1 || addToSummary(summary, path, fileString, &entry->stat) == -1)
+            printf("Failed to analyse file '%s'\n", path);
+        free(fileString);
+    }
+    else if (walk->flags->timelineMode) // Linha temporal: apenas registar os eventos
+    {
+        if (addTimelineEvents(path, &entry->stat) == -1)
+            printf("Failed to analyse file '%s'\n", path);
+    }
+    else if (walk->flags->merkleDigests) // Guardar também o sumário do conteúdo para o diretório
+    {
+        char digest[DIGEST_MAX_HEX_LEN + 1];
+        if (analyseFile(walk->flags, walk->hashFunctions, outputFile, path, &entry->stat, digest) == -1)
+        {
+            printf("Failed to analyse file '%s'\n", path);
+            return addMerkleError(walk, path);
+        }
+
+        pthread_mutex_lock(&walk->lock);
+        int ret = addMerkleChild(walk, path, 'f', digest);
+        pthread_mutex_unlock(&walk->lock);
+        if (ret != 0)
+            return -1;
+    }
+    else if (analyseFile(walk->flags, walk->hashFunctions, outputFile, path, &entry->stat, NULL) == -1) // Analisar ficheiro em questão
+        printf("Failed to analyse file '%s'\n", path);
+
+    return 0;
+}
+
+static int analyseEntry(DirWalk *walk, DirEntry *entry)
+{
+    if (entry->statState == 0)
+        statEntry(entry);
+    if (entry->statState == -1)
+        return addMerkleError(walk, entry->path);
+
+    char *path = entry->path;
+    if (S_ISREG(entry->stat.st_mode)) // Ser ficheiro
+        return analyseFileEntry(walk, entry, walk->outputFile, walk->summary);
+    else if (S_ISDIR(entry->stat.st_mode)) // Ser Diretório
+    {
+        size_t length = strlen(path) + 1;
+        walk->argv[walk->argc - 1] = malloc(length);
+        memcpy(walk->argv[walk->argc - 1], path, length);
+
+        // O output do filho tem de ficar depois do que já foi escrito por este processo
+        fflush(walk->outputFile ? walk->outputFile : stdout);
+
+        if (walk->summary != NULL)
+            return summariseDir(walk->argv, walk->argc, walk->summary, path);
+
+        if (walk->flags->merkleDigests)
+            return merkleDir(walk, path);
+
+        if (runCmd(walk->argv, walk->argc) != 0)
+        {
+            printf("Error running file command!\n");
+            return -1;
+        }
+    }
+    else // Erro na análise do tipo do Path
+    {
+        printf("%s\n", path);
+        printf("Erro!\n");
+    }
+    return 0;
+}
+
+// Maiores ficheiros primeiro (LPT), para o maior não ficar a correr sozinho no fim do lote
+static int compareBySizeDesc(const void *a, const void *b)
+{
+    off_t sa = (*(DirEntry *const *)a)->stat.st_size;
+    off_t sb = (*(DirEntry *const *)b)->stat.st_size;
+    return (sa < sb) - (sa > sb);
+}
+
+// Escrever, pela ordem do lote, as entradas seguidas que já terminaram. Chamada com o lock.
+static void releaseOutput(FileJobs *jobs)
+{
+    FILE *outputFile = jobs->walk->outputFile ? jobs->walk->outputFile : stdout;
+    while (jobs->released < jobs->batchCount && jobs->slots[jobs->released].done)
+    {
+        ReorderSlot *slot = &jobs->slots[jobs->released++];
+        if (slot->length > 0) // Diretórios e entradas com erro não têm buffer
+            fwrite(slot->output, 1, slot->length, outputFile);
+        jobs->bufferedBytes -= slot->length;
+        free(slot->output);
+        slot->output = NULL;
+    }
+    pthread_cond_broadcast(&jobs->progress);
+}
+
+static void finishSlot(FileJobs *jobs, size_t index, char *output, size_t length)
+{
+    pthread_mutex_lock(&jobs->lock);
+    jobs->slots[index].output = output;
+    jobs->slots[index].length = length;
+    jobs->slots[index].done = 1;
+    jobs->bufferedBytes += length;
+    releaseOutput(jobs);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+// Output sem ordem: escrever o de um ficheiro, completo, desde que nenhum filho esteja a escrever no mesmo output
+static void writeUnordered(FileJobs *jobs, const char *output, size_t length)
+{
+    pthread_mutex_lock(&jobs->lock);
+    while (jobs->childRunning)
+        pthread_cond_wait(&jobs->progress, &jobs->lock);
+    fwrite(output, 1, length, jobs->walk->outputFile ? jobs->walk->outputFile : stdout);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+static void *fileWorker(void *arg)
+{
+    FileWorker *worker = arg;
+    FileJobs *jobs = worker->jobs;
+    while (1)
+    {
+        // Cada thread livre fica com o maior ficheiro que ainda falta (ou, com output ordenado, com o seguinte)
+        pthread_mutex_lock(&jobs->lock);
+        size_t i = jobs->next++;
+
+        // Com output ordenado, não passar demasiado à frente da primeira entrada por escrever; esta avança sempre
+        if (jobs->slots != NULL && i < jobs->count)
+        {
+            size_t index = jobs->files[i] - jobs->batch;
+            while (index != jobs->released && (index >= jobs->released + jobs->window || jobs->bufferedBytes >= REORDER_MAX_BYTES))
+                pthread_cond_wait(&jobs->progress, &jobs->lock);
+        }
+        pthread_mutex_unlock(&jobs->lock);
+        if (i >= jobs->count)
+            break;
+
+        // O output de cada ficheiro fica à parte até ser a sua vez (ou, sem ordem, até não haver um filho a escrever)
+        DirEntry *entry = jobs->files[i];
+        FILE *outputFile;
+        char *output = NULL;
+        size_t length = 0;
+        if ((outputFile = open_memstream(&output, &length)) == NULL)
+        {
+            perror("open_memstream() error");
+            if (jobs->slots != NULL)
+                finishSlot(jobs, entry - jobs->batch, NULL, 0);
+            pthread_mutex_lock(&jobs->lock);
+            jobs->ret = -1;
+            pthread_mutex_unlock(&jobs->lock);
+            continue;
+        }
+
+        // Esperar que o limite adaptativo deixe ler mais um ficheiro e medir quanto demorou
+        size_t memory = readPipelineFootprint(entry->stat.st_size);
+        acquireIoSlot(jobs->walk->governor, memory);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int ret = analyseFileEntry(jobs->walk, entry, outputFile, jobs->walk->summary ? &worker->summary : NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        releaseIoSlot(jobs->walk->governor, memory, entry->stat.st_size,
+                      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+        fclose(outputFile);
+        if (jobs->slots != NULL)
+            finishSlot(jobs, entry - jobs->batch, output, length);
+        else
+        {
+            writeUnordered(jobs, output, length);
+            free(output);
+        }
+
+        if (ret != 0)
+        {
+            pthread_mutex_lock(&jobs->lock);
+            jobs->ret = -1;
+            pthread_mutex_unlock(&jobs->lock);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Com "-j N" os ficheiros do lote são analisados por N threads. Os sub-diretórios continuam a ser analisados
+ * (por processos filhos) na thread que chama, em paralelo com os ficheiros. Quantas das N threads leem ao mesmo
+ * tempo é decidido pelo limite adaptativo do diretório (ioGovernor).
+ *
+ * Por omissão o output é o mesmo da análise sem "-j": as threads pegam nos ficheiros pela ordem do lote e cada
+ * uma guarda o output do seu ficheiro, que é escrito quando todas as entradas anteriores o foram (um sub-diretório
+ * só é analisado quando chega a sua vez). Para a memória não crescer, uma thread não começa um ficheiro mais de
+ * N * REORDER_WINDOW_PER_THREAD entradas à frente da primeira por escrever, nem com mais de REORDER_MAX_BYTES à
+ * espera, a não ser que seja essa primeira entrada.
+ *
+ * Com "--unordered" os ficheiros são analisados do maior para o menor (os grandes começam logo e os pequenos
+ * preenchem as threads que vão ficando livres) e o output de cada um é escrito quando termina. Enquanto um
+ * sub-diretório corre, as threads não escrevem: o filho escreve no mesmo output e as linhas ficariam partidas.
+ */
+static int processBatchParallel(DirWalk *walk, DirEntry *batch, size_t count)
+{
+    int ordered = !walk->flags->unorderedOutput;
+    DirEntry **files = malloc(count * sizeof(DirEntry *));
+    ReorderSlot *slots = ordered ? calloc(count, sizeof(ReorderSlot)) : NULL;
+    if (files == NULL || (ordered && slots == NULL))
+    {
+        free(files);
+        free(slots);
+        return -1;
+    }
+
+    size_t fileCount = 0;
+    int ret = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (statEntry(&batch[i]) == 0 && S_ISREG(batch[i].stat.st_mode))
+            files[fileCount++] = &batch[i];
+        else if (batch[i].statState == -1)
+        {
+            if (addMerkleError(walk, batch[i].path) != 0)
+                ret = -1;
+            if (ordered) // Sem output, não há nada a esperar
+                slots[i].done = 1;
+        }
+    }
+    if (!ordered)
+        qsort(files, fileCount, sizeof(DirEntry *), compareBySizeDesc);
+
+    FileJobs jobs = {walk, files, fileCount, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+                     batch, count, slots, 0, 0, (size_t)walk->flags->jobs * REORDER_WINDOW_PER_THREAD, PTHREAD_COND_INITIALIZER, 0};
+    if (ordered)
+        releaseOutput(&jobs);
+
+    size_t threadCount = (fileCount < walk->flags->jobs) ? fileCount : walk->flags->jobs;
+    pthread_t threads[threadCount > 0 ? threadCount : 1];
+    FileWorker workers[threadCount > 0 ? threadCount : 1];
+    size_t started = 0;
+    for (; started < threadCount; started++)
+    {
+        workers[started].jobs = &jobs;
+        if (walk->summary != NULL && initSummary(&workers[started].summary, walk->summary->topN) != 0)
+        {
+            freeSummary(&workers[started].summary);
+            break;
+        }
+        if (pthread_create(&threads[started], NULL, fileWorker, &workers[started]) != 0)
+        {
+            perror("pthread_create() error");
+            if (walk->summary != NULL)
+                freeSummary(&workers[started].summary);
+            break;
+        }
+    }
+
+    if (started == 0) // Sem threads, analisar as entradas nesta, pela ordem do lote
+    {
+        for (size_t i = 0; i < count; i++)
+            if (batch[i].statState == 1 && ret == 0 && analyseEntry(walk, &batch[i]) != 0)
+                ret = -1;
+    }
+    else
+        for (size_t i = 0; i < count; i++)
+        {
+            if (batch[i].statState != 1 || S_ISREG(batch[i].stat.st_mode))
+                continue;
+
+            // Com output ordenado, esperar que as entradas anteriores sejam escritas; sem ordem, impedir as threads de
+            // escreverem enquanto o filho corre (analyseEntry despeja antes o que já está no buffer)
+            pthread_mutex_lock(&jobs.lock);
+            while (ordered && jobs.released != i)
+                pthread_cond_wait(&jobs.progress, &jobs.lock);
+            jobs.childRunning = 1;
+            pthread_mutex_unlock(&jobs.lock);
+
+            if (ret == 0 && analyseEntry(walk, &batch[i]) != 0)
+                ret = -1;
+
+            pthread_mutex_lock(&jobs.lock);
+            jobs.childRunning = 0;
+            pthread_cond_broadcast(&jobs.progress);
+            pthread_mutex_unlock(&jobs.lock);
+
+            if (ordered)
+                finishSlot(&jobs, i, NULL, 0);
+        }
+
+    // Os resumos das threads só são juntados depois de terminarem, sem locks durante a análise
+    for (size_t i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+        if (walk->summary != NULL)
+        {
+            if (mergeSummary(walk->summary, &workers[i].summary, NULL) != 0)
+                ret = -1;
+            freeSummary(&workers[i].summary);
+        }
+    }
+    pthread_mutex_destroy(&jobs.lock);
+    pthread_cond_destroy(&jobs.progress);
+
+    for (size_t i = 0; i < count; i++)
+        free(batch[i].path);
+    free(files);
+    free(slots);
+
+    return (ret == 0) ? jobs.ret : ret;
+}
+
+// Ordenar o lote de entradas (se pedido) e processá-las por essa ordem.
+static int processBatch(DirWalk *walk, DirEntry *batch, size_t count)
+{
+    if (walk->flags->traversalOrder == ORDER_EXTENT)
+    {
+        for (size_t i = 0; i < count; i++)
+            batch[i].physical = getFirstExtent(batch[i].path);
+        qsort(batch, count, sizeof(DirEntry), compareByExtent);
+    }
+    else if (walk->flags->traversalOrder == ORDER_INODE)
+        qsort(batch, count, sizeof(DirEntry), compareByInode);
+
+    if (walk->flags->jobs > 1)
+        return processBatchParallel(walk, batch, count);
+
+    int ret = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ret == 0 && analyseEntry(walk, &batch[i]) != 0)
+            ret = -1;
+        free(batch[i].path);
+    }
+    return ret;
+}
+
+static struct dirent *readEntry(DIR *dir)
+{
+    struct timespec start;
+    profileStart(&start);
+    struct dirent *dent = readdir(dir);
+    profileEnd(PROFILE_READDIR, &start);
+    return dent;
+}
+
+int analyseDir(char *argv[], int argc, Flags *flags, Summary *summary, char *hashFunctions, FILE *outputFile, char *targetLocation, char *merkleDigest)
+{
+    DirWalk walk = {argv, argc, flags, summary, hashFunctions, outputFile, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, NULL};
+
     DIR *dir;
     if ((dir = opendir(targetLocation)) == NULL)
     {
@@ -14,8 +651,28 @@ int analyseDir(char *argv[], int argc, char *hashFunctions, FILE *outputFile, ch
         return -1;
     }
 
+    // Sem ordenação nem threads basta um lote de uma entrada, mantendo o comportamento original.
+    size_t batchSize = ORDER_BATCH_SIZE;
+    if (flags->traversalOrder == ORDER_READDIR)
+        batchSize = (flags->jobs > 1) ? SCHEDULE_WINDOW : 1;
+    DirEntry *batch = malloc(batchSize * sizeof(DirEntry));
+    if (batch == NULL)
+    {
+        closedir(dir);
+        return -1;
+    }
+
+    IoGovernor governor;
+    if (flags->jobs > 1)
+    {
+        initIoGovernor(&governor, flags->minJobs, flags->jobs, flags->maxOpenFiles, flags->maxBufferMemory);
+        walk.governor = &governor;
+    }
+
+    int ret = 0;
+    size_t count = 0;
     struct dirent *dent;
-    while ((dent = readdir(dir)) != NULL)
+    while (ret == 0 && (dent = readEntry(dir)) != NULL)
     {
         if (strcmp(dent->d_name, ".") != 0 && strcmp(dent->d_name, "..") != 0) //Ignorar paths que não estão dentro da folder
         {
@@ -23,44 +680,51 @@ int analyseDir(char *argv[], int argc, char *hashFunctions, FILE *outputFile, ch
             path = malloc(strlen(targetLocation) + strlen(dent->d_name) + 1 + 1);
             sprintf(path, "%s/%s", targetLocation, dent->d_name);
 
-            int pathType = checkPathType(path);
-            if (pathType == 0) // Ser ficheiro
-            {
-                // char *outputString = NULL;
-                if (analyseFile(hashFunctions, outputFile, path) == -1) // Analisar ficheiro em questão
-                {
-                    printf("Failed to analyse file '%s'\n", path);
-                    continue;
-                }
-
-                // if (outputFile != NULL)
-                // {
-                //     fprintf(outputFile, "%s\n", outputString);
-                // }
-                // else
-                // {
-                //     printf("%s\n", outputString);
-                // }
-                // free(outputString);
-            }
-            else if (pathType == 1) // Ser Diretório
+            // Entradas excluídas (e, no caso de diretórios, toda a sub-árvore) são ignoradas sem serem abertas.
+            if (filterExcludes(&flags->filter, path))
             {
-                size_t length = strlen(path) + 1;
-                argv[argc - 1] = malloc(length);
-                memcpy(argv[argc - 1], path, length);
-                if (runCmd(argv, argc) != 0)
-                {
-                    printf("Error running file command!\n");
-                    return -1;
-                }
+                free(path);
+                continue;
             }
-            else // Erro na análise do tipo do Path
+
+            batch[count].path = path;
+            batch[count].inode = dent->d_ino;
+            batch[count].physical = 0;
+            batch[count].statState = 0;
+
+            // Lote cheio: ordenar e processar antes de continuar a ler
+            if (++count == batchSize)
             {
-                printf("Erro!\n");
+                ret = processBatch(&walk, batch, count);
+                count = 0;
             }
         }
     }
+
+    if (ret == 0)
+        ret = processBatch(&walk, batch, count);
+    else
+        for (size_t i = 0; i < count; i++)
+            free(batch[i].path);
+
+    free(batch);
     closedir(dir);
 
-    return 0;
+    // Com todos os filhos analisados, calcular e escrever o sumário Merkle do diretório
+    if (ret == 0 && flags->merkleDigests)
+    {
+        computeMerkleDigest(&walk, merkleDigest);
+        if (outputFile)
+            fprintf(outputFile, "%s,directory,%s\n", targetLocation, merkleDigest);
+        else
+            printf("%s,directory,%s\n", targetLocation, merkleDigest);
+    }
+    for (size_t i = 0; i < walk.childCount; i++)
+        free(walk.children[i].name);
+    free(walk.children);
+    pthread_mutex_destroy(&walk.lock);
+    if (walk.governor != NULL)
+        destroyIoGovernor(walk.governor);
+
+    return ret;
 }
\ No newline at end of file
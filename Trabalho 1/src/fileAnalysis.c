@@ -3,7 +3,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include "afalg.h"
+#include "archive.h"
+#include "byteStats.h"
 #include "cmdHelper.h"
+#include "ctph.h"
+#include "digest.h"
+#include "manifest.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "signatures.h"
 #include "fileAnalysis.h"
 
 int checkPathType(const char *path)
@@ -19,22 +28,37 @@ int checkPathType(const char *path)
     return -1;
 }
 
-int GetFormattedDate(struct tm *ts, char **formattedDate)
+int getFileCmdInfo(char **buffer, char *targetLocation)
 {
-    *formattedDate = malloc(19);
-    if (sprintf(*formattedDate, "%d-%d-%dT%d:%d:%d", ts->tm_year + 1900, ts->tm_mon, ts->tm_mday, ts->tm_hour, ts->tm_min, ts->tm_sec) < 0)
+    int PIPEREAD_FILENO;
+    char *fileArgs[3] = {"file", targetLocation, NULL};
+    if (routeCmd(fileArgs, &PIPEREAD_FILENO) != 0)
+    {
+        printf("Error running file command!\n");
+        return -1;
+    }
+
+    if (readRoutedCmdOutput(buffer, PIPEREAD_FILENO) != 0)
     {
-        perror("sprintf() error: ");
+        printf("Error reading file command output!\n");
+        return -1;
+    }
+
+    if (sscanf(*buffer, "%*[^:]: %[^,\n]", *buffer) == EOF)
+    {
+        perror("sscanf() error");
         return -1;
     }
+
     return 0;
 }
 
-int getFileCmdInfo(char **buffer, char *targetLocation)
+// Tipo de um membro de arquivo: o comando "file" recebe no stdin o início dos dados, guardado durante a leitura
+static int getFileCmdInfoFromData(char **buffer, const unsigned char *data, size_t length)
 {
     int PIPEREAD_FILENO;
-    char *fileArgs[3] = {"file", targetLocation, NULL};
-    if (routeCmd(fileArgs, &PIPEREAD_FILENO) != 0)
+    char *fileArgs[3] = {"file", "-", NULL};
+    if (routeCmdInput(fileArgs, data, length, &PIPEREAD_FILENO) != 0)
     {
         printf("Error running file command!\n");
         return -1;
@@ -55,152 +79,406 @@ int getFileCmdInfo(char **buffer, char *targetLocation)
     return 0;
 }
 
-int getStatCmdInfo(char **buffer, char *targetLocation)
+typedef struct
 {
-    struct stat fileStat;
-    if (stat(targetLocation, &fileStat) == -1)
-    {
-        perror("stat() error");
-        return -1;
-    }
+    unsigned char *data;
+    size_t length;
+} TypeSample;
 
+static void consumeTypeSample(void *context, const unsigned char *data, size_t length)
+{
+    TypeSample *sample = context;
+    size_t count = (length < FILE_TYPE_SAMPLE - sample->length) ? length : FILE_TYPE_SAMPLE - sample->length;
+    memcpy(sample->data + sample->length, data, count);
+    sample->length += count;
+}
+
+static int formatStatInfo(char **buffer, const struct stat *fileStat)
+{
+    // localtime_r(): com "-j" vários ficheiros são analisados ao mesmo tempo
     char *atimeStr;
     char *ctimeStr;
     char *mtimeStr;
-    GetFormattedDate(localtime(&fileStat.st_atime), &atimeStr);
-    GetFormattedDate(localtime(&fileStat.st_ctime), &ctimeStr);
-    GetFormattedDate(localtime(&fileStat.st_mtime), &mtimeStr);
+    struct tm ts;
+    GetFormattedDate(localtime_r(&fileStat->st_atime, &ts), &atimeStr);
+    GetFormattedDate(localtime_r(&fileStat->st_ctime, &ts), &ctimeStr);
+    GetFormattedDate(localtime_r(&fileStat->st_mtime, &ts), &mtimeStr);
 
-    size_t sizeLength = (fileStat.st_size > 0) ? ((int)(log10(fileStat.st_size) + 1)) : 1;
+    size_t sizeLength = (fileStat->st_size > 0) ? ((int)(log10(fileStat->st_size) + 1)) : 1;
 
     *buffer = malloc(sizeLength + 10 + 57 + 4 + 1); // len(size) + len(permissions) + 4 * ',' + NULL terminator
     sprintf(*buffer, "%ld,%s%s%s%s%s%s%s%s%s%s,%s,%s,%s",
-            fileStat.st_size,
-            (S_ISDIR(fileStat.st_mode)) ? "d" : "-",
-            (fileStat.st_mode & S_IRUSR) ? "r" : "-",
-            (fileStat.st_mode & S_IWUSR) ? "w" : "-",
-            (fileStat.st_mode & S_IXUSR) ? "x" : "-",
-
-            (fileStat.st_mode & S_IRGRP) ? "r" : "-",
-            (fileStat.st_mode & S_IWGRP) ? "w" : "-",
-            (fileStat.st_mode & S_IXGRP) ? "x" : "-",
-
-            (fileStat.st_mode & S_IROTH) ? "r" : "-",
-            (fileStat.st_mode & S_IWOTH) ? "w" : "-",
-            (fileStat.st_mode & S_IXOTH) ? "x" : "-",
+            fileStat->st_size,
+            (S_ISDIR(fileStat->st_mode)) ? "d" : "-",
+            (fileStat->st_mode & S_IRUSR) ? "r" : "-",
+            (fileStat->st_mode & S_IWUSR) ? "w" : "-",
+            (fileStat->st_mode & S_IXUSR) ? "x" : "-",
+
+            (fileStat->st_mode & S_IRGRP) ? "r" : "-",
+            (fileStat->st_mode & S_IWGRP) ? "w" : "-",
+            (fileStat->st_mode & S_IXGRP) ? "x" : "-",
+
+            (fileStat->st_mode & S_IROTH) ? "r" : "-",
+            (fileStat->st_mode & S_IWOTH) ? "w" : "-",
+            (fileStat->st_mode & S_IXOTH) ? "x" : "-",
             atimeStr,
             ctimeStr,
             mtimeStr);
+    free(atimeStr);
+    free(ctimeStr);
+    free(mtimeStr);
     return 0;
 }
 
-int calculateHash(char **buffer, char *hashCmd, char *targetLocation)
+int getStatCmdInfo(char **buffer, char *targetLocation)
 {
-    int PIPEREAD_FILENO;
-    char *hashArgs[3] = {hashCmd, targetLocation, NULL};
-
-    if (routeCmd(hashArgs, &PIPEREAD_FILENO) != 0)
+    struct stat fileStat;
+    if (stat(targetLocation, &fileStat) == -1)
     {
-        printf("Error running hash command!\n");
+        perror("stat() error");
         return -1;
     }
 
-    if (readRoutedCmdOutput(buffer, PIPEREAD_FILENO) != 0)
+    return formatStatInfo(buffer, &fileStat);
+}
+
+static void consumeDigest(void *context, const unsigned char *data, size_t length)
+{
+    digestUpdate(context, data, length);
+}
+
+// Calcular os sumários no espaço do utilizador, numa única leitura do ficheiro (ou de source, se não for NULL)
+// partilhada com as outras análises.
+static int userHashFile(const char *path, PipelineSource *source, const int *algorithms, size_t count,
+                        char hex[][DIGEST_MAX_HEX_LEN + 1], const PipelineStage *extraStages, size_t extraCount)
+{
+    DigestCtx digests[DIGEST_MAX_PER_FILE];
+    PipelineStage stages[DIGEST_MAX_PER_FILE + FILE_ANALYSIS_MAX_STAGES];
+
+    // Um consumidor por cada sumário pedido
+    for (size_t i = 0; i < count; i++)
     {
-        printf("Error reading hash command output!\n");
-        return -1;
+        digestInit(&digests[i], algorithms[i]);
+        stages[i].consume = consumeDigest;
+        stages[i].context = &digests[i];
     }
 
-    if (sscanf(*buffer, "%[^ ]", *buffer) == EOF)
-    {
-        perror("sscanf() error");
+    for (size_t i = 0; i < extraCount; i++)
+        stages[count + i] = extraStages[i];
+
+    int ret = (source != NULL) ? runSourcePipeline(source, stages, count + extraCount)
+                               : runReadPipeline(path, stages, count + extraCount);
+    if (ret == -1)
         return -1;
-    }
+
+    for (size_t i = 0; i < count; i++)
+        digestFinalHex(&digests[i], hex[i]);
 
     return 0;
 }
 
-int processHashes(char **buffer, char *hashFunctions, char *targetLocation)
+int processHashes(char **buffer, Flags *flags, char *hashFunctions, char *targetLocation, PipelineSource *source,
+                  char *contentDigest, const PipelineStage *extraStages, size_t extraCount)
 {
-    char hashCmd[10];
-    size_t doneFirst = 0;
+    int algorithms[DIGEST_MAX_PER_FILE];
+    size_t digestCount = 0;
+    long ctphColumn = -1; // Posição do sumário "ctph" entre os pedidos, -1 se não for pedido
 
-    char *cpy = malloc(strlen(hashFunctions) + 1);
-    strcpy(cpy, hashFunctions);
+    char *cpy = malloc((hashFunctions != NULL) ? strlen(hashFunctions) + 1 : 1);
+    strcpy(cpy, (hashFunctions != NULL) ? hashFunctions : "");
 
-    char *ptr = strtok(cpy, ",");
+    // Guardar os sumários pedidos, pela ordem indicada (os nomes já foram validados por checkHashFunctions())
+    char *savePtr = NULL;
+    char *ptr = strtok_r(cpy, ",", &savePtr);
     while (ptr != NULL)
     {
-        if (strcmp(ptr, "md5") == 0 || strcmp(ptr, "sha1") == 0 || strcmp(ptr, "sha256") == 0)
+        int algorithm = digestFromName(ptr);
+        if (strcmp(ptr, "ctph") == 0 && ctphColumn == -1)
+            ctphColumn = digestCount;
+        else if (algorithm != -1 && digestCount < DIGEST_COUNT)
+            algorithms[digestCount++] = algorithm;
+
+        ptr = strtok_r(NULL, ",", &savePtr);
+    }
+    free(cpy);
+
+    if (digestCount == 0 && ctphColumn == -1 && hashFunctions != NULL)
+        return -1;
+
+    // O sumário "ctph" é calculado como mais uma análise da mesma leitura
+    PipelineStage stages[FILE_ANALYSIS_MAX_STAGES];
+    memcpy(stages, extraStages, extraCount * sizeof(PipelineStage));
+    size_t stageCount = extraCount;
+    CtphState ctph;
+    if (ctphColumn != -1)
+    {
+        initCtph(&ctph);
+        stages[stageCount].consume = consumeCtph;
+        stages[stageCount++].context = &ctph;
+    }
+
+    // O sumário do conteúdo (SHA-256, usado nos sumários de diretório) é calculado na mesma leitura
+    size_t requestedCount = digestCount;
+    size_t contentIndex = digestCount;
+    for (size_t i = 0; i < requestedCount; i++)
+        if (algorithms[i] == DIGEST_SHA256)
+            contentIndex = i;
+    if (contentDigest != NULL && contentIndex == digestCount)
+        algorithms[digestCount++] = DIGEST_SHA256;
+
+    char hex[DIGEST_MAX_PER_FILE][DIGEST_MAX_HEX_LEN + 1];
+    int ret = -1;
+
+    // Com "--hash-backend=af_alg" tentar primeiro a crypto API do kernel, voltando ao cálculo normal se falhar.
+    // As outras análises precisam dos dados no processo, e aí o ficheiro é lido uma única vez para tudo.
+    // Um erro de leitura só afeta este ficheiro; sem suporte no kernel, afAlgAvailable() deixa de tentar.
+    if (flags->hashBackend == HASH_BACKEND_AF_ALG && afAlgAvailable() && stageCount == 0 && source == NULL)
+        ret = afAlgHashFile(targetLocation, algorithms, digestCount, hex);
+
+    if (ret == -1 && userHashFile(targetLocation, source, algorithms, digestCount, hex, stages, stageCount) == -1)
+    {
+        printf("Hash error!\n");
+        return -1;
+    }
+
+    if (contentDigest != NULL)
+        strcpy(contentDigest, hex[contentIndex]);
+
+    if (requestedCount == 0 && ctphColumn == -1)
+        return 0;
+
+    // Juntar os sumários pela ordem pedida
+    *buffer = malloc(requestedCount * (DIGEST_MAX_HEX_LEN + 1) + CTPH_MAX_RESULT + 1);
+    (*buffer)[0] = '\0';
+    for (size_t i = 0; i <= requestedCount; i++)
+    {
+        if ((long)i == ctphColumn)
         {
-            char *tempBuf = NULL;
-            sprintf(hashCmd, "%s%s", ptr, "sum");
-
-            if (calculateHash(&tempBuf, hashCmd, targetLocation) == -1)
-            {
-                printf("Hash '%s' error!\n", hashCmd);
-                return -1;
-            }
-
-            if (doneFirst == 0)
-            {
-                *buffer = malloc(strlen(tempBuf) + 1);
-                sprintf(*buffer, "%s", tempBuf);
-                doneFirst++;
-            }
-            else
-            {
-                *buffer = realloc(*buffer, strlen(*buffer) + strlen(tempBuf) + 1 + 1);
-                sprintf(*buffer, "%s,%s", *buffer, tempBuf);
-            }
-            free(tempBuf);
+            char result[CTPH_MAX_RESULT];
+            ctphResult(&ctph, result);
+            if (i > 0)
+                strcat(*buffer, ",");
+            strcat(*buffer, result);
         }
-        else
+        if (i < requestedCount)
         {
-            printf("'%s' is not a valid hash function!\n", ptr);
+            if (i > 0 || ctphColumn == 0)
+                strcat(*buffer, ",");
+            strcat(*buffer, hex[i]);
         }
+    }
 
-        ptr = strtok(NULL, ",");
+    return 0;
+}
+
+// Acrescentar o ficheiro ao registo do índice, com os sumários pedidos e o do conteúdo.
+static int addToManifest(char *targetLocation, const struct stat *fileStat, char *fileString, char *hashString, char *contentDigest)
+{
+    ManifestRecord record;
+    record.path = targetLocation;
+    record.fileType = fileString;
+    record.size = fileStat->st_size;
+    record.mode = fileStat->st_mode;
+    record.atime = fileStat->st_atime;
+    record.ctime = fileStat->st_ctime;
+    record.mtime = fileStat->st_mtime;
+    record.digestCount = 0;
+
+    // O algoritmo de cada sumário é identificado pelo seu tamanho
+    char *cpy = malloc((hashString != NULL) ? strlen(hashString) + 1 : 1);
+    strcpy(cpy, (hashString != NULL) ? hashString : "");
+    int hasContentDigest = 0;
+    char *savePtr = NULL;
+    for (char *ptr = strtok_r(cpy, ",", &savePtr); ptr != NULL && record.digestCount < DIGEST_MAX_PER_FILE; ptr = strtok_r(NULL, ",", &savePtr))
+    {
+        int length = parseManifestDigest(ptr, record.digests[record.digestCount]);
+        if (length == -1)
+            continue;
+        record.digestLength[record.digestCount++] = length;
+        if (strcmp(ptr, contentDigest) == 0)
+            hasContentDigest = 1;
+    }
+    free(cpy);
+
+    if (!hasContentDigest && record.digestCount < DIGEST_MAX_PER_FILE)
+    {
+        int length = parseManifestDigest(contentDigest, record.digests[record.digestCount]);
+        if (length != -1)
+            record.digestLength[record.digestCount++] = length;
     }
-    return (doneFirst == 0) ? -1 : 0;
+
+    return appendManifestRecord(&record);
 }
 
-int analyseFile(char *hashFunctions, FILE *outputFile, char *targetLocation)
+/*
+ * Escrever a linha de um ficheiro. Os dados são lidos de source, ou do próprio ficheiro se for NULL; no primeiro
+ * caso (membros de arquivos) o tipo é obtido no fim, a partir do início dos dados guardado durante a leitura.
+ */
+static int analyseContent(Flags *flags, char *hashFunctions, FILE *outputFile, char *targetLocation,
+                          const struct stat *fileStat, PipelineSource *source, char *contentDigest)
 {
     char *fileString = NULL;
     char *statString = NULL;
     char *hashString = NULL;
     char *outputString = NULL;
 
-    if (getFileCmdInfo(&fileString, targetLocation) == -1)
+    // Com "--index" o sumário do conteúdo é sempre calculado, para as consultas por sumário
+    char indexDigest[DIGEST_MAX_HEX_LEN + 1];
+    if (flags->indexPath != NULL && contentDigest == NULL)
+        contentDigest = indexDigest;
+
+    struct timespec start;
+    profileStart(&start);
+    if (source == NULL && getFileCmdInfo(&fileString, targetLocation) == -1)
     {
         printf("Error reading file command output!\n");
         return -1;
     }
+    if (source == NULL)
+        profileEnd(PROFILE_TYPE, &start);
 
-    if (getStatCmdInfo(&statString, targetLocation) == -1)
+    if (formatStatInfo(&statString, fileStat) == -1)
     {
         printf("Error reading stat command output!\n");
+        free(fileString);
         return -1;
     }
 
-    if (hashFunctions != NULL)
+    // Análises feitas na mesma leitura que os sumários
+    PipelineStage stages[FILE_ANALYSIS_MAX_STAGES];
+    size_t stageCount = 0;
+    TypeSample typeSample = {NULL, 0};
+    if (source != NULL)
+    {
+        if ((typeSample.data = malloc(FILE_TYPE_SAMPLE)) == NULL)
+        {
+            free(statString);
+            return -1;
+        }
+        stages[stageCount].consume = consumeTypeSample;
+        stages[stageCount++].context = &typeSample;
+    }
+    ByteStats byteStats;
+    if (flags->entropyAnalysis)
+    {
+        initByteStats(&byteStats);
+        stages[stageCount].consume = consumeByteStats;
+        stages[stageCount++].context = &byteStats;
+    }
+    SignatureScan signatureScan;
+    if (flags->signatures != NULL)
     {
-        if (processHashes(&hashString, hashFunctions, targetLocation) == -1)
+        if (initSignatureScan(&signatureScan, flags->signatures) != 0)
         {
+            free(fileString);
+            free(statString);
+            free(typeSample.data);
+            printf("Error analysing file contents!\n");
+            return -1;
+        }
+        stages[stageCount].consume = consumeSignatureScan;
+        stages[stageCount++].context = &signatureScan;
+    }
+    KnownCheck knownCheck;
+    if (flags->knownFiles != NULL)
+    {
+        initKnownCheck(&knownCheck, flags->knownFiles);
+        stages[stageCount].consume = consumeKnownCheck;
+        stages[stageCount++].context = &knownCheck;
+    }
+
+    if (hashFunctions != NULL || contentDigest != NULL || stageCount > 0)
+    {
+        profileStart(&start);
+        if (processHashes(&hashString, flags, hashFunctions, targetLocation, source, contentDigest, stages, stageCount) == -1)
+        {
+            if (flags->signatures != NULL)
+                freeSignatureScan(&signatureScan);
+            free(fileString);
+            free(statString);
+            free(typeSample.data);
             printf("Error calculing hashes!\n");
             return -1;
         }
+        profileEnd(PROFILE_HASH, &start);
+    }
+
+    if (source != NULL)
+    {
+        profileStart(&start);
+        int ret = getFileCmdInfoFromData(&fileString, typeSample.data, typeSample.length);
+        profileEnd(PROFILE_TYPE, &start);
+        free(typeSample.data);
+        if (ret == -1)
+        {
+            free(statString);
+            free(hashString);
+            if (flags->signatures != NULL)
+                freeSignatureScan(&signatureScan);
+            printf("Error reading file command output!\n");
+            return -1;
+        }
+    }
+
+    // Entropia (bits por byte), proporção de imprimíveis, assinaturas encontradas e ficheiro conhecido no fim da linha
+    char *matches = NULL;
+    if (flags->signatures != NULL)
+    {
+        matches = signatureMatches(&signatureScan);
+        freeSignatureScan(&signatureScan);
+    }
+    char *analysisString = malloc(32 + (matches ? strlen(matches) + 1 : 0) + strlen(",known") + 1);
+    if (analysisString == NULL || (flags->signatures != NULL && matches == NULL))
+    {
+        free(fileString);
+        free(statString);
+        free(hashString);
+        free(matches);
+        free(analysisString);
+        printf("Error analysing file contents!\n");
+        return -1;
+    }
+    analysisString[0] = '\0';
+    if (flags->entropyAnalysis)
+        sprintf(analysisString, ",%.4f,%.4f", byteStatsEntropy(&byteStats), byteStatsPrintableRatio(&byteStats));
+    if (matches != NULL)
+    {
+        strcat(analysisString, ",");
+        strcat(analysisString, matches);
+        free(matches);
+    }
+    int known = 0;
+    if (flags->knownFiles != NULL)
+    {
+        known = knownCheckMatches(&knownCheck);
+        strcat(analysisString, known ? ",known" : ",");
+    }
+
+    // Com "--skip-known" os ficheiros conhecidos não são escritos nem indexados
+    if (known && flags->skipKnown)
+    {
+        free(fileString);
+        free(statString);
+        free(hashString);
+        free(analysisString);
+        return 0;
+    }
 
-        outputString = malloc(strlen(targetLocation) + strlen(fileString) + strlen(statString) + strlen(hashString) + 3 + 1);
-        sprintf(outputString, "%s,%s,%s,%s", targetLocation, fileString, statString, hashString);
+    if (hashString != NULL)
+    {
+        outputString = malloc(strlen(targetLocation) + strlen(fileString) + strlen(statString) + strlen(hashString) + strlen(analysisString) + 3 + 1);
+        sprintf(outputString, "%s,%s,%s,%s%s", targetLocation, fileString, statString, hashString, analysisString);
     }
     else
     {
-        outputString = malloc(strlen(targetLocation) + strlen(fileString) + strlen(statString) + 2 + 1);
-        sprintf(outputString, "%s,%s,%s", targetLocation, fileString, statString);
+        outputString = malloc(strlen(targetLocation) + strlen(fileString) + strlen(statString) + strlen(analysisString) + 2 + 1);
+        sprintf(outputString, "%s,%s,%s%s", targetLocation, fileString, statString, analysisString);
     }
 
+    if (flags->indexPath != NULL && addToManifest(targetLocation, fileStat, fileString, hashString, contentDigest) != 0)
+        printf("Failed to index file '%s'\n", targetLocation);
+
+    profileStart(&start);
     if (outputFile)
     {
         fprintf(outputFile, "%s\n", outputString);
@@ -209,11 +487,89 @@ int analyseFile(char *hashFunctions, FILE *outputFile, char *targetLocation)
     {
         printf("%s\n", outputString);
     }
+    profileEnd(PROFILE_OUTPUT, &start);
 
     free(fileString);
     free(statString);
     free(hashString);
     free(outputString);
+    free(analysisString);
+
+    return 0;
+}
+
+typedef struct
+{
+    Flags *flags;
+    char *hashFunctions;
+    FILE *outputFile;
+    const char *archivePath;
+} ArchiveAnalysis;
+
+// Cada membro é escrito como um ficheiro com o caminho virtual "arquivo!/membro". Um membro com erro não pára o arquivo.
+static int analyseArchiveMember(void *context, const ArchiveMember *member, PipelineSource *source)
+{
+    ArchiveAnalysis *archive = context;
+    char *path = malloc(strlen(archive->archivePath) + strlen(ARCHIVE_MEMBER_SEPARATOR) + strlen(member->name) + 1);
+    if (path == NULL)
+        return -1;
+    sprintf(path, "%s%s%s", archive->archivePath, ARCHIVE_MEMBER_SEPARATOR, member->name);
+
+    if (analyseContent(archive->flags, archive->hashFunctions, archive->outputFile, path, &member->stat, source, NULL) == -1)
+        printf("Failed to analyse archive member '%s'\n", path);
+
+    free(path);
+    return 0;
+}
+
+/*
+ * fileStat são os metadados já obtidos por quem percorre o diretório (seguindo as ligações simbólicas). Com NULL,
+ * para um ficheiro indicado diretamente na linha de comandos, são obtidos aqui.
+ */
+int analyseFile(Flags *flags, char *hashFunctions, FILE *outputFile, char *targetLocation, const struct stat *fileStat,
+                char *contentDigest)
+{
+    struct stat targetStat;
+    if (fileStat == NULL)
+    {
+        struct timespec start;
+        profileStart(&start);
+        if (stat(targetLocation, &targetStat) == -1)
+        {
+            perror("stat() error");
+            printf("Error reading stat command output!\n");
+            return -1;
+        }
+        profileEnd(PROFILE_STAT, &start);
+        fileStat = &targetStat;
+    }
+
+    if (analyseContent(flags, hashFunctions, outputFile, targetLocation, fileStat, NULL, contentDigest) == -1)
+        return -1;
+
+    // Com "--into-archives" os membros de arquivos tar, tar.gz e zip são lidos diretamente do arquivo, sem extrair
+    if (flags->intoArchives && S_ISREG(fileStat->st_mode))
+    {
+        ArchiveAnalysis archive = {flags, hashFunctions, outputFile, targetLocation};
+        if (walkArchive(targetLocation, analyseArchiveMember, &archive) != 0)
+            printf("Failed to read archive '%s'\n", targetLocation);
+    }
 
     return 0;
 }
+
+int summariseFile(Summary *summary, const struct stat *fileStat, char *targetLocation)
+{
+    // No modo resumo só é preciso o tipo, nada é formatado por ficheiro.
+    char *fileString = NULL;
+    if (getFileCmdInfo(&fileString, targetLocation) == -1)
+    {
+        printf("Error reading file command output!\n");
+        return -1;
+    }
+
+    int ret = addToSummary(summary, targetLocation, fileString, fileStat);
+    free(fileString);
+
+    return ret;
+}
@@ -0,0 +1,612 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "filter.h"
+
+// Limite de estados do DFA resultante da união de todos os globs
+#define DFA_MAX_STATES 4096
+
+// Variável de ambiente com o descritor dos DFA compilados pelo processo inicial
+#define FILTER_FD_ENV "FORENSIC_FILTER_FD"
+
+// Elemento de um glob: conjunto de bytes aceites e se se pode repetir ("*")
+typedef struct
+{
+    unsigned char set[32];
+    int star;
+} GlobElem;
+
+typedef struct
+{
+    GlobElem *elems;
+    size_t length;
+} Glob;
+
+struct GlobDFA
+{
+    int (*next)[256]; // Tabela de transições, o estado 0 é o estado morto
+    unsigned char *accepting;
+    size_t stateCount;
+    int shared; // Tabelas no ficheiro partilhado, não são libertadas
+};
+
+// Ficheiro com os DFA do processo inicial, mapeado pelos processos filhos
+static void *sharedTables = NULL;
+static size_t sharedSize = 0;
+
+/*
+ * Leitura dos argumentos
+ */
+
+void initFilter(Filter *filter)
+{
+    memset(filter, 0, sizeof(Filter));
+    filter->minSize = -1;
+    filter->maxSize = -1;
+}
+
+int addFilterGlob(Filter *filter, int exclude, const char *glob)
+{
+    char ***globs = exclude ? &filter->excludeGlobs : &filter->includeGlobs;
+    size_t *count = exclude ? &filter->excludeCount : &filter->includeCount;
+
+    char **tmp = realloc(*globs, (*count + 1) * sizeof(char *));
+    if (tmp == NULL)
+        return -1;
+    *globs = tmp;
+
+    if (((*globs)[*count] = malloc(strlen(glob) + 1)) == NULL)
+        return -1;
+    strcpy((*globs)[*count], glob);
+    (*count)++;
+
+    return 0;
+}
+
+int parseFilterSize(off_t *size, const char *arg)
+{
+    // O strtoull() aceitaria um sinal (e "-1" daria o maior valor possível)
+    if (!isdigit((unsigned char)*arg))
+        return -1;
+
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 10);
+    if (errno == ERANGE)
+        return -1;
+
+    // Sufixos opcionais K, M e G (base 1024)
+    unsigned int shift = 0;
+    switch (*end)
+    {
+    case 'G':
+        shift += 10;
+        // fall through
+    case 'M':
+        shift += 10;
+        // fall through
+    case 'K':
+        shift += 10;
+        end++;
+        break;
+    default:
+        break;
+    }
+
+    if (*end != '\0' || value > (ULLONG_MAX >> shift))
+        return -1;
+    value <<= shift;
+
+    // Tamanhos que não cabem num off_t ficariam negativos, isto é, sem limite
+    if ((off_t)value < 0 || (unsigned long long)(off_t)value != value)
+        return -1;
+
+    *size = (off_t)value;
+    return 0;
+}
+
+int parseFilterDate(time_t *date, const char *arg)
+{
+    // Formatos aceites: AAAA-MM-DD e AAAA-MM-DDTHH:MM:SS (hora local)
+    struct tm ts;
+    memset(&ts, 0, sizeof(ts));
+    int fields = sscanf(arg, "%d-%d-%dT%d:%d:%d", &ts.tm_year, &ts.tm_mon, &ts.tm_mday, &ts.tm_hour, &ts.tm_min, &ts.tm_sec);
+    if (fields != 3 && fields != 6)
+        return -1;
+
+    ts.tm_year -= 1900;
+    ts.tm_mon -= 1;
+    ts.tm_isdst = -1;
+    if ((*date = mktime(&ts)) == -1)
+        return -1;
+
+    return 0;
+}
+
+int parseFilterTypes(unsigned int *types, const char *arg)
+{
+    *types = 0;
+    for (const char *c = arg; *c != '\0'; c++)
+    {
+        if (*c == 'f')
+            *types |= FILTER_TYPE_FILE;
+        else if (*c == 'l')
+            *types |= FILTER_TYPE_LINK;
+        else if (*c != ',')
+            return -1;
+    }
+    return (*types == 0) ? -1 : 0;
+}
+
+/*
+ * Compilação dos globs
+ */
+
+static void setAll(GlobElem *elem, int matchSlash)
+{
+    memset(elem->set, 0xFF, sizeof(elem->set));
+    if (!matchSlash)
+        elem->set['/' / 8] &= ~(1 << ('/' % 8));
+}
+
+static void setByte(GlobElem *elem, unsigned char c)
+{
+    elem->set[c / 8] |= 1 << (c % 8);
+}
+
+static int hasByte(const GlobElem *elem, unsigned char c)
+{
+    return (elem->set[c / 8] >> (c % 8)) & 1;
+}
+
+// Ler uma classe "[...]" a partir de pattern (a apontar para '['). Devolve o número de caracteres lidos, 0 se inválida.
+static size_t parseClass(GlobElem *elem, const char *pattern)
+{
+    size_t i = 1;
+    int negate = 0;
+    if (pattern[i] == '!' || pattern[i] == '^')
+    {
+        negate = 1;
+        i++;
+    }
+
+    size_t first = i;
+    while (pattern[i] != '\0' && (pattern[i] != ']' || i == first))
+    {
+        unsigned char lo = pattern[i];
+        if (pattern[i + 1] == '-' && pattern[i + 2] != ']' && pattern[i + 2] != '\0')
+        {
+            for (unsigned int c = lo; c <= (unsigned char)pattern[i + 2]; c++)
+                setByte(elem, c);
+            i += 3;
+        }
+        else
+        {
+            setByte(elem, lo);
+            i++;
+        }
+    }
+
+    if (pattern[i] != ']')
+        return 0;
+
+    if (negate)
+    {
+        for (size_t b = 0; b < sizeof(elem->set); b++)
+            elem->set[b] = ~elem->set[b];
+        elem->set['/' / 8] &= ~(1 << ('/' % 8));
+    }
+
+    return i + 1;
+}
+
+/*
+ * Converter o glob numa sequência de elementos. O glob é comparado com o caminho completo:
+ * "*" e "?" não passam de um componente para outro, "**" aceita qualquer sequência.
+ * Globs sem '/' aplicam-se ao nome da entrada, ou seja, equivalem a "**" "/" glob.
+ */
+static int parseGlob(Glob *glob, const char *pattern)
+{
+    size_t patternLength = strlen(pattern);
+    glob->elems = calloc(patternLength + 2, sizeof(GlobElem));
+    glob->length = 0;
+    if (glob->elems == NULL)
+        return -1;
+
+    if (strchr(pattern, '/') == NULL)
+    {
+        setAll(&glob->elems[glob->length], 1);
+        glob->elems[glob->length++].star = 1;
+        setByte(&glob->elems[glob->length++], '/');
+    }
+
+    for (size_t i = 0; pattern[i] != '\0';)
+    {
+        GlobElem *elem = &glob->elems[glob->length++];
+        size_t classLength;
+
+        if (pattern[i] == '*')
+        {
+            int doubleStar = (pattern[i + 1] == '*');
+            setAll(elem, doubleStar);
+            elem->star = 1;
+            i += doubleStar ? 2 : 1;
+        }
+        else if (pattern[i] == '?')
+        {
+            setAll(elem, 0);
+            i++;
+        }
+        else if (pattern[i] == '[' && (classLength = parseClass(elem, &pattern[i])) > 0)
+        {
+            i += classLength;
+        }
+        else
+        {
+            if (pattern[i] == '\\' && pattern[i + 1] != '\0')
+                i++;
+            setByte(elem, pattern[i]);
+            i++;
+        }
+    }
+
+    return 0;
+}
+
+typedef struct
+{
+    const Glob *globs;
+    size_t globCount;
+    size_t *offsets; // Índice do primeiro estado do NFA de cada glob
+    size_t words;    // Palavras de 64 bits por conjunto de estados do NFA
+
+    uint64_t *sets; // Conjunto de estados do NFA de cada estado do DFA
+    int *hashTable;
+    size_t hashSize;
+} SubsetBuilder;
+
+#define TEST_BIT(set, i) (((set)[(i) / 64] >> ((i) % 64)) & 1)
+#define SET_BIT(set, i) ((set)[(i) / 64] |= (uint64_t)1 << ((i) % 64))
+
+// Fecho-epsilon: um "*" pode ser saltado. As transições epsilon só avançam, logo basta uma passagem.
+static void closure(const SubsetBuilder *builder, uint64_t *set)
+{
+    for (size_t g = 0; g < builder->globCount; g++)
+        for (size_t k = 0; k < builder->globs[g].length; k++)
+            if (builder->globs[g].elems[k].star && TEST_BIT(set, builder->offsets[g] + k))
+                SET_BIT(set, builder->offsets[g] + k + 1);
+}
+
+static size_t hashSet(const SubsetBuilder *builder, const uint64_t *set)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t w = 0; w < builder->words; w++)
+        hash = (hash ^ set[w]) * 1099511628211ULL;
+    return (size_t)(hash & (builder->hashSize - 1));
+}
+
+// Devolver o estado do DFA correspondente ao conjunto, criando-o se ainda não existir. -1 se exceder o limite.
+static int internState(SubsetBuilder *builder, GlobDFA *dfa, const uint64_t *set)
+{
+    size_t slot = hashSet(builder, set);
+    while (builder->hashTable[slot] != -1)
+    {
+        int state = builder->hashTable[slot];
+        if (memcmp(&builder->sets[state * builder->words], set, builder->words * sizeof(uint64_t)) == 0)
+            return state;
+        slot = (slot + 1) & (builder->hashSize - 1);
+    }
+
+    if (dfa->stateCount == DFA_MAX_STATES)
+        return -1;
+
+    int state = dfa->stateCount++;
+    memcpy(&builder->sets[state * builder->words], set, builder->words * sizeof(uint64_t));
+    builder->hashTable[slot] = state;
+
+    for (size_t g = 0; g < builder->globCount; g++)
+        if (TEST_BIT(set, builder->offsets[g] + builder->globs[g].length))
+            dfa->accepting[state] = 1;
+
+    return state;
+}
+
+// Construção por subconjuntos do DFA que aceita a união de todos os globs.
+static GlobDFA *buildDFA(const Glob *globs, size_t globCount)
+{
+    SubsetBuilder builder;
+    builder.globs = globs;
+    builder.globCount = globCount;
+    builder.offsets = malloc(globCount * sizeof(size_t));
+
+    size_t nfaStates = 0;
+    for (size_t g = 0; g < globCount; g++)
+    {
+        builder.offsets[g] = nfaStates;
+        nfaStates += globs[g].length + 1;
+    }
+    builder.words = (nfaStates + 63) / 64;
+    builder.hashSize = 2 * DFA_MAX_STATES;
+    builder.sets = calloc(DFA_MAX_STATES * builder.words, sizeof(uint64_t));
+    builder.hashTable = malloc(builder.hashSize * sizeof(int));
+
+    GlobDFA *dfa = malloc(sizeof(GlobDFA));
+    uint64_t *set = malloc(builder.words * sizeof(uint64_t));
+    if (dfa != NULL)
+    {
+        dfa->next = malloc(DFA_MAX_STATES * sizeof(*dfa->next));
+        dfa->accepting = calloc(DFA_MAX_STATES, 1);
+        dfa->stateCount = 0;
+        dfa->shared = 0;
+    }
+
+    if (builder.offsets == NULL || builder.sets == NULL || builder.hashTable == NULL || set == NULL ||
+        dfa == NULL || dfa->next == NULL || dfa->accepting == NULL)
+    {
+        printf("Memória insuficiente para compilar os filtros!\n");
+        goto fail;
+    }
+    memset(builder.hashTable, -1, builder.hashSize * sizeof(int));
+
+    // Estado 0: conjunto vazio (morto). Estado 1: estado inicial.
+    memset(set, 0, builder.words * sizeof(uint64_t));
+    internState(&builder, dfa, set);
+    for (size_t g = 0; g < globCount; g++)
+        SET_BIT(set, builder.offsets[g]);
+    closure(&builder, set);
+    internState(&builder, dfa, set);
+
+    for (size_t state = 0; state < dfa->stateCount; state++)
+    {
+        const uint64_t *current = &builder.sets[state * builder.words];
+        for (unsigned int c = 0; c < 256; c++)
+        {
+            memset(set, 0, builder.words * sizeof(uint64_t));
+            for (size_t g = 0; g < globCount; g++)
+                for (size_t k = 0; k < globs[g].length; k++)
+                    if (TEST_BIT(current, builder.offsets[g] + k) && hasByte(&globs[g].elems[k], c))
+                        SET_BIT(set, builder.offsets[g] + k + (globs[g].elems[k].star ? 0 : 1));
+            closure(&builder, set);
+
+            int next = internState(&builder, dfa, set);
+            if (next == -1)
+            {
+                printf("Filtros demasiado complexos (mais de %d estados)!\n", DFA_MAX_STATES);
+                goto fail;
+            }
+            dfa->next[state][c] = next;
+        }
+    }
+
+    // Libertar a parte não usada da tabela de transições
+    int(*next)[256] = realloc(dfa->next, dfa->stateCount * sizeof(*dfa->next));
+    if (next != NULL)
+        dfa->next = next;
+
+    free(set);
+    free(builder.offsets);
+    free(builder.sets);
+    free(builder.hashTable);
+    return dfa;
+
+fail:
+    free(set);
+    free(builder.offsets);
+    free(builder.sets);
+    free(builder.hashTable);
+    if (dfa != NULL)
+    {
+        free(dfa->next);
+        free(dfa->accepting);
+        free(dfa);
+    }
+    return NULL;
+}
+
+static int compileGlobs(GlobDFA **dfa, char **patterns, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    Glob *globs = calloc(count, sizeof(Glob));
+    if (globs == NULL)
+        return -1;
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; i++)
+        ret = parseGlob(&globs[i], patterns[i]);
+
+    if (ret == 0 && (*dfa = buildDFA(globs, count)) == NULL)
+        ret = -1;
+
+    for (size_t i = 0; i < count; i++)
+        free(globs[i].elems);
+    free(globs);
+
+    return ret;
+}
+
+/*
+ * Ficheiro partilhado: número de estados do DFA de inclusão e do de exclusão (0 sem globs), seguidos das tabelas
+ * de transições e depois das marcas de aceitação de cada um.
+ */
+static size_t tablesSize(const uint64_t states[2])
+{
+    return 2 * sizeof(uint64_t) + (states[0] + states[1]) * (sizeof(int[256]) + 1);
+}
+
+// Escrever os DFA num ficheiro já apagado, herdado pelos processos filhos como o estado de "--max-*".
+static void shareFilter(const Filter *filter)
+{
+    const GlobDFA *dfas[2] = {filter->include, filter->exclude};
+    uint64_t states[2] = {dfas[0] ? dfas[0]->stateCount : 0, dfas[1] ? dfas[1]->stateCount : 0};
+
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL)
+        tmp = "/tmp";
+    char path[strlen(tmp) + strlen("/forensic-filter-XXXXXX") + 1];
+    sprintf(path, "%s/forensic-filter-XXXXXX", tmp);
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return; // Os filhos compilam os globs de novo
+    unlink(path);
+
+    FILE *file = fdopen(dup(fd), "w");
+    int ok = file != NULL && fwrite(states, sizeof(states), 1, file) == 1;
+    for (int i = 0; i < 2 && ok; i++)
+        if (states[i] > 0)
+            ok = fwrite(dfas[i]->next, sizeof(int[256]), states[i], file) == states[i];
+    for (int i = 0; i < 2 && ok; i++)
+        if (states[i] > 0)
+            ok = fwrite(dfas[i]->accepting, 1, states[i], file) == states[i];
+    if (file != NULL && fclose(file) != 0)
+        ok = 0;
+
+    if (!ok)
+    {
+        close(fd);
+        return;
+    }
+    char fdString[16];
+    sprintf(fdString, "%d", fd);
+    setenv(FILTER_FD_ENV, fdString, 1);
+}
+
+// Usar os DFA do processo inicial em vez de compilar os mesmos globs em cada processo.
+static int attachFilter(Filter *filter, const char *fdString)
+{
+    int fd = atoi(fdString);
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < 2 * sizeof(uint64_t))
+        return -1;
+    void *base = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    uint64_t states[2];
+    memcpy(states, base, sizeof(states));
+    int expected[2] = {filter->includeCount > 0, filter->excludeCount > 0};
+    if (states[0] > DFA_MAX_STATES || states[1] > DFA_MAX_STATES || (states[0] > 0) != expected[0] ||
+        (states[1] > 0) != expected[1] || tablesSize(states) != (size_t)fileStat.st_size)
+    {
+        munmap(base, fileStat.st_size);
+        return -1;
+    }
+
+    GlobDFA **dfas[2] = {&filter->include, &filter->exclude};
+    unsigned char *next = (unsigned char *)base + sizeof(states);
+    unsigned char *accepting = next + (states[0] + states[1]) * sizeof(int[256]);
+    for (int i = 0; i < 2; i++)
+    {
+        if (states[i] == 0)
+            continue;
+        if ((*dfas[i] = malloc(sizeof(GlobDFA))) == NULL)
+        {
+            free(filter->include);
+            filter->include = NULL;
+            munmap(base, fileStat.st_size);
+            return -1;
+        }
+        (*dfas[i])->next = (int(*)[256])next;
+        (*dfas[i])->accepting = accepting;
+        (*dfas[i])->stateCount = states[i];
+        (*dfas[i])->shared = 1;
+        next += states[i] * sizeof(int[256]);
+        accepting += states[i];
+    }
+
+    sharedTables = base;
+    sharedSize = fileStat.st_size;
+    return 0;
+}
+
+// Os globs são compilados pelo processo inicial; os processos filhos (um por sub-diretório) mapeiam o resultado.
+int compileFilter(Filter *filter)
+{
+    if (filter->includeCount == 0 && filter->excludeCount == 0)
+        return 0;
+
+    char *existing = getenv(FILTER_FD_ENV);
+    if (existing != NULL && attachFilter(filter, existing) == 0)
+        return 0;
+
+    if (compileGlobs(&filter->include, filter->includeGlobs, filter->includeCount) != 0)
+        return -1;
+    if (compileGlobs(&filter->exclude, filter->excludeGlobs, filter->excludeCount) != 0)
+        return -1;
+    if (existing == NULL)
+        shareFilter(filter);
+    return 0;
+}
+
+/*
+ * Avaliação
+ */
+
+static int matchDFA(const GlobDFA *dfa, const char *path)
+{
+    int state = 1;
+    for (const unsigned char *c = (const unsigned char *)path; *c != '\0' && state != 0; c++)
+        state = dfa->next[state][*c];
+    return dfa->accepting[state];
+}
+
+int filterExcludes(const Filter *filter, const char *path)
+{
+    return filter->exclude != NULL && matchDFA(filter->exclude, path);
+}
+
+int filterAccepts(const Filter *filter, const char *path, const struct stat *fileStat, int isLink)
+{
+    if (filter->include != NULL && !matchDFA(filter->include, path))
+        return 0;
+
+    if (filter->minSize >= 0 && fileStat->st_size < filter->minSize)
+        return 0;
+    if (filter->maxSize >= 0 && fileStat->st_size > filter->maxSize)
+        return 0;
+
+    if (filter->newerThan != 0 && fileStat->st_mtime <= filter->newerThan)
+        return 0;
+    if (filter->olderThan != 0 && fileStat->st_mtime >= filter->olderThan)
+        return 0;
+
+    if (filter->types != 0 && !(filter->types & (isLink ? FILTER_TYPE_LINK : FILTER_TYPE_FILE)))
+        return 0;
+
+    return 1;
+}
+
+static void freeDFA(GlobDFA *dfa)
+{
+    if (dfa == NULL)
+        return;
+    if (!dfa->shared)
+    {
+        free(dfa->next);
+        free(dfa->accepting);
+    }
+    free(dfa);
+}
+
+void freeFilter(Filter *filter)
+{
+    for (size_t i = 0; i < filter->includeCount; i++)
+        free(filter->includeGlobs[i]);
+    for (size_t i = 0; i < filter->excludeCount; i++)
+        free(filter->excludeGlobs[i]);
+    free(filter->includeGlobs);
+    free(filter->excludeGlobs);
+    freeDFA(filter->include);
+    freeDFA(filter->exclude);
+    if (sharedTables != NULL)
+        munmap(sharedTables, sharedSize);
+    sharedTables = NULL;
+    initFilter(filter);
+}
\ No newline at end of file
@@ -0,0 +1,399 @@
+#define _GNU_SOURCE // qsort_r
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hashSet.h"
+
+static uint64_t readBE64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; i++)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+// Índice em [0, range) proporcional ao valor, sem divisão
+static uint64_t scaleToRange(uint64_t value, uint64_t range)
+{
+    return ((unsigned __int128)value * range) >> 64;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Os sumários são aleatórios: os primeiros 8 bytes servem de chave ordenada, os 8 seguintes escolhem os bits do filtro.
+static const unsigned char *bloomBlock(const unsigned char *bloom, uint64_t blocks, const unsigned char *digest)
+{
+    return bloom + scaleToRange(readBE64(digest + 8), blocks) * HASHSET_BLOOM_BLOCK;
+}
+
+static unsigned int bloomBit(const unsigned char *digest, size_t probe)
+{
+    uint64_t mixed = readBE64(digest) * 0x9e3779b97f4a7c15ULL;
+    return (mixed >> (9 * probe)) & (HASHSET_BLOOM_BLOCK * 8 - 1);
+}
+
+/*
+ * Construção (forensic-hashset)
+ */
+
+static int compareDigests(const void *a, const void *b, void *length)
+{
+    return memcmp(a, b, *(size_t *)length);
+}
+
+// Primeiro campo da linha (até ',' ou espaço, sem aspas) em hexadecimal. Devolve o tamanho em bytes, ou -1.
+static int parseDigestField(const char *line, unsigned char digest[DIGEST_MAX_HEX_LEN / 2])
+{
+    if (*line == '"')
+        line++;
+
+    size_t length = 0;
+    while (hexValue(line[length]) != -1)
+        length++;
+    char end = line[length];
+    if (end != '\0' && end != '\n' && end != '\r' && end != ',' && end != '"' && end != ' ' && end != '\t')
+        return -1;
+    if (length != 32 && length != 40 && length != 64)
+        return -1;
+
+    for (size_t i = 0; i < length / 2; i++)
+        digest[i] = (hexValue(line[2 * i]) << 4) | hexValue(line[2 * i + 1]);
+    return length / 2;
+}
+
+// O cabeçalho é guardado em little-endian, para o conjunto poder ser lido noutra arquitetura
+static void encodeHeader(HashSetHeader *header)
+{
+    header->version = htole32(header->version);
+    header->digestLength = htole32(header->digestLength);
+    header->digestCount = htole64(header->digestCount);
+    header->bloomOffset = htole64(header->bloomOffset);
+    header->bloomBlocks = htole64(header->bloomBlocks);
+    header->tableOffset = htole64(header->tableOffset);
+}
+
+static void decodeHeader(HashSetHeader *header)
+{
+    header->version = le32toh(header->version);
+    header->digestLength = le32toh(header->digestLength);
+    header->digestCount = le64toh(header->digestCount);
+    header->bloomOffset = le64toh(header->bloomOffset);
+    header->bloomBlocks = le64toh(header->bloomBlocks);
+    header->tableOffset = le64toh(header->tableOffset);
+}
+
+static int writeAll(int fd, const void *data, size_t length)
+{
+    for (const unsigned char *next = data; length > 0;)
+    {
+        ssize_t written = write(fd, next, length);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        next += written;
+        length -= written;
+    }
+    return 0;
+}
+
+/*
+ * Ler um sumário em hexadecimal por linha (primeiro campo, como nas listas NSRL), ordenar, remover
+ * repetidos e escrever o conjunto com o filtro de Bloom já calculado, para ser só mapeado na análise.
+ */
+int buildHashSet(FILE *input, const char *path, size_t *count, size_t *rejected)
+{
+    size_t digestLength = 0, capacity = 0;
+    unsigned char *digests = NULL;
+    *count = 0;
+    *rejected = 0;
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    while (getline(&line, &lineCapacity, input) != -1)
+    {
+        unsigned char digest[DIGEST_MAX_HEX_LEN / 2];
+        int length = parseDigestField(line, digest);
+        if (length == -1 || (digestLength != 0 && (size_t)length != digestLength))
+        {
+            (*rejected)++;
+            continue;
+        }
+        digestLength = length;
+
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 4096;
+            unsigned char *grown = realloc(digests, capacity * digestLength);
+            if (grown == NULL)
+            {
+                free(line);
+                free(digests);
+                return -1;
+            }
+            digests = grown;
+        }
+        memcpy(digests + *count * digestLength, digest, digestLength);
+        (*count)++;
+    }
+    free(line);
+
+    if (*count == 0)
+    {
+        free(digests);
+        errno = EINVAL;
+        return -1;
+    }
+
+    qsort_r(digests, *count, digestLength, compareDigests, &digestLength);
+    size_t unique = 1;
+    for (size_t i = 1; i < *count; i++)
+        if (memcmp(digests + i * digestLength, digests + (unique - 1) * digestLength, digestLength) != 0)
+            memmove(digests + unique++ * digestLength, digests + i * digestLength, digestLength);
+    *count = unique;
+
+    HashSetHeader header;
+    memset(&header, 0, sizeof(HashSetHeader));
+    memcpy(header.magic, HASHSET_MAGIC, sizeof(header.magic));
+    header.version = HASHSET_VERSION;
+    header.digestLength = digestLength;
+    header.digestCount = unique;
+    header.bloomOffset = HASHSET_BLOOM_BLOCK;
+    header.bloomBlocks = (unique * HASHSET_BLOOM_BITS_PER_DIGEST + HASHSET_BLOOM_BLOCK * 8 - 1) / (HASHSET_BLOOM_BLOCK * 8);
+    header.tableOffset = header.bloomOffset + header.bloomBlocks * HASHSET_BLOOM_BLOCK;
+
+    unsigned char *bloom = calloc(header.bloomBlocks, HASHSET_BLOOM_BLOCK);
+    if (bloom == NULL)
+    {
+        free(digests);
+        return -1;
+    }
+    for (size_t i = 0; i < unique; i++)
+    {
+        const unsigned char *digest = digests + i * digestLength;
+        unsigned char *block = (unsigned char *)bloomBlock(bloom, header.bloomBlocks, digest);
+        for (size_t probe = 0; probe < HASHSET_BLOOM_PROBES; probe++)
+        {
+            unsigned int bit = bloomBit(digest, probe);
+            block[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    // Escrever para um ficheiro temporário e substituir o destino só no fim
+    char *tempPath = malloc(strlen(path) + 5);
+    if (tempPath == NULL)
+    {
+        free(bloom);
+        free(digests);
+        return -1;
+    }
+    sprintf(tempPath, "%s.tmp", path);
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    unsigned char padding[HASHSET_BLOOM_BLOCK] = {0};
+    HashSetHeader encoded = header;
+    encodeHeader(&encoded);
+    int ret = (fd == -1 ||
+               writeAll(fd, &encoded, sizeof(HashSetHeader)) != 0 ||
+               writeAll(fd, padding, header.bloomOffset - sizeof(HashSetHeader)) != 0 ||
+               writeAll(fd, bloom, header.bloomBlocks * HASHSET_BLOOM_BLOCK) != 0 ||
+               writeAll(fd, digests, unique * digestLength) != 0)
+                  ? -1
+                  : 0;
+    if (fd != -1 && close(fd) != 0)
+        ret = -1;
+    if (ret == 0 && rename(tempPath, path) != 0)
+        ret = -1;
+    if (ret != 0)
+        unlink(tempPath);
+
+    free(tempPath);
+    free(bloom);
+    free(digests);
+    return ret;
+}
+
+/*
+ * Consulta
+ */
+
+HashSet *openHashSet(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(HashSetHeader))
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *base = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    // Validar o cabeçalho e os limites das tabelas antes de as usar
+    HashSetHeader decoded;
+    memcpy(&decoded, base, sizeof(HashSetHeader));
+    decodeHeader(&decoded);
+    const HashSetHeader *header = &decoded;
+    size_t size = fileStat.st_size;
+    int algorithm = (header->digestLength == 16) ? DIGEST_MD5 : (header->digestLength == 20) ? DIGEST_SHA1
+                                                            : (header->digestLength == 32)   ? DIGEST_SHA256
+                                                                                             : -1;
+    int valid = memcmp(header->magic, HASHSET_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == HASHSET_VERSION && algorithm != -1 &&
+                header->bloomBlocks > 0 &&
+                header->bloomOffset <= size && header->bloomBlocks <= (size - header->bloomOffset) / HASHSET_BLOOM_BLOCK &&
+                header->tableOffset <= size && header->digestCount <= (size - header->tableOffset) / header->digestLength;
+
+    HashSet *set = valid ? malloc(sizeof(HashSet)) : NULL;
+    if (set == NULL)
+    {
+        munmap(base, size);
+        errno = valid ? ENOMEM : EINVAL;
+        return NULL;
+    }
+
+    set->base = base;
+    set->size = size;
+    set->header = decoded;
+    set->bloom = set->base + header->bloomOffset;
+    set->table = set->base + header->tableOffset;
+    set->algorithm = algorithm;
+
+    // O filtro é consultado em todos os ficheiros, a tabela só quando o filtro não exclui o sumário
+    madvise((void *)set->bloom, header->bloomBlocks * HASHSET_BLOOM_BLOCK, MADV_WILLNEED);
+    madvise((void *)set->table, header->digestCount * header->digestLength, MADV_RANDOM);
+
+    return set;
+}
+
+void closeHashSet(HashSet *set)
+{
+    if (set == NULL)
+        return;
+    munmap((void *)set->base, set->size);
+    free(set);
+}
+
+static int compareAt(const HashSet *set, const unsigned char *digest, size_t i)
+{
+    return memcmp(digest, set->table + i * set->header.digestLength, set->header.digestLength);
+}
+
+/*
+ * Um acesso a uma linha de cache do filtro de Bloom exclui quase todos os ficheiros desconhecidos. Os restantes
+ * são procurados na tabela a partir da posição estimada pelos primeiros 8 bytes (os sumários estão uniformemente
+ * distribuídos), alargando a procura exponencialmente: em média só são lidas uma ou duas entradas.
+ */
+int hashSetContains(const HashSet *set, const unsigned char *digest)
+{
+    const HashSetHeader *header = &set->header;
+    if (header->digestCount == 0)
+        return 0;
+
+    const unsigned char *block = bloomBlock(set->bloom, header->bloomBlocks, digest);
+    for (size_t probe = 0; probe < HASHSET_BLOOM_PROBES; probe++)
+    {
+        unsigned int bit = bloomBit(digest, probe);
+        if (!(block[bit / 8] & (1 << (bit % 8))))
+            return 0;
+    }
+
+    size_t position = scaleToRange(readBE64(digest), header->digestCount);
+    int cmp = compareAt(set, digest, position);
+    if (cmp == 0)
+        return 1;
+
+    // Encontrar o intervalo [low, high) que contém o sumário, a partir da posição estimada
+    size_t low, high;
+    if (cmp < 0)
+    {
+        high = position;
+        low = 0;
+        for (size_t step = 1; high > 0; step *= 2)
+        {
+            size_t probe = (high >= step) ? high - step : 0;
+            cmp = compareAt(set, digest, probe);
+            if (cmp == 0)
+                return 1;
+            if (cmp > 0)
+            {
+                low = probe + 1;
+                break;
+            }
+            high = probe;
+        }
+    }
+    else
+    {
+        low = position + 1;
+        high = header->digestCount;
+        for (size_t step = 1; low < header->digestCount; step *= 2)
+        {
+            size_t probe = (low + step - 1 < header->digestCount) ? low + step - 1 : header->digestCount - 1;
+            cmp = compareAt(set, digest, probe);
+            if (cmp == 0)
+                return 1;
+            if (cmp < 0)
+            {
+                high = probe;
+                break;
+            }
+            low = probe + 1;
+        }
+    }
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        cmp = compareAt(set, digest, middle);
+        if (cmp == 0)
+            return 1;
+        if (cmp < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return 0;
+}
+
+void initKnownCheck(KnownCheck *check, const HashSet *set)
+{
+    check->set = set;
+    digestInit(&check->digest, set->algorithm);
+}
+
+void consumeKnownCheck(void *context, const unsigned char *data, size_t length)
+{
+    KnownCheck *check = context;
+    digestUpdate(&check->digest, data, length);
+}
+
+int knownCheckMatches(KnownCheck *check)
+{
+    char hex[DIGEST_MAX_HEX_LEN + 1];
+    unsigned char digest[DIGEST_MAX_HEX_LEN / 2];
+    digestFinalHex(&check->digest, hex);
+    return parseDigestField(hex, digest) == (int)check->set->header.digestLength && hashSetContains(check->set, digest);
+}
\ No newline at end of file
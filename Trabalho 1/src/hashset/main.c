@@ -0,0 +1,43 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "hashSet.h"
+
+/*
+    forensic-hashset conjunto.hs lista.txt
+    forensic-hashset conjunto.hs < lista.txt
+
+    Constrói o conjunto de ficheiros conhecidos usado por "forensic --known". A lista tem um sumário
+    (md5, sha1 ou sha256 em hexadecimal, todos do mesmo tipo) no primeiro campo de cada linha, como nas
+    listas NSRL; as linhas que não o tenham são ignoradas.
+*/
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        printf("Uso: %s conjunto [lista]\n", argv[0]);
+        return -1;
+    }
+
+    FILE *input = (argc == 3) ? fopen(argv[2], "r") : stdin;
+    if (input == NULL)
+    {
+        printf("Não foi possível abrir a lista '%s': %s\n", argv[2], strerror(errno));
+        return -1;
+    }
+
+    size_t count, rejected;
+    int ret = buildHashSet(input, argv[1], &count, &rejected);
+    if (input != stdin)
+        fclose(input);
+
+    if (ret != 0)
+    {
+        printf("Não foi possível escrever o conjunto '%s': %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+
+    printf("%zu sumários, %zu linhas ignoradas\n", count, rejected);
+    return 0;
+}
\ No newline at end of file
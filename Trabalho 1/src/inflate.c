@@ -0,0 +1,423 @@
+#include <string.h>
+#include "inflate.h"
+
+// Símbolos de comprimento 257..285: base e bits extra
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+// Símbolos de distância 0..29: base e bits extra
+static const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                           193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                           6145, 8193, 12289, 16385, 24577};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                           6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Ordem dos comprimentos do código dos comprimentos nos blocos dinâmicos
+static const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+void initInflater(Inflater *inflater, ssize_t (*read)(void *context, unsigned char *buffer, size_t size), void *context)
+{
+    inflater->read = read;
+    inflater->context = context;
+    inflater->inputPos = 0;
+    inflater->inputLength = 0;
+    inflater->inputEnded = 0;
+    inflater->bitBuffer = 0;
+    inflater->bitCount = 0;
+    inflater->padBits = 0;
+    restartInflater(inflater);
+}
+
+// Começar um novo stream deflate a seguir ao anterior (membros seguintes de um gzip), mantendo o input já lido.
+void restartInflater(Inflater *inflater)
+{
+    inflater->total = 0;
+    inflater->inBlock = 0;
+    inflater->finalBlock = 0;
+    inflater->finished = 0;
+    inflater->storedRemaining = 0;
+    inflater->copyLength = 0;
+    inflater->copyDistance = 0;
+}
+
+/*
+ * Bits
+ */
+
+// Encher o buffer de bits até ter pelo menos 57 bits. Depois do fim do input são acrescentados zeros,
+// contados em padBits para detetar streams truncados.
+static void refill(Inflater *inflater)
+{
+    while (inflater->bitCount <= 56)
+    {
+        if (inflater->inputPos == inflater->inputLength && !inflater->inputEnded)
+        {
+            ssize_t readBytes = inflater->read(inflater->context, inflater->input, INFLATE_INPUT_SIZE);
+            inflater->inputPos = 0;
+            inflater->inputLength = (readBytes > 0) ? (size_t)readBytes : 0;
+            inflater->inputEnded = (readBytes <= 0);
+        }
+
+        uint64_t byte = 0;
+        if (inflater->inputPos < inflater->inputLength)
+            byte = inflater->input[inflater->inputPos++];
+        else
+            inflater->padBits += 8;
+        inflater->bitBuffer |= byte << inflater->bitCount;
+        inflater->bitCount += 8;
+    }
+}
+
+static int consumeBits(Inflater *inflater, unsigned int count)
+{
+    inflater->bitBuffer >>= count;
+    inflater->bitCount -= count;
+    return (inflater->bitCount < inflater->padBits) ? -1 : 0;
+}
+
+// Ler count (até 32) bits. Devolve -1 se o input acabou.
+static long getBits(Inflater *inflater, unsigned int count)
+{
+    if (count == 0)
+        return 0;
+    if (inflater->bitCount < count)
+        refill(inflater);
+    long value = inflater->bitBuffer & ((1ULL << count) - 1);
+    return (consumeBits(inflater, count) == 0) ? value : -1;
+}
+
+/*
+ * Códigos de Huffman
+ */
+
+static unsigned int reverseBits(unsigned int code, unsigned int length)
+{
+    unsigned int reversed = 0;
+    for (unsigned int i = 0; i < length; i++)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    return reversed;
+}
+
+// Construir a tabela a partir dos comprimentos dos códigos. Devolve -1 se o código tiver códigos a mais.
+static int buildHuffman(InflateHuffman *huffman, const uint8_t *lengths, size_t count)
+{
+    memset(huffman->count, 0, sizeof(huffman->count));
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    for (size_t i = 0; i < count; i++)
+        huffman->count[lengths[i]]++;
+    huffman->count[0] = 0;
+
+    int left = 1;
+    for (int length = 1; length < 16; length++)
+    {
+        left = (left << 1) - huffman->count[length];
+        if (left < 0)
+            return -1;
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int length = 1; length < 15; length++)
+        offsets[length + 1] = offsets[length] + huffman->count[length];
+
+    // Códigos canónicos: os símbolos ordenados por comprimento e depois por valor
+    unsigned int next[16];
+    unsigned int code = 0;
+    for (int length = 1; length < 16; length++)
+    {
+        code = (code + (length > 1 ? huffman->count[length - 1] : 0)) << 1;
+        next[length] = code;
+    }
+    for (size_t symbol = 0; symbol < count; symbol++)
+    {
+        unsigned int length = lengths[symbol];
+        if (length == 0)
+            continue;
+        huffman->symbol[offsets[length]++] = symbol;
+
+        unsigned int symbolCode = next[length]++;
+        if (length <= INFLATE_FAST_BITS)
+        {
+            // Os bits são lidos do menos significativo, por isso o código fica invertido na tabela
+            unsigned int reversed = reverseBits(symbolCode, length);
+            for (unsigned int fill = reversed; fill < (1u << INFLATE_FAST_BITS); fill += 1u << length)
+                huffman->fast[fill] = (symbol << 4) | length;
+        }
+    }
+    return 0;
+}
+
+static int decodeSymbol(Inflater *inflater, const InflateHuffman *huffman)
+{
+    if (inflater->bitCount < 15)
+        refill(inflater);
+
+    uint16_t entry = huffman->fast[inflater->bitBuffer & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (entry != 0)
+        return (consumeBits(inflater, entry & 15) == 0) ? entry >> 4 : -1;
+
+    // Códigos mais longos: percorrer os comprimentos bit a bit
+    int code = 0, first = 0, index = 0;
+    for (unsigned int length = 1; length < 16; length++)
+    {
+        code |= (inflater->bitBuffer >> (length - 1)) & 1;
+        int count = huffman->count[length];
+        if (code - first < count)
+            return (consumeBits(inflater, length) == 0) ? huffman->symbol[index + code - first] : -1;
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void buildFixedTables(Inflater *inflater)
+{
+    uint8_t lengths[288];
+    for (int i = 0; i < 288; i++)
+        lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    buildHuffman(&inflater->literals, lengths, 288);
+    for (int i = 0; i < 30; i++)
+        lengths[i] = 5;
+    buildHuffman(&inflater->distances, lengths, 30);
+}
+
+static int readDynamicTables(Inflater *inflater)
+{
+    long literalCount = getBits(inflater, 5);
+    long distanceCount = getBits(inflater, 5);
+    long codeLengthCount = getBits(inflater, 4);
+    if (literalCount < 0 || distanceCount < 0 || codeLengthCount < 0)
+        return -1;
+    literalCount += 257;
+    distanceCount += 1;
+    codeLengthCount += 4;
+    if (literalCount > 286 || distanceCount > 30)
+        return -1;
+
+    uint8_t lengths[286 + 30];
+    memset(lengths, 0, 19);
+    for (long i = 0; i < codeLengthCount; i++)
+    {
+        long length = getBits(inflater, 3);
+        if (length < 0)
+            return -1;
+        lengths[CODE_LENGTH_ORDER[i]] = length;
+    }
+    InflateHuffman codeLengths;
+    if (buildHuffman(&codeLengths, lengths, 19) != 0)
+        return -1;
+
+    // Comprimentos dos dois códigos, com repetições (16: anterior, 17 e 18: zeros)
+    long total = literalCount + distanceCount;
+    for (long i = 0; i < total;)
+    {
+        int symbol = decodeSymbol(inflater, &codeLengths);
+        if (symbol < 0)
+            return -1;
+        if (symbol < 16)
+        {
+            lengths[i++] = symbol;
+            continue;
+        }
+
+        long repeat;
+        uint8_t value = 0;
+        if (symbol == 16)
+        {
+            if (i == 0)
+                return -1;
+            value = lengths[i - 1];
+            repeat = getBits(inflater, 2) + 3;
+        }
+        else if (symbol == 17)
+            repeat = getBits(inflater, 3) + 3;
+        else
+            repeat = getBits(inflater, 7) + 11;
+        if (repeat < 3 || i + repeat > total)
+            return -1;
+        while (repeat-- > 0)
+            lengths[i++] = value;
+    }
+
+    if (lengths[256] == 0)
+        return -1;
+    if (buildHuffman(&inflater->literals, lengths, literalCount) != 0 ||
+        buildHuffman(&inflater->distances, lengths + literalCount, distanceCount) != 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * Bytes alinhados (blocos guardados e o que vem depois do stream)
+ */
+
+// Ler size bytes a partir do próximo byte inteiro, primeiro os que estão no buffer de bits. Devolve os bytes lidos.
+ssize_t inflateTakeBytes(Inflater *inflater, unsigned char *buffer, size_t size)
+{
+    consumeBits(inflater, inflater->bitCount % 8);
+
+    size_t taken = 0;
+    while (taken < size && inflater->bitCount >= 8 && inflater->bitCount > inflater->padBits)
+    {
+        buffer[taken++] = inflater->bitBuffer & 0xff;
+        consumeBits(inflater, 8);
+    }
+    if (inflater->bitCount == inflater->padBits)
+    {
+        inflater->bitBuffer = 0;
+        inflater->bitCount = 0;
+        inflater->padBits = 0;
+    }
+
+    while (taken < size && inflater->bitCount == 0)
+    {
+        if (inflater->inputPos == inflater->inputLength)
+        {
+            if (inflater->inputEnded)
+                break;
+            ssize_t readBytes = inflater->read(inflater->context, inflater->input, INFLATE_INPUT_SIZE);
+            inflater->inputPos = 0;
+            inflater->inputLength = (readBytes > 0) ? (size_t)readBytes : 0;
+            inflater->inputEnded = (readBytes <= 0);
+            continue;
+        }
+        size_t available = inflater->inputLength - inflater->inputPos;
+        size_t chunk = (size - taken < available) ? size - taken : available;
+        memcpy(buffer + taken, inflater->input + inflater->inputPos, chunk);
+        inflater->inputPos += chunk;
+        taken += chunk;
+    }
+    return taken;
+}
+
+/*
+ * Descompressão
+ */
+
+static void emit(Inflater *inflater, unsigned char *buffer, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        inflater->window[(inflater->total + i) % INFLATE_WINDOW_SIZE] = buffer[i];
+    inflater->total += length;
+}
+
+static int startBlock(Inflater *inflater)
+{
+    long header = getBits(inflater, 3);
+    if (header < 0)
+        return -1;
+    inflater->finalBlock = header & 1;
+
+    switch (header >> 1)
+    {
+    case 0:
+    {
+        unsigned char lengths[4];
+        if (inflateTakeBytes(inflater, lengths, 4) != 4)
+            return -1;
+        unsigned int length = lengths[0] | (lengths[1] << 8);
+        unsigned int complement = lengths[2] | (lengths[3] << 8);
+        if (length != (~complement & 0xffff))
+            return -1;
+        inflater->storedRemaining = length;
+        return 0;
+    }
+    case 1:
+        buildFixedTables(inflater);
+        inflater->inBlock = 1;
+        return 0;
+    case 2:
+        if (readDynamicTables(inflater) != 0)
+            return -1;
+        inflater->inBlock = 1;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Descomprimir até size bytes. Devolve os bytes produzidos, 0 no fim do stream ou -1 se os dados forem
+ * inválidos ou estiverem truncados.
+ */
+ssize_t inflateRead(Inflater *inflater, unsigned char *buffer, size_t size)
+{
+    size_t produced = 0;
+    while (produced < size)
+    {
+        // Resto de uma cópia da janela
+        if (inflater->copyLength > 0)
+        {
+            size_t count = (inflater->copyLength < size - produced) ? inflater->copyLength : size - produced;
+            for (size_t i = 0; i < count; i++)
+            {
+                unsigned char byte = inflater->window[(inflater->total - inflater->copyDistance) % INFLATE_WINDOW_SIZE];
+                inflater->window[inflater->total++ % INFLATE_WINDOW_SIZE] = byte;
+                buffer[produced++] = byte;
+            }
+            inflater->copyLength -= count;
+            continue;
+        }
+
+        // Bloco guardado sem compressão
+        if (inflater->storedRemaining > 0)
+        {
+            size_t count = (inflater->storedRemaining < size - produced) ? inflater->storedRemaining : size - produced;
+            ssize_t taken = inflateTakeBytes(inflater, buffer + produced, count);
+            if (taken <= 0)
+                return -1;
+            emit(inflater, buffer + produced, taken);
+            produced += taken;
+            inflater->storedRemaining -= taken;
+            continue;
+        }
+
+        if (!inflater->inBlock)
+        {
+            if (inflater->finalBlock || inflater->finished)
+            {
+                inflater->finished = 1;
+                break;
+            }
+            if (startBlock(inflater) != 0)
+                return -1;
+            continue;
+        }
+
+        int symbol = decodeSymbol(inflater, &inflater->literals);
+        if (symbol < 0)
+            return -1;
+        if (symbol < 256)
+        {
+            inflater->window[inflater->total++ % INFLATE_WINDOW_SIZE] = symbol;
+            buffer[produced++] = symbol;
+            continue;
+        }
+        if (symbol == 256)
+        {
+            inflater->inBlock = 0;
+            continue;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29)
+            return -1;
+        long length = getBits(inflater, LENGTH_EXTRA[symbol]);
+        int distanceSymbol = decodeSymbol(inflater, &inflater->distances);
+        if (length < 0 || distanceSymbol < 0 || distanceSymbol >= 30)
+            return -1;
+        long distance = getBits(inflater, DISTANCE_EXTRA[distanceSymbol]);
+        if (distance < 0)
+            return -1;
+        distance += DISTANCE_BASE[distanceSymbol];
+        if ((uint64_t)distance > inflater->total)
+            return -1;
+
+        inflater->copyLength = length + LENGTH_BASE[symbol];
+        inflater->copyDistance = distance;
+    }
+    return produced;
+}
\ No newline at end of file
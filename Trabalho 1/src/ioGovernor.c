@@ -0,0 +1,128 @@
+#include <sys/resource.h>
+#include "ioGovernor.h"
+
+// Duração mínima e ficheiros mínimos de um intervalo de medição
+#define IO_GOVERNOR_INTERVAL 0.1
+#define IO_GOVERNOR_INTERVAL_FILES 8
+
+// Custo fixo de cada ficheiro (abrir, comando "file", ...), em bytes equivalentes
+#define IO_GOVERNOR_FILE_COST (64 << 10)
+
+// Latência por byte, em relação à menor observada, a partir da qual o armazenamento é considerado saturado
+#define IO_GOVERNOR_CONGESTION 2.0
+
+// Descritores reservados para o resto do processo quando o limite vem do RLIMIT_NOFILE
+#define IO_GOVERNOR_RESERVED_FDS 16
+
+static double secondsSince(const struct timespec *start, const struct timespec *now)
+{
+    return (now->tv_sec - start->tv_sec) + (now->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void initIoGovernor(IoGovernor *governor, unsigned int minLimit, unsigned int maxLimit, unsigned int maxOpenFiles, size_t memoryCap)
+{
+    pthread_mutex_init(&governor->lock, NULL);
+    pthread_cond_init(&governor->released, NULL);
+
+    // Sem limite indicado, usar o do processo
+    if (maxOpenFiles == 0)
+    {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > IO_GOVERNOR_RESERVED_FDS)
+            maxOpenFiles = limit.rlim_cur - IO_GOVERNOR_RESERVED_FDS;
+        else
+            maxOpenFiles = 1024;
+    }
+    governor->fileCap = maxOpenFiles / IO_GOVERNOR_FDS_PER_FILE;
+    if (governor->fileCap == 0)
+        governor->fileCap = 1;
+
+    governor->maxLimit = (maxLimit < governor->fileCap) ? maxLimit : governor->fileCap;
+    governor->minLimit = (minLimit < governor->maxLimit) ? minLimit : governor->maxLimit;
+    if (governor->minLimit == 0)
+        governor->minLimit = 1;
+    governor->limit = governor->minLimit;
+    governor->slowStart = 1;
+
+    governor->inFlight = 0;
+    governor->memoryCap = memoryCap;
+    governor->memoryInUse = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &governor->intervalStart);
+    governor->intervalBytes = 0;
+    governor->intervalFiles = 0;
+    governor->intervalLatency = 0;
+    governor->lastThroughput = 0;
+    governor->baseCost = 0;
+}
+
+// Esperar até haver lugar para mais um ficheiro. Um ficheiro sozinho é sempre aceite, mesmo acima do limite de memória.
+void acquireIoSlot(IoGovernor *governor, size_t memory)
+{
+    pthread_mutex_lock(&governor->lock);
+    while (governor->inFlight > 0 &&
+           (governor->inFlight >= governor->limit || governor->memoryInUse + memory > governor->memoryCap))
+        pthread_cond_wait(&governor->released, &governor->lock);
+    governor->inFlight++;
+    governor->memoryInUse += memory;
+    pthread_mutex_unlock(&governor->lock);
+}
+
+// Fim de um intervalo: subir o limite enquanto a latência por byte não cresce, descer para metade quando cresce.
+static void adjustLimit(IoGovernor *governor, double elapsed)
+{
+    double work = governor->intervalBytes + (double)governor->intervalFiles * IO_GOVERNOR_FILE_COST;
+    double throughput = work / elapsed;
+    double cost = governor->intervalLatency / work;
+
+    // A referência envelhece devagar, para acompanhar mudanças do armazenamento (cache, outros processos)
+    if (governor->baseCost == 0 || cost < governor->baseCost)
+        governor->baseCost = cost;
+    else
+        governor->baseCost *= 1.02;
+
+    int congested = cost > IO_GOVERNOR_CONGESTION * governor->baseCost && throughput < governor->lastThroughput * 1.05;
+    if (congested)
+    {
+        governor->limit = (governor->limit / 2 > governor->minLimit) ? governor->limit / 2 : governor->minLimit;
+        governor->slowStart = 0;
+    }
+    else if (governor->limit < governor->maxLimit)
+    {
+        unsigned int next = governor->slowStart ? governor->limit * 2 : governor->limit + 1;
+        governor->limit = (next < governor->maxLimit) ? next : governor->maxLimit;
+    }
+
+    governor->lastThroughput = throughput;
+}
+
+void releaseIoSlot(IoGovernor *governor, size_t memory, uint64_t bytes, double latency)
+{
+    pthread_mutex_lock(&governor->lock);
+    governor->inFlight--;
+    governor->memoryInUse -= memory;
+    governor->intervalBytes += bytes;
+    governor->intervalFiles++;
+    governor->intervalLatency += latency;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = secondsSince(&governor->intervalStart, &now);
+    if (elapsed >= IO_GOVERNOR_INTERVAL && governor->intervalFiles >= IO_GOVERNOR_INTERVAL_FILES)
+    {
+        adjustLimit(governor, elapsed);
+        governor->intervalStart = now;
+        governor->intervalBytes = 0;
+        governor->intervalFiles = 0;
+        governor->intervalLatency = 0;
+    }
+
+    pthread_cond_broadcast(&governor->released);
+    pthread_mutex_unlock(&governor->lock);
+}
+
+void destroyIoGovernor(IoGovernor *governor)
+{
+    pthread_mutex_destroy(&governor->lock);
+    pthread_cond_destroy(&governor->released);
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+/*
+ * Compressão LZ77 por blocos, no formato das sequências do LZ4: cada sequência tem um byte de controlo
+ * (tamanho dos literais nos 4 bits altos, tamanho da cópia - 4 nos baixos, 15 = continua em bytes extra),
+ * os literais, a distância da cópia (2 bytes) e os bytes extra do tamanho da cópia. A última sequência
+ * só tem literais. Cada bloco é independente, para poder ser descomprimido sozinho.
+ */
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static size_t hash4(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char *putLength(unsigned char *op, size_t length)
+{
+    for (length -= 15; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = length;
+    return op;
+}
+
+static unsigned char *putSequence(unsigned char *op, const unsigned char *literals, size_t literalLength)
+{
+    unsigned char *token = op++;
+    *token = ((literalLength >= 15) ? 15 : literalLength) << 4;
+    if (literalLength >= 15)
+        op = putLength(op, literalLength);
+    memcpy(op, literals, literalLength);
+    return op + literalLength;
+}
+
+// Devolve o tamanho comprimido, ou 0 se o destino tiver menos de LZ_COMPRESS_BOUND(srcLength) bytes.
+size_t lzCompress(const unsigned char *src, size_t srcLength, unsigned char *dst, size_t dstCapacity)
+{
+    if (dstCapacity < LZ_COMPRESS_BOUND(srcLength))
+        return 0;
+
+    // Última posição vista de cada sequência de 4 bytes
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    const unsigned char *ip = src, *anchor = src, *end = src + srcLength;
+    unsigned char *op = dst;
+
+    while (srcLength >= LZ_MIN_MATCH && ip <= end - LZ_MIN_MATCH)
+    {
+        uint32_t sequence = read32(ip);
+        size_t slot = hash4(sequence);
+        const unsigned char *ref = src + table[slot];
+        table[slot] = ip - src;
+
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(ref) != sequence)
+        {
+            // Em dados que não comprimem, avançar cada vez mais depressa
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+
+        const unsigned char *matchEnd = ip + LZ_MIN_MATCH;
+        for (const unsigned char *rp = ref + LZ_MIN_MATCH; matchEnd < end && *matchEnd == *rp; rp++)
+            matchEnd++;
+
+        unsigned char *token = op;
+        op = putSequence(op, anchor, ip - anchor);
+        size_t offset = ip - ref;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+
+        size_t matchLength = (matchEnd - ip) - LZ_MIN_MATCH;
+        *token |= (matchLength >= 15) ? 15 : matchLength;
+        if (matchLength >= 15)
+            op = putLength(op, matchLength);
+
+        ip = anchor = matchEnd;
+    }
+
+    op = putSequence(op, anchor, end - anchor);
+    return op - dst;
+}
+
+static int readLength(const unsigned char **ip, const unsigned char *ipEnd, size_t *length)
+{
+    unsigned char byte;
+    do
+    {
+        if (*ip >= ipEnd)
+            return -1;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+// Devolve o tamanho descomprimido, ou -1 se os dados forem inválidos ou não couberem no destino.
+long lzDecompress(const unsigned char *src, size_t srcLength, unsigned char *dst, size_t dstCapacity)
+{
+    const unsigned char *ip = src, *ipEnd = src + srcLength;
+    unsigned char *op = dst, *opEnd = dst + dstCapacity;
+
+    while (ip < ipEnd)
+    {
+        unsigned char token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && readLength(&ip, ipEnd, &literalLength) != 0)
+            return -1;
+        if (literalLength > (size_t)(ipEnd - ip) || literalLength > (size_t)(opEnd - op))
+            return -1;
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // Última sequência: só literais
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return -1;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && readLength(&ip, ipEnd, &matchLength) != 0)
+            return -1;
+        matchLength += LZ_MIN_MATCH;
+        if (matchLength > (size_t)(opEnd - op))
+            return -1;
+
+        // A cópia pode sobrepor-se ao que está a ser escrito (repetições curtas)
+        const unsigned char *ref = op - offset;
+        if (offset >= matchLength)
+            memcpy(op, ref, matchLength);
+        else
+            for (size_t i = 0; i < matchLength; i++)
+                op[i] = ref[i];
+        op += matchLength;
+    }
+
+    return op - dst;
+}
\ No newline at end of file
@@ -2,24 +2,97 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h> //getcwd
+#include <sys/stat.h>
 #include "argvParse.h"
 #include "fileAnalysis.h"
+#include "ioGovernor.h"
 #include "dirAnalysis.h"
 #include "flags.h"
+#include "cmdHelper.h"
+#include "compressedOutput.h"
+#include "digest.h"
+#include "manifest.h"
+#include "profile.h"
+#include "shards.h"
+#include "similar.h"
+#include "summary.h"
+#include "throttle.h"
+#include "timeline.h"
+#include "verify.h"
 
 /*
     forensic hello.txt
     forensic -h md5,sha1,sha256 hello.txt
     forensic -r 'folder'
     forensic -h md5 -o output.txt -v hello.txt
+    forensic -r --shards 8 /mnt/a /mnt/b /mnt/c
 
-    -h [md5, sha1, sha256]  - adicionar sumario criptografico ao output
+    -h [md5, sha1, sha256, ctph] - adicionar sumario criptografico ao output ("ctph": sumário por partes, como o
+                              ssdeep, para encontrar ficheiros semelhantes)
     -r                      - analisar conteudo do diretorio e subdiretorios
     -o [path/filename]      - gravar para ficheiro o output em vez de stdout
     -v                      - gravar para ficheiro os dados de execução
+    -z                      - com -o, comprimir o output em blocos independentes (ler com forensic-unpack)
+    -e                      - adicionar a entropia (bits por byte) e a proporção de bytes imprimíveis,
+                              calculadas na mesma leitura que os sumários
+    -j [n]                  - analisar os ficheiros de cada diretório em até n threads (com --unordered, dos maiores
+                              para os menores);
+                              o número de ficheiros lidos ao mesmo tempo adapta-se ao débito e à latência medidos
+    --unordered             - com -j ou --shards, escrever o output de cada ficheiro assim que termina, pela ordem
+                              em que terminam; por omissão o output é o mesmo da análise sem -j
+    --min-jobs [n]          - mínimo de ficheiros lidos ao mesmo tempo com -j (1 por omissão): a concorrência
+                              adapta-se entre este valor e o n de -j, e nunca desce abaixo dele ao recuar depois
+                              de uma subida da latência; igual ao n de -j para fixar a concorrência
+    --max-open-files [n]    - descritores para os ficheiros em análise com -j (por omissão, o RLIMIT_NOFILE)
+    --max-buffer-mem [n[K|M|G]] - memória dos buffers de leitura dos ficheiros em análise com -j (256M por omissão)
+    --max-read-rate [n[K|M|G]] - limite de bytes lidos por segundo, partilhado por todos os processos e threads
+    --max-iops [n]          - limite de leituras por segundo, partilhado por todos os processos e threads
+    --max-cpu [p]           - cada thread de sumários usa no máximo p% de um core (1 a 100)
+                              Os três limites podem ser ajustados durante a análise com sinais ao processo
+                              inicial: SIGRTMIN para metade, SIGRTMIN+1 para o dobro (kill -RTMIN pid)
+    --shards [n]            - analisar os alvos (um ou mais) em n processos de análise, ligados ao processo inicial
+                              por socketpairs; o output é ordenado pelos alvos e, em cada diretório, pelo nome dos
+                              ficheiros e depois dos sub-diretórios, igual para qualquer n. Se um processo terminar
+                              a meio, apenas os ficheiros que estava a analisar são repetidos
+    --order [inode, extent] - processar as entradas de cada diretório pela ordem física no disco
+    --include/--exclude [glob]  - analisar apenas / ignorar (com toda a sub-árvore) entradas cujo nome
+                                  (ou caminho, se o glob tiver '/') corresponda ao glob; "**" atravessa '/'
+    --min-size/--max-size [n[K|M|G]] - limites do tamanho dos ficheiros analisados
+    --newer/--older [AAAA-MM-DD[THH:MM:SS]] - limites da data de modificação
+    --type [f,l]            - analisar apenas ficheiros regulares (f) e/ou ligações simbólicas (l)
+    --summary               - em vez de uma linha por ficheiro, escrever apenas totais por tipo, diretório de topo
+                              e extensão, os maiores ficheiros e o histograma de idades
+    --timeline              - em vez de uma linha por ficheiro, escrever os eventos de modificação, acesso e
+                              alteração (m, a, c) ordenados por data: "data,mac,tamanho,ficheiro"
+    --top [n]               - número de maiores ficheiros no resumo (10 por omissão)
+    --hash-backend=[user, af_alg] - calcular os sumários no processo (por omissão) ou na crypto API do kernel
+    --merkle                - com -r, escrever também uma linha "diretório,directory,sha256" por diretório, com
+                              um sumário Merkle dos filhos (nome, tipo e SHA-256), calculado de baixo para cima
+    --signatures [path/filename] - procurar no conteúdo as assinaturas do ficheiro (uma por linha, "id texto"
+                              ou "id hex:4d5a90") e adicionar os ids das encontradas, separados por ';'
+    --index [path/filename] - escrever também um índice ordenado por caminho e por sumário (SHA-256 e os
+                              pedidos com -h), para consultas com forensic-query
+    --known [path/filename] - marcar (coluna "known") os ficheiros cujo sumário está no conjunto de
+                              forensic-hashset (ficheiros conhecidos, p. ex. NSRL)
+    --skip-known            - com --known, omitir os ficheiros conhecidos do output e do índice
+    --into-archives         - analisar também os ficheiros dentro de arquivos tar, tar.gz e zip (guardados ou com
+                              deflate), lidos diretamente do arquivo sem extrair: uma linha "arquivo!/membro" por
+                              ficheiro, com o tipo, o tamanho, as permissões e a data guardados no arquivo
+    --similar [path/filename] - em vez de analisar, comparar os sumários "ctph" do output indicado como alvo com os
+                              do output de referência: uma linha "referência,ficheiro,pontuação" (1 a 100) por par
+                              semelhante
+    --min-score [n]         - pontuação mínima dos pares de --similar (1 por omissão)
+    --profile [path/filename] - medir a duração de cada readdir, stat, deteção do tipo, leitura do conteúdo (sumários
+                              e restantes análises) e escrita do output, em histogramas por thread juntados no fim
+                              de todos os processos; escrever em JSON, por etapa, o número de medições, o tempo
+                              total, a média, p50, p99 e o máximo
+    --verify [path/filename] - em vez de analisar, verificar o alvo contra um índice de "--index": uma linha
+                              "estado,ficheiro[,motivo]" por ficheiro (verified, modified, missing, extra),
+                              com o SHA-256 recalculado só onde o tamanho e a data coincidem; com -j n threads
+                              (por omissão, uma por core)
 
     Output:
-        file_name,file_type,file_size,file_access,file_created_date,file_modification_date,md5,sha1,sha256
+        file_name,file_type,file_size,file_access,file_created_date,file_modification_date,md5,sha1,sha256,entropy,printable_ratio,signatures,known
 
     Lidar com ^c - SIGINT
     Se flag -o for ativada, usar SIGUSR1/SIGUSR2 para imprimir info de dir/file à medida que são encontrados.
@@ -44,57 +117,236 @@
 
 */
 
+// Analisar um dos alvos da linha de comandos.
+static int analyseTarget(char *childArgv[], int childArgc, Flags *flags, Summary *summary, char *hashFunctions, FILE *outputFile, char *targetLocation)
+{
+    // Analisar conteudo do diretório e subdiretórios recursivamente.
+    if (flags->targetIsFolder)
+    {
+        char merkleDigest[DIGEST_MAX_HEX_LEN + 1];
+        if (analyseDir(childArgv, childArgc, flags, summary, hashFunctions, outputFile, targetLocation, merkleDigest))
+        {
+            printf("Failed to analyse directory '%s'\n", targetLocation);
+            return -1;
+        }
+
+        // Um processo filho envia o sumário Merkle do seu diretório ao pai
+        if (flags->merkleDigests && isReportingChild())
+        {
+            char report[DIGEST_MAX_HEX_LEN + 4];
+            sprintf(report, "M %s\n", merkleDigest);
+            if (sendReport(report) != 0)
+                return -1;
+        }
+    }
+    // Analisar apenas ficheiro/diretório
+    else if (flags->summaryMode)
+    {
+        struct stat fileStat;
+        if (stat(targetLocation, &fileStat) == -1 || summariseFile(summary, &fileStat, targetLocation) == -1)
+        {
+            printf("Failed to analyse file '%s'\n", targetLocation);
+            return -1;
+        }
+    }
+    else if (flags->timelineMode)
+    {
+        struct stat fileStat;
+        if (stat(targetLocation, &fileStat) == -1 || addTimelineEvents(targetLocation, &fileStat) == -1)
+        {
+            printf("Failed to analyse file '%s'\n", targetLocation);
+            return -1;
+        }
+    }
+    else
+    {
+        if (analyseFile(flags, hashFunctions, outputFile, targetLocation, NULL, NULL) == -1)
+        {
+            printf("Failed to analyse file '%s'\n", targetLocation);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[]) //char *envp[]
 {
     // Declarar variaveis
-    Flags flags = {0, 0, 0, 0};
-    char *targetLocation = NULL;
+    // Campos não indicados ficam a 0 / NULL
+    Flags flags = {
+        .traversalOrder = ORDER_READDIR,
+        .hashBackend = HASH_BACKEND_USER,
+        .summaryTopN = 10,
+        .jobs = 1,
+        .similarMinScore = 1,
+        .minJobs = 1,
+        .maxBufferMemory = IO_GOVERNOR_DEFAULT_MEMORY,
+        .maxCpu = 100,
+    };
+    int *targetArgs = NULL;
+    int targetCount = 0;
     char *hashFunctions = NULL;
     char *outputFileName = NULL;
     FILE *outputFile = NULL;
+    initFilter(&flags.filter);
 
     // Ler e processar argumentos do programa
-    if (readArguments(argc, argv, &flags, &hashFunctions, &outputFileName, &targetLocation) != 0)
+    if (readArguments(argc, argv, &flags, &hashFunctions, &outputFileName, &targetArgs, &targetCount) != 0)
         return -1;
+    char *targetLocation = argv[targetArgs[0]];
 
     // Se a flag de escrito para ficheiro estiver activada, tentar abrir o ficheiro indicado nos argumentos.
     if (flags.writeToFile)
     {
         // Abrir em mode append "a", para escrever sempre no fim do documento.
-        // Ficheiro é criado caso não exista.
-        outputFile = fopen(outputFileName, "a");
+        // Ficheiro é criado caso não exista. Com "-z" a compressão é feita numa thread à parte.
+        outputFile = flags.compressOutput ? openCompressedOutput(outputFileName) : fopen(outputFileName, "a");
         if (outputFile == NULL)
             exit(EXIT_FAILURE);
     }
 
-    // Analisar conteudo do diretório e subdiretórios recursivamente.
-    if (flags.targetIsFolder)
+    // A partir daqui todas as saídas passam pela limpeza: com "-z" só o fclose() escreve o fim do ficheiro comprimido.
+    int ret = 0;
+    int buildsIndex = 0;
+    int writesTimeline = 0;
+    int hasSummary = 0;
+    Summary summary;
+
+    // Os limites de leitura e de CPU são partilhados por todos os processos da análise.
+    if (openThrottle(flags.maxReadRate, flags.maxIops, flags.maxCpu) != 0)
+    {
+        ret = -1;
+        goto cleanup;
+    }
+
+    // Com "--verify" o alvo é comparado com o índice num só processo, com uma thread por core se "-j" não for dado.
+    if (flags.verifyPath != NULL)
     {
-        if (analyseDir(argv, argc, hashFunctions, outputFile, targetLocation))
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned int jobs = (flags.jobs > 1 || cores < 1) ? flags.jobs : (unsigned int)cores;
+        ret = verifyManifest(flags.verifyPath, targetLocation, &flags.filter, jobs, outputFile);
+        goto cleanup;
+    }
+
+    // Com "--similar" o alvo é um output já escrito, comparado com o de referência sem analisar ficheiros.
+    if (flags.similarPath != NULL)
+    {
+        ret = findSimilar(flags.similarPath, targetLocation, flags.similarMinScore, outputFile);
+        goto cleanup;
+    }
+
+    // Com "--index" todos os processos acrescentam os ficheiros a um registo, que o processo inicial ordena no fim.
+    if (flags.indexPath != NULL && (buildsIndex = openManifestLog(flags.indexPath)) == -1)
+    {
+        ret = -1;
+        goto cleanup;
+    }
+
+    // Na linha temporal todos os processos registam os eventos, que o processo inicial ordena no fim.
+    if (flags.timelineMode && (writesTimeline = openTimelineLog()) == -1)
+    {
+        ret = -1;
+        goto cleanup;
+    }
+
+    // Com "--profile" todos os processos medem as etapas, o processo inicial junta as medições e escreve o relatório.
+    if (flags.profilePath != NULL && openProfile(flags.profilePath) == -1)
+    {
+        ret = -1;
+        goto cleanup;
+    }
+
+    // No modo resumo cada processo acumula os seus totais, que são juntados pelo processo pai.
+    if (flags.summaryMode)
+    {
+        if (initSummary(&summary, flags.summaryTopN) != 0)
         {
-            printf("Failed to analyse directory '%s'\n", targetLocation);
-            return -1;
+            ret = -1;
+            goto cleanup;
         }
+        hasSummary = 1;
+    }
+
+    // Com "--shards" os alvos são repartidos pelos processos de análise, senão são analisados um a seguir ao outro.
+    if (flags.shards > 0)
+    {
+        char *targets[targetCount];
+        for (int i = 0; i < targetCount; i++)
+            targets[i] = argv[targetArgs[i]];
+        ret = runShards(&flags, hashFunctions, outputFile, targets, targetCount);
     }
-    // Analisar apenas ficheiro/diretório
     else
     {
-        if (analyseFile(hashFunctions, outputFile, targetLocation) == -1)
+        // Os processos filhos recebem as mesmas opções, com o seu diretório como único alvo (o último argumento).
+        char *childArgv[argc - targetCount + 2];
+        int childArgc = 0;
+        for (int i = 0, next = 0; i < argc; i++)
         {
-            printf("Failed to analyse file '%s'\n", targetLocation);
-            return -1;
+            if (next < targetCount && targetArgs[next] == i)
+                next++;
+            else
+                childArgv[childArgc++] = argv[i];
+        }
+        childArgv[childArgc++] = NULL;
+        childArgv[childArgc] = NULL;
+
+        for (int i = 0; i < targetCount; i++)
+            if (analyseTarget(childArgv, childArgc, &flags, flags.summaryMode ? &summary : NULL, hashFunctions, outputFile, argv[targetArgs[i]]) != 0)
+                ret = -1;
+    }
+
+    // Um alvo que falhe só muda o código de saída: o que foi analisado continua a ser resumido e indexado.
+    // Um processo filho envia o resumo ao pai, o processo inicial escreve-o.
+    if (flags.summaryMode)
+    {
+        if (isReportingChild())
+        {
+            char *report = serializeSummary(&summary);
+            if (report == NULL || sendReport(report) != 0)
+                ret = -1;
+            free(report);
         }
+        else
+            printSummary(&summary, outputFile);
     }
 
+    if (writesTimeline && writeTimeline(outputFile) != 0)
+    {
+        printf("Failed to write timeline\n");
+        ret = -1;
+    }
+
+    if (buildsIndex && buildManifest(flags.indexPath) != 0)
+    {
+        printf("Failed to write index '%s'\n", flags.indexPath);
+        ret = -1;
+    }
+
+    if (flags.profilePath != NULL && closeProfile() != 0)
+    {
+        printf("Failed to write profile '%s'\n", flags.profilePath);
+        ret = -1;
+    }
+
+cleanup:
     // Limpeza
-    if (outputFile)
-        fclose(outputFile);
+    if (hasSummary)
+        freeSummary(&summary);
+    if (writesTimeline)
+        discardTimeline();
+    discardProfile();
+    if (outputFile && fclose(outputFile) != 0)
+        ret = -1;
     if (outputFileName)
         free(outputFileName);
     if (hashFunctions)
         free(hashFunctions);
-    if (targetLocation)
-        free(targetLocation);
+    free(targetArgs);
+    freeFilter(&flags.filter);
+    freeSignatures(flags.signatures);
+    closeHashSet(flags.knownFiles);
+    closeThrottle();
 
-    return 0;
+    return ret;
 }
@@ -0,0 +1,743 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "manifest.h"
+
+#define MANIFEST_MAGIC "FRNSIDX1"
+#define MANIFEST_VERSION 1
+
+// Tamanho alvo de cada bloco de dados
+#define MANIFEST_BLOCK_SIZE 4096
+
+// Variável de ambiente com o registo onde todos os processos da análise acrescentam os ficheiros
+#define MANIFEST_LOG_ENV "FORENSIC_INDEX_LOG"
+
+// Registo deste processo, aberto em modo append
+static int logFd = -1;
+
+typedef struct
+{
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+// Registo lido do ficheiro de registo, antes de ser ordenado
+typedef struct
+{
+    const char *path;
+    const unsigned char *value;
+    size_t valueLength;
+} LogEntry;
+
+// Posição de leitura dentro de um bloco de dados
+typedef struct
+{
+    const unsigned char *next;
+    const unsigned char *end;
+    char *key;
+    size_t keyCapacity;
+    ManifestRecord record;
+} BlockCursor;
+
+/*
+ * Codificação
+ */
+
+static int reserveBytes(ByteBuffer *buffer, size_t length)
+{
+    if (buffer->length + length <= buffer->capacity)
+        return 0;
+
+    size_t capacity = (buffer->capacity == 0) ? 256 : buffer->capacity;
+    while (capacity < buffer->length + length)
+        capacity *= 2;
+    unsigned char *data = realloc(buffer->data, capacity);
+    if (data == NULL)
+        return -1;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+static int putBytes(ByteBuffer *buffer, const void *data, size_t length)
+{
+    if (reserveBytes(buffer, length) != 0)
+        return -1;
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return 0;
+}
+
+static int putVarint(ByteBuffer *buffer, uint64_t value)
+{
+    unsigned char bytes[10];
+    size_t length = 0;
+    do
+    {
+        bytes[length] = value & 0x7f;
+        value >>= 7;
+        if (value != 0)
+            bytes[length] |= 0x80;
+        length++;
+    } while (value != 0);
+    return putBytes(buffer, bytes, length);
+}
+
+// Datas negativas ficam com poucos bytes em zigzag
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int readVarint(const unsigned char **next, const unsigned char *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (*next >= end)
+            return -1;
+        unsigned char byte = *(*next)++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return 0;
+    }
+    return -1;
+}
+
+// Valor de um registo: tamanho, modo, datas, tipo e sumários
+static int encodeValue(ByteBuffer *buffer, const ManifestRecord *record)
+{
+    if (putVarint(buffer, record->size) != 0 || putVarint(buffer, record->mode) != 0 ||
+        putVarint(buffer, zigzag(record->atime)) != 0 || putVarint(buffer, zigzag(record->ctime)) != 0 ||
+        putVarint(buffer, zigzag(record->mtime)) != 0 ||
+        putBytes(buffer, record->fileType, strlen(record->fileType) + 1) != 0)
+        return -1;
+
+    unsigned char count = record->digestCount;
+    if (putBytes(buffer, &count, 1) != 0)
+        return -1;
+    for (size_t i = 0; i < record->digestCount; i++)
+        if (putBytes(buffer, &record->digestLength[i], 1) != 0 ||
+            putBytes(buffer, record->digests[i], record->digestLength[i]) != 0)
+            return -1;
+
+    return 0;
+}
+
+static int decodeValue(const unsigned char *next, const unsigned char *end, ManifestRecord *record)
+{
+    uint64_t mode, atime, ctime, mtime;
+    if (readVarint(&next, end, &record->size) != 0 || readVarint(&next, end, &mode) != 0 ||
+        readVarint(&next, end, &atime) != 0 || readVarint(&next, end, &ctime) != 0 ||
+        readVarint(&next, end, &mtime) != 0)
+        return -1;
+    record->mode = mode;
+    record->atime = unzigzag(atime);
+    record->ctime = unzigzag(ctime);
+    record->mtime = unzigzag(mtime);
+
+    const unsigned char *typeEnd = memchr(next, '\0', end - next);
+    if (typeEnd == NULL || typeEnd + 1 >= end)
+        return -1;
+    record->fileType = (const char *)next;
+    next = typeEnd + 1;
+
+    record->digestCount = *next++;
+    if (record->digestCount > DIGEST_MAX_PER_FILE)
+        return -1;
+    for (size_t i = 0; i < record->digestCount; i++)
+    {
+        if (next >= end || *next > MANIFEST_DIGEST_BYTES || end - next - 1 < *next)
+            return -1;
+        record->digestLength[i] = *next++;
+        memcpy(record->digests[i], next, record->digestLength[i]);
+        next += record->digestLength[i];
+    }
+
+    return 0;
+}
+
+int parseManifestDigest(const char *hex, unsigned char digest[MANIFEST_DIGEST_BYTES])
+{
+    size_t length = strlen(hex);
+    if (length != 32 && length != 40 && length != 64)
+        return -1;
+
+    memset(digest, 0, MANIFEST_DIGEST_BYTES);
+    for (size_t i = 0; i < length / 2; i++)
+    {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+            return -1;
+        digest[i] = byte;
+    }
+    return length / 2;
+}
+
+/*
+ * Escrita
+ */
+
+/*
+ * O processo inicial cria o registo ao lado do índice e indica-o na variável de ambiente, para os processos
+ * filhos (um por diretório) acrescentarem aí os seus ficheiros. Devolve 1 no processo que deve construir o índice.
+ */
+int openManifestLog(const char *indexPath)
+{
+    char *existing = getenv(MANIFEST_LOG_ENV);
+    if (existing != NULL)
+    {
+        if ((logFd = open(existing, O_WRONLY | O_APPEND | O_CLOEXEC)) == -1)
+        {
+            perror("open() error");
+            return -1;
+        }
+        return 0;
+    }
+
+    char *logPath = malloc(strlen(indexPath) + strlen(".log") + 1);
+    if (logPath == NULL)
+        return -1;
+    sprintf(logPath, "%s.log", indexPath);
+
+    if ((logFd = open(logPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644)) == -1)
+    {
+        perror("open() error");
+        free(logPath);
+        return -1;
+    }
+    setenv(MANIFEST_LOG_ENV, logPath, 1);
+    free(logPath);
+
+    return 1;
+}
+
+// Nos processos de "--shards" os registos de cada unidade ficam em memória até a unidade terminar
+static int capturing = 0;
+static ByteBuffer captured = {NULL, 0, 0};
+
+// Cada registo é escrito com um único write(), para os registos de processos diferentes não se misturarem.
+int appendManifestRecord(const ManifestRecord *record)
+{
+    ByteBuffer buffer = {NULL, 0, 0};
+    uint32_t length = 0;
+    if (putBytes(&buffer, &length, sizeof(length)) != 0 ||
+        putBytes(&buffer, record->path, strlen(record->path) + 1) != 0 ||
+        encodeValue(&buffer, record) != 0)
+    {
+        free(buffer.data);
+        return -1;
+    }
+    length = buffer.length - sizeof(length);
+    memcpy(buffer.data, &length, sizeof(length));
+
+    int ret = capturing ? putBytes(&captured, buffer.data, buffer.length) : writeManifestRecords(buffer.data, buffer.length);
+    free(buffer.data);
+
+    return ret;
+}
+
+// Acrescentar ao registo registos já codificados, com um único write().
+int writeManifestRecords(const void *records, size_t length)
+{
+    if (write(logFd, records, length) != (ssize_t)length)
+    {
+        perror("write() error");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Num processo de "--shards": guardar os registos em memória em vez de os escrever no registo. O coordenador só os
+ * escreve (com writeManifestRecords()) quando a unidade termina, e os de uma unidade repetida não ficam em dobro.
+ */
+void captureManifestRecords(void)
+{
+    capturing = 1;
+}
+
+// Registos guardados desde a última chamada (NULL se não houver), a libertar por quem chama.
+unsigned char *takeManifestRecords(size_t *length)
+{
+    unsigned char *records = captured.data;
+    *length = captured.length;
+    captured.data = NULL;
+    captured.length = captured.capacity = 0;
+    return records;
+}
+
+static int compareLogEntries(const void *a, const void *b)
+{
+    return strcmp(((const LogEntry *)a)->path, ((const LogEntry *)b)->path);
+}
+
+static int compareDigests(const void *a, const void *b)
+{
+    const ManifestDigest *first = a, *second = b;
+    if (first->length != second->length)
+        return (first->length < second->length) ? -1 : 1;
+    return memcmp(first->digest, second->digest, MANIFEST_DIGEST_BYTES);
+}
+
+static int writeBytes(FILE *file, const void *data, size_t length, uint64_t *offset)
+{
+    if (length > 0 && fwrite(data, 1, length, file) != length)
+        return -1;
+    *offset += length;
+    return 0;
+}
+
+static int writeManifest(FILE *file, LogEntry *entries, size_t count)
+{
+    ManifestHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MANIFEST_MAGIC, sizeof(header.magic));
+    header.version = MANIFEST_VERSION;
+    header.blockSize = MANIFEST_BLOCK_SIZE;
+
+    ByteBuffer block = {NULL, 0, 0}, keys = {NULL, 0, 0};
+    ManifestBlock *blocks = NULL;
+    ManifestDigest *digests = NULL;
+    size_t blockCapacity = 0, digestCapacity = 0;
+    uint64_t offset = 0;
+    int ret = -1;
+
+    if (writeBytes(file, &header, sizeof(header), &offset) != 0)
+        goto cleanup;
+
+    const char *previous = NULL;
+    for (size_t i = 0; i <= count; i++)
+    {
+        // Fechar o bloco actual quando enche ou no fim
+        if (block.length > 0 && (i == count || block.length >= MANIFEST_BLOCK_SIZE))
+        {
+            blocks[header.blockCount].offset = offset;
+            blocks[header.blockCount].length = block.length;
+            if (writeBytes(file, block.data, block.length, &offset) != 0)
+                goto cleanup;
+            header.blockCount++;
+            block.length = 0;
+            previous = NULL;
+        }
+        if (i == count)
+            break;
+
+        // Caminhos repetidos ficam apenas com o primeiro registo
+        if (i > 0 && strcmp(entries[i].path, entries[i - 1].path) == 0)
+            continue;
+
+        // Novo bloco: a primeira chave é guardada por inteiro no índice de blocos
+        if (block.length == 0)
+        {
+            if (header.blockCount == blockCapacity)
+            {
+                blockCapacity = (blockCapacity == 0) ? 64 : blockCapacity * 2;
+                ManifestBlock *grown = realloc(blocks, blockCapacity * sizeof(ManifestBlock));
+                if (grown == NULL)
+                    goto cleanup;
+                blocks = grown;
+            }
+            memset(&blocks[header.blockCount], 0, sizeof(ManifestBlock));
+            blocks[header.blockCount].keyOffset = keys.length;
+            blocks[header.blockCount].keyLength = strlen(entries[i].path);
+            if (putBytes(&keys, entries[i].path, strlen(entries[i].path) + 1) != 0)
+                goto cleanup;
+        }
+
+        // Guardar apenas o que difere da chave anterior do bloco
+        size_t shared = 0;
+        while (previous != NULL && previous[shared] != '\0' && previous[shared] == entries[i].path[shared])
+            shared++;
+        size_t unshared = strlen(entries[i].path) - shared;
+        if (putVarint(&block, shared) != 0 || putVarint(&block, unshared) != 0 ||
+            putVarint(&block, entries[i].valueLength) != 0 ||
+            putBytes(&block, entries[i].path + shared, unshared) != 0 ||
+            putBytes(&block, entries[i].value, entries[i].valueLength) != 0)
+            goto cleanup;
+        previous = entries[i].path;
+
+        // Índice secundário: cada sumário aponta para o bloco e posição do registo
+        ManifestRecord record;
+        if (decodeValue(entries[i].value, entries[i].value + entries[i].valueLength, &record) != 0)
+            goto cleanup;
+        for (size_t d = 0; d < record.digestCount; d++)
+        {
+            if (header.digestCount == digestCapacity)
+            {
+                digestCapacity = (digestCapacity == 0) ? 64 : digestCapacity * 2;
+                ManifestDigest *grown = realloc(digests, digestCapacity * sizeof(ManifestDigest));
+                if (grown == NULL)
+                    goto cleanup;
+                digests = grown;
+            }
+            ManifestDigest *digest = &digests[header.digestCount++];
+            memset(digest, 0, sizeof(ManifestDigest));
+            memcpy(digest->digest, record.digests[d], record.digestLength[d]);
+            digest->length = record.digestLength[d];
+            digest->block = header.blockCount;
+            digest->entry = blocks[header.blockCount].entryCount;
+        }
+        blocks[header.blockCount].entryCount++;
+        header.recordCount++;
+    }
+
+    // Primeiras chaves dos blocos, seguidas dos dois índices alinhados a 8 bytes
+    uint64_t keysOffset = offset;
+    if (writeBytes(file, keys.data, keys.length, &offset) != 0)
+        goto cleanup;
+    static const unsigned char padding[8] = {0};
+    if (writeBytes(file, padding, (8 - offset % 8) % 8, &offset) != 0)
+        goto cleanup;
+
+    header.blockIndexOffset = offset;
+    for (size_t i = 0; i < header.blockCount; i++)
+        blocks[i].keyOffset += keysOffset;
+    if (writeBytes(file, blocks, header.blockCount * sizeof(ManifestBlock), &offset) != 0)
+        goto cleanup;
+
+    header.digestIndexOffset = offset;
+    if (header.digestCount > 0)
+        qsort(digests, header.digestCount, sizeof(ManifestDigest), compareDigests);
+    if (writeBytes(file, digests, header.digestCount * sizeof(ManifestDigest), &offset) != 0)
+        goto cleanup;
+
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)
+        goto cleanup;
+    ret = 0;
+
+cleanup:
+    free(block.data);
+    free(keys.data);
+    free(blocks);
+    free(digests);
+    return ret;
+}
+
+/*
+ * Ordenar o registo acumulado por todos os processos e escrevê-lo como índice. O índice é escrito num
+ * ficheiro temporário e só substitui o anterior quando está completo.
+ */
+int buildManifest(const char *indexPath)
+{
+    close(logFd);
+    logFd = -1;
+
+    const char *logPath = getenv(MANIFEST_LOG_ENV);
+    if (logPath == NULL)
+        return -1;
+
+    int fd = open(logPath, O_RDONLY);
+    struct stat logStat;
+    if (fd == -1 || fstat(fd, &logStat) == -1)
+    {
+        perror("open() error");
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+
+    const unsigned char *log = NULL;
+    if (logStat.st_size > 0 && (log = mmap(NULL, logStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        perror("mmap() error");
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    LogEntry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    int ret = -1;
+
+    for (size_t position = 0; position + sizeof(uint32_t) <= (size_t)logStat.st_size;)
+    {
+        uint32_t length;
+        memcpy(&length, log + position, sizeof(length));
+        position += sizeof(length);
+        if (length > logStat.st_size - position)
+            break;
+
+        const unsigned char *pathEnd = memchr(log + position, '\0', length);
+        if (pathEnd == NULL)
+            break;
+
+        if (count == capacity)
+        {
+            capacity = (capacity == 0) ? 1024 : capacity * 2;
+            LogEntry *grown = realloc(entries, capacity * sizeof(LogEntry));
+            if (grown == NULL)
+                goto cleanup;
+            entries = grown;
+        }
+        entries[count].path = (const char *)(log + position);
+        entries[count].value = pathEnd + 1;
+        entries[count].valueLength = log + position + length - (pathEnd + 1);
+        count++;
+        position += length;
+    }
+    if (count > 0)
+        qsort(entries, count, sizeof(LogEntry), compareLogEntries);
+
+    char *tempPath = malloc(strlen(indexPath) + strlen(".tmp") + 1);
+    if (tempPath == NULL)
+        goto cleanup;
+    sprintf(tempPath, "%s.tmp", indexPath);
+
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL)
+        perror("fopen() error");
+    else
+    {
+        ret = writeManifest(file, entries, count);
+        if (fclose(file) != 0)
+            ret = -1;
+        if (ret == 0 && rename(tempPath, indexPath) != 0)
+        {
+            perror("rename() error");
+            ret = -1;
+        }
+        if (ret != 0)
+            unlink(tempPath);
+    }
+    free(tempPath);
+
+cleanup:
+    free(entries);
+    if (log != NULL)
+        munmap((void *)log, logStat.st_size);
+    unlink(logPath);
+    unsetenv(MANIFEST_LOG_ENV);
+
+    return ret;
+}
+
+/*
+ * Leitura
+ */
+
+int openManifest(Manifest *manifest, const char *path)
+{
+    memset(manifest, 0, sizeof(Manifest));
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(ManifestHeader))
+    {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *base = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+
+    manifest->base = base;
+    manifest->size = fileStat.st_size;
+    manifest->header = base;
+
+    // Validar o cabeçalho e os limites de todas as estruturas antes de as usar
+    const ManifestHeader *header = manifest->header;
+    int valid = memcmp(header->magic, MANIFEST_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == MANIFEST_VERSION &&
+                header->blockIndexOffset % 8 == 0 && header->digestIndexOffset % 8 == 0 &&
+                header->blockIndexOffset <= manifest->size &&
+                header->blockCount <= (manifest->size - header->blockIndexOffset) / sizeof(ManifestBlock) &&
+                header->digestIndexOffset <= manifest->size &&
+                header->digestCount <= (manifest->size - header->digestIndexOffset) / sizeof(ManifestDigest);
+
+    if (valid)
+    {
+        manifest->blocks = (const ManifestBlock *)(manifest->base + header->blockIndexOffset);
+        manifest->digests = (const ManifestDigest *)(manifest->base + header->digestIndexOffset);
+        for (size_t i = 0; valid && i < header->blockCount; i++)
+        {
+            const ManifestBlock *block = &manifest->blocks[i];
+            valid = block->offset <= manifest->size && block->length <= manifest->size - block->offset &&
+                    block->keyOffset < manifest->size && block->keyLength < manifest->size - block->keyOffset &&
+                    manifest->base[block->keyOffset + block->keyLength] == '\0';
+        }
+        for (size_t i = 0; valid && i < header->digestCount; i++)
+            valid = manifest->digests[i].block < header->blockCount;
+    }
+
+    if (!valid)
+    {
+        closeManifest(manifest);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void initCursor(BlockCursor *cursor, const Manifest *manifest, size_t block)
+{
+    cursor->next = manifest->base + manifest->blocks[block].offset;
+    cursor->end = cursor->next + manifest->blocks[block].length;
+}
+
+// Avançar para o registo seguinte do bloco: 1 se existe, 0 no fim, -1 se o bloco estiver corrompido
+static int nextEntry(BlockCursor *cursor)
+{
+    if (cursor->next >= cursor->end)
+        return 0;
+
+    uint64_t shared, unshared, valueLength;
+    if (readVarint(&cursor->next, cursor->end, &shared) != 0 ||
+        readVarint(&cursor->next, cursor->end, &unshared) != 0 ||
+        readVarint(&cursor->next, cursor->end, &valueLength) != 0 ||
+        (cursor->key == NULL && shared > 0) || (cursor->key != NULL && shared > strlen(cursor->key)) ||
+        unshared > (uint64_t)(cursor->end - cursor->next) ||
+        valueLength > (uint64_t)(cursor->end - cursor->next) - unshared)
+        return -1;
+
+    if (shared + unshared + 1 > cursor->keyCapacity)
+    {
+        size_t capacity = (shared + unshared + 1) * 2;
+        char *key = realloc(cursor->key, capacity);
+        if (key == NULL)
+            return -1;
+        cursor->key = key;
+        cursor->keyCapacity = capacity;
+    }
+    memcpy(cursor->key + shared, cursor->next, unshared);
+    cursor->key[shared + unshared] = '\0';
+    cursor->next += unshared;
+
+    if (decodeValue(cursor->next, cursor->next + valueLength, &cursor->record) != 0)
+        return -1;
+    cursor->record.path = cursor->key;
+    cursor->next += valueLength;
+
+    return 1;
+}
+
+// Último bloco cuja primeira chave não é maior que a chave procurada (0 se todas forem maiores)
+static size_t findBlock(const Manifest *manifest, const char *key)
+{
+    size_t low = 0, high = manifest->header->blockCount;
+    while (high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp((const char *)manifest->base + manifest->blocks[middle].keyOffset, key) <= 0)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Visitar os registos com a chave (ou com o prefixo) pedida, que estão contíguos a partir do bloco encontrado
+static int scanKeys(const Manifest *manifest, const char *key, int prefix, ManifestVisitor visit, void *context)
+{
+    size_t compareLength = strlen(key) + (prefix ? 0 : 1);
+    BlockCursor cursor = {NULL, NULL, NULL, 0, {0}};
+    int found = 0;
+
+    for (size_t block = findBlock(manifest, key); block < manifest->header->blockCount; block++)
+    {
+        initCursor(&cursor, manifest, block);
+        if (cursor.key != NULL)
+            cursor.key[0] = '\0';
+
+        int ret;
+        while ((ret = nextEntry(&cursor)) == 1)
+        {
+            int cmp = strncmp(cursor.key, key, compareLength);
+            if (cmp < 0)
+                continue;
+            if (cmp > 0)
+                goto done;
+
+            visit(&cursor.record, context);
+            found++;
+            if (!prefix)
+                goto done;
+        }
+        if (ret == -1)
+        {
+            found = -1;
+            goto done;
+        }
+    }
+
+done:
+    free(cursor.key);
+    return found;
+}
+
+int findManifestPath(const Manifest *manifest, const char *path, ManifestVisitor visit, void *context)
+{
+    return scanKeys(manifest, path, 0, visit, context);
+}
+
+int scanManifestPrefix(const Manifest *manifest, const char *prefix, ManifestVisitor visit, void *context)
+{
+    return scanKeys(manifest, prefix, 1, visit, context);
+}
+
+int findManifestDigest(const Manifest *manifest, const unsigned char *digest, size_t length, ManifestVisitor visit, void *context)
+{
+    ManifestDigest wanted;
+    memset(&wanted, 0, sizeof(wanted));
+    memcpy(wanted.digest, digest, length);
+    wanted.length = length;
+
+    // Primeira entrada com o sumário pedido
+    size_t low = 0, high = manifest->header->digestCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (compareDigests(&manifest->digests[middle], &wanted) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // O mesmo conteúdo pode existir em vários caminhos
+    int found = 0;
+    for (; low < manifest->header->digestCount && compareDigests(&manifest->digests[low], &wanted) == 0; low++)
+    {
+        BlockCursor cursor = {NULL, NULL, NULL, 0, {0}};
+        initCursor(&cursor, manifest, manifest->digests[low].block);
+
+        int ret = 0;
+        for (size_t entry = 0; entry <= manifest->digests[low].entry; entry++)
+            if ((ret = nextEntry(&cursor)) != 1)
+                break;
+        if (ret == 1)
+        {
+            visit(&cursor.record, context);
+            found++;
+        }
+        free(cursor.key);
+        if (ret != 1)
+            return -1;
+    }
+
+    return found;
+}
+
+void closeManifest(Manifest *manifest)
+{
+    if (manifest->base != NULL)
+        munmap((void *)manifest->base, manifest->size);
+    memset(manifest, 0, sizeof(Manifest));
+}
\ No newline at end of file
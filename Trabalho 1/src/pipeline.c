@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pipeline.h"
+#include "throttle.h"
+
+// Anel de buffers partilhado entre a leitura e os consumidores
+#define PIPELINE_BUFFERS 4
+#define PIPELINE_BUFFER_SIZE (1 << 20)
+#define PIPELINE_ALIGNMENT 4096
+
+typedef struct
+{
+    unsigned char *data[PIPELINE_BUFFERS];
+    size_t length[PIPELINE_BUFFERS];
+    size_t pending[PIPELINE_BUFFERS]; // Consumidores que ainda não processaram o buffer
+    size_t produced;                  // Número de buffers já preenchidos
+    int finished;
+    size_t stageCount;
+
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t released;
+} Ring;
+
+typedef struct
+{
+    Ring *ring;
+    PipelineStage *stage;
+} StageWorker;
+
+// Leitura de um ficheiro, respeitando os limites de "--max-read-rate" e "--max-iops".
+static ssize_t readFile(void *context, unsigned char *buffer, size_t size)
+{
+    int fd = *(int *)context;
+    ssize_t readBytes;
+    while ((readBytes = read(fd, buffer, size)) == -1 && errno == EINTR)
+        ;
+    if (readBytes > 0)
+        throttleRead(readBytes);
+    return readBytes;
+}
+
+// Ler até encher o buffer ou chegar ao fim dos dados.
+static ssize_t readFull(PipelineSource *source, unsigned char *buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t readBytes = source->read(source->context, buffer + total, size - total);
+        if (readBytes == -1)
+            return -1;
+        if (readBytes == 0)
+            break;
+        total += readBytes;
+    }
+    return total;
+}
+
+static void *stageWorker(void *arg)
+{
+    StageWorker *worker = arg;
+    Ring *ring = worker->ring;
+
+    for (size_t seq = 0;; seq++)
+    {
+        // Esperar pelo próximo buffer, ou terminar se a leitura já acabou e não há mais nenhum
+        pthread_mutex_lock(&ring->lock);
+        while (ring->produced <= seq && !ring->finished)
+            pthread_cond_wait(&ring->filled, &ring->lock);
+        int done = (ring->produced <= seq);
+        pthread_mutex_unlock(&ring->lock);
+        if (done)
+            break;
+
+        // Com "--max-cpu" a thread descansa depois de cada bloco, proporcionalmente ao CPU que gastou
+        size_t slot = seq % PIPELINE_BUFFERS;
+        struct timespec cpuStart;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+        worker->stage->consume(worker->stage->context, ring->data[slot], ring->length[slot]);
+        throttleCpu(&cpuStart);
+
+        // Devolver o buffer à leitura quando todos os consumidores o processaram
+        pthread_mutex_lock(&ring->lock);
+        if (--ring->pending[slot] == 0)
+            pthread_cond_signal(&ring->released);
+        pthread_mutex_unlock(&ring->lock);
+    }
+
+    return NULL;
+}
+
+// Ficheiros que cabem num único buffer são lidos e processados sem criar threads.
+static int runInline(PipelineSource *source, size_t size, PipelineStage *stages, size_t stageCount)
+{
+    unsigned char *buffer = malloc(size + 1);
+    if (buffer == NULL)
+        return -1;
+
+    ssize_t readBytes = readFull(source, buffer, size + 1);
+    if (readBytes == -1)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    // O ficheiro cresceu entretanto: processar o que foi lido e continuar pelo caminho normal
+    struct timespec cpuStart;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+    for (size_t i = 0; i < stageCount; i++)
+        if (readBytes > 0)
+            stages[i].consume(stages[i].context, buffer, readBytes);
+    throttleCpu(&cpuStart);
+
+    free(buffer);
+    return ((size_t)readBytes == size + 1) ? 1 : 0;
+}
+
+// Memória dos buffers usada para ler um ficheiro deste tamanho
+size_t readPipelineFootprint(uint64_t fileSize)
+{
+    if (fileSize <= PIPELINE_BUFFER_SIZE)
+        return fileSize + 1;
+    return (size_t)PIPELINE_BUFFERS * PIPELINE_BUFFER_SIZE;
+}
+
+int runReadPipeline(const char *path, PipelineStage *stages, size_t stageCount)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open() error");
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct stat fileStat;
+    uint64_t size = (fstat(fd, &fileStat) == 0) ? (uint64_t)fileStat.st_size : UINT64_MAX;
+    PipelineSource source = {readFile, &fd, size};
+    int ret = runSourcePipeline(&source, stages, stageCount);
+
+    close(fd);
+    return ret;
+}
+
+/*
+ * A thread que chama lê os dados para um anel de buffers alinhados, enquanto cada consumidor
+ * corre na sua thread sobre os buffers já lidos. Assim a leitura do próximo bloco sobrepõe-se
+ * ao cálculo dos sumários do anterior, mantendo o disco e os cores ocupados no mesmo ficheiro.
+ */
+int runSourcePipeline(PipelineSource *source, PipelineStage *stages, size_t stageCount)
+{
+    if (source->size <= PIPELINE_BUFFER_SIZE)
+    {
+        int ret = runInline(source, source->size, stages, stageCount);
+        if (ret <= 0)
+            return ret;
+    }
+
+    Ring ring;
+    memset(&ring, 0, sizeof(Ring));
+    ring.stageCount = stageCount;
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.filled, NULL);
+    pthread_cond_init(&ring.released, NULL);
+
+    int ret = 0;
+    for (size_t i = 0; i < PIPELINE_BUFFERS; i++)
+        if (posix_memalign((void **)&ring.data[i], PIPELINE_ALIGNMENT, PIPELINE_BUFFER_SIZE) != 0)
+            ret = -1;
+
+    StageWorker *workers = malloc(stageCount * sizeof(StageWorker));
+    pthread_t *threads = malloc(stageCount * sizeof(pthread_t));
+    size_t started = 0;
+    if (workers == NULL || threads == NULL)
+        ret = -1;
+
+    for (size_t i = 0; ret == 0 && i < stageCount; i++)
+    {
+        workers[i].ring = &ring;
+        workers[i].stage = &stages[i];
+        if (pthread_create(&threads[i], NULL, stageWorker, &workers[i]) != 0)
+        {
+            perror("pthread_create() error");
+            ret = -1;
+            break;
+        }
+        started++;
+    }
+
+    // Etapa de leitura
+    for (size_t seq = 0; ret == 0; seq++)
+    {
+        size_t slot = seq % PIPELINE_BUFFERS;
+
+        pthread_mutex_lock(&ring.lock);
+        while (ring.pending[slot] > 0)
+            pthread_cond_wait(&ring.released, &ring.lock);
+        pthread_mutex_unlock(&ring.lock);
+
+        ssize_t readBytes = readFull(source, ring.data[slot], PIPELINE_BUFFER_SIZE);
+        if (readBytes == -1)
+        {
+            perror("read() error");
+            ret = -1;
+            break;
+        }
+        if (readBytes == 0)
+            break;
+
+        pthread_mutex_lock(&ring.lock);
+        ring.length[slot] = readBytes;
+        ring.pending[slot] = stageCount;
+        ring.produced++;
+        pthread_cond_broadcast(&ring.filled);
+        pthread_mutex_unlock(&ring.lock);
+
+        if (readBytes < PIPELINE_BUFFER_SIZE)
+            break;
+    }
+
+    pthread_mutex_lock(&ring.lock);
+    ring.finished = 1;
+    pthread_cond_broadcast(&ring.filled);
+    pthread_mutex_unlock(&ring.lock);
+
+    for (size_t i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(workers);
+    free(threads);
+    for (size_t i = 0; i < PIPELINE_BUFFERS; i++)
+        free(ring.data[i]);
+    pthread_mutex_destroy(&ring.lock);
+    pthread_cond_destroy(&ring.filled);
+    pthread_cond_destroy(&ring.released);
+
+    return ret;
+}
\ No newline at end of file
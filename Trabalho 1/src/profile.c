@@ -0,0 +1,502 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "profile.h"
+
+// Variável de ambiente com o registo onde os processos filhos acrescentam as suas medições
+#define PROFILE_LOG_ENV "FORENSIC_PROFILE_LOG"
+
+// Histogramas log-lineares, como o HdrHistogram: 2^PROFILE_SUB_BITS baldes por potência de 2 (erro < 1/64)
+#define PROFILE_SUB_BITS 6
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BITS)
+
+// Durações a partir de 2^PROFILE_MAX_BITS ns (cerca de 18 minutos) ficam no último balde
+#define PROFILE_MAX_BITS 40
+#define PROFILE_BUCKETS ((PROFILE_MAX_BITS - PROFILE_SUB_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+static const char *stageNames[PROFILE_STAGES] = {"readdir", "stat", "type", "hash", "output"};
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t total; // ns
+    uint64_t max;   // ns
+    uint64_t buckets[PROFILE_BUCKETS];
+} Histogram;
+
+// Histogramas de uma thread: cada thread só escreve nos seus, sem locks
+typedef struct ThreadProfile
+{
+    Histogram stages[PROFILE_STAGES];
+    struct ThreadProfile *next;
+} ThreadProfile;
+
+// Registo de uma etapa de um processo filho, seguido dos baldes usados ({índice, contagem})
+typedef struct
+{
+    uint32_t stage;
+    uint32_t used;
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+} StageRecord;
+
+typedef struct
+{
+    uint64_t index;
+    uint64_t count;
+} BucketRecord;
+
+static int enabled = 0;
+static int logFd = -1;
+static char *logPath = NULL;
+static char *reportPath = NULL; // Só no processo que escreve o relatório
+static struct timespec startTime;
+static unsigned int processCount = 1;
+
+/*
+ * Histogramas das threads ainda a correr. Quando uma thread termina (as de "-j" são criadas em cada lote), os seus
+ * histogramas são juntados aos já terminados do processo e libertados; aí ficam também as medições das unidades
+ * dos processos de "--shards", recebidas pelo coordenador.
+ */
+static ThreadProfile *threadProfiles = NULL;
+static Histogram finishedThreads[PROFILE_STAGES];
+static pthread_mutex_t profilesLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t profileKey;
+static pthread_once_t profileKeyOnce = PTHREAD_ONCE_INIT;
+static __thread ThreadProfile *threadProfile = NULL;
+
+static size_t bucketIndex(uint64_t value)
+{
+    if (value >= (1ULL << PROFILE_MAX_BITS))
+        value = (1ULL << PROFILE_MAX_BITS) - 1;
+    if (value < PROFILE_SUB_BUCKETS)
+        return value;
+    int shift = 63 - __builtin_clzll(value) - PROFILE_SUB_BITS;
+    return ((size_t)(shift + 1) << PROFILE_SUB_BITS) + (value >> shift) - PROFILE_SUB_BUCKETS;
+}
+
+// Valor central do balde, em ns
+static double bucketValue(size_t index)
+{
+    if (index < PROFILE_SUB_BUCKETS)
+        return index;
+    int shift = index / PROFILE_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(index % PROFILE_SUB_BUCKETS + PROFILE_SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) - 1) / 2.0;
+}
+
+static void mergeHistogram(Histogram *into, const Histogram *from)
+{
+    into->count += from->count;
+    into->total += from->total;
+    if (from->max > into->max)
+        into->max = from->max;
+    for (size_t i = 0; i < PROFILE_BUCKETS; i++)
+        into->buckets[i] += from->buckets[i];
+}
+
+// Destrutor da chave da thread, chamado quando a thread termina.
+static void finishThread(void *value)
+{
+    ThreadProfile *profile = value;
+    pthread_mutex_lock(&profilesLock);
+    for (ThreadProfile **link = &threadProfiles; *link != NULL; link = &(*link)->next)
+        if (*link == profile)
+        {
+            *link = profile->next;
+            break;
+        }
+    for (int s = 0; s < PROFILE_STAGES; s++)
+        mergeHistogram(&finishedThreads[s], &profile->stages[s]);
+    pthread_mutex_unlock(&profilesLock);
+    free(profile);
+}
+
+static void createProfileKey(void)
+{
+    pthread_key_create(&profileKey, finishThread);
+}
+
+/*
+ * O processo inicial guarda o caminho do relatório e cria o registo temporário, indicado na variável de ambiente
+ * para os processos filhos acrescentarem aí as suas medições. Devolve 1 no processo que deve escrever o relatório.
+ */
+int openProfile(const char *path)
+{
+    enabled = 1;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    char *existing = getenv(PROFILE_LOG_ENV);
+    if (existing != NULL)
+    {
+        if ((logFd = open(existing, O_WRONLY | O_APPEND | O_CLOEXEC)) == -1)
+        {
+            perror("open() error");
+            return -1;
+        }
+        return 0;
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL)
+        tmp = "/tmp";
+    logPath = malloc(strlen(tmp) + strlen("/forensic-profile-XXXXXX") + 1);
+    reportPath = malloc(strlen(path) + 1);
+    if (logPath == NULL || reportPath == NULL)
+        return -1;
+    sprintf(logPath, "%s/forensic-profile-XXXXXX", tmp);
+    strcpy(reportPath, path);
+
+    if ((logFd = mkstemp(logPath)) == -1)
+    {
+        perror("mkstemp() error");
+        return -1;
+    }
+    fcntl(logFd, F_SETFD, FD_CLOEXEC);
+    setenv(PROFILE_LOG_ENV, logPath, 1);
+
+    return 1;
+}
+
+// Num processo criado com fork() (os processos de "--shards"), recomeçar as medições como um processo filho.
+void forkProfile(void)
+{
+    if (!enabled)
+        return;
+
+    // O descritor do processo inicial não está em modo append
+    close(logFd);
+    if ((logFd = open(logPath, O_WRONLY | O_APPEND | O_CLOEXEC)) == -1)
+        perror("open() error");
+
+    free(reportPath);
+    reportPath = NULL;
+    for (ThreadProfile *profile = threadProfiles; profile != NULL; profile = profile->next)
+        memset(profile->stages, 0, sizeof(profile->stages));
+    memset(finishedThreads, 0, sizeof(finishedThreads));
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+// Sem "--profile" nem o relógio é lido.
+void profileStart(struct timespec *start)
+{
+    if (enabled)
+        clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void profileEnd(ProfileStage stage, const struct timespec *start)
+{
+    if (!enabled)
+        return;
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int64_t elapsed = (int64_t)(end.tv_sec - start->tv_sec) * 1000000000 + (end.tv_nsec - start->tv_nsec);
+    uint64_t ns = (elapsed > 0) ? (uint64_t)elapsed : 0;
+
+    // Na primeira medição da thread, criar os seus histogramas
+    if (threadProfile == NULL)
+    {
+        if ((threadProfile = calloc(1, sizeof(ThreadProfile))) == NULL)
+            return;
+        pthread_once(&profileKeyOnce, createProfileKey);
+        pthread_setspecific(profileKey, threadProfile);
+        pthread_mutex_lock(&profilesLock);
+        threadProfile->next = threadProfiles;
+        threadProfiles = threadProfile;
+        pthread_mutex_unlock(&profilesLock);
+    }
+
+    Histogram *histogram = &threadProfile->stages[stage];
+    histogram->count++;
+    histogram->total += ns;
+    if (ns > histogram->max)
+        histogram->max = ns;
+    histogram->buckets[bucketIndex(ns)]++;
+}
+
+// Juntar os histogramas de todas as threads do processo: as já terminadas e as que restam (a thread principal).
+static void mergeThreads(Histogram *stages)
+{
+    pthread_mutex_lock(&profilesLock);
+    for (int s = 0; s < PROFILE_STAGES; s++)
+        mergeHistogram(&stages[s], &finishedThreads[s]);
+    for (ThreadProfile *profile = threadProfiles; profile != NULL; profile = profile->next)
+        for (int s = 0; s < PROFILE_STAGES; s++)
+            mergeHistogram(&stages[s], &profile->stages[s]);
+    pthread_mutex_unlock(&profilesLock);
+}
+
+// Registo com as medições, só com os baldes usados, precedido do seu comprimento (incluído).
+static unsigned char *encodeProfile(const Histogram *stages, size_t *recordSize)
+{
+    size_t length = sizeof(uint32_t);
+    for (int s = 0; s < PROFILE_STAGES; s++)
+    {
+        length += sizeof(StageRecord);
+        for (size_t i = 0; i < PROFILE_BUCKETS; i++)
+            length += (stages[s].buckets[i] != 0) ? sizeof(BucketRecord) : 0;
+    }
+
+    unsigned char *record = malloc(length);
+    if (record == NULL)
+        return NULL;
+
+    uint32_t recordLength = length;
+    memcpy(record, &recordLength, sizeof(recordLength));
+    size_t offset = sizeof(recordLength);
+    for (int s = 0; s < PROFILE_STAGES; s++)
+    {
+        StageRecord stage = {s, 0, stages[s].count, stages[s].total, stages[s].max};
+        for (size_t i = 0; i < PROFILE_BUCKETS; i++)
+            stage.used += (stages[s].buckets[i] != 0);
+        memcpy(record + offset, &stage, sizeof(stage));
+        offset += sizeof(stage);
+
+        for (size_t i = 0; i < PROFILE_BUCKETS; i++)
+            if (stages[s].buckets[i] != 0)
+            {
+                BucketRecord bucket = {i, stages[s].buckets[i]};
+                memcpy(record + offset, &bucket, sizeof(bucket));
+                offset += sizeof(bucket);
+            }
+    }
+
+    *recordSize = length;
+    return record;
+}
+
+// Juntar a stages as medições de um registo de encodeProfile().
+static int decodeProfile(Histogram *stages, const unsigned char *record, size_t length)
+{
+    uint32_t recordLength;
+    if (length < sizeof(recordLength))
+        return -1;
+    memcpy(&recordLength, record, sizeof(recordLength));
+    if (recordLength != length)
+        return -1;
+
+    size_t offset = sizeof(recordLength);
+    for (int s = 0; s < PROFILE_STAGES; s++)
+    {
+        StageRecord stage;
+        if (length - offset < sizeof(stage))
+            return -1;
+        memcpy(&stage, record + offset, sizeof(stage));
+        offset += sizeof(stage);
+        if (stage.stage >= PROFILE_STAGES || (length - offset) / sizeof(BucketRecord) < stage.used)
+            return -1;
+
+        Histogram *histogram = &stages[stage.stage];
+        histogram->count += stage.count;
+        histogram->total += stage.total;
+        if (stage.max > histogram->max)
+            histogram->max = stage.max;
+
+        for (uint32_t i = 0; i < stage.used; i++)
+        {
+            BucketRecord bucket;
+            memcpy(&bucket, record + offset, sizeof(bucket));
+            offset += sizeof(bucket);
+            if (bucket.index >= PROFILE_BUCKETS)
+                return -1;
+            histogram->buckets[bucket.index] += bucket.count;
+        }
+    }
+    return 0;
+}
+
+// Um processo filho acrescenta as suas medições ao registo numa única escrita.
+static int appendProfile(const Histogram *stages)
+{
+    size_t length;
+    unsigned char *record = encodeProfile(stages, &length);
+    if (record == NULL)
+        return -1;
+
+    int ret = (write(logFd, record, length) == (ssize_t)length) ? 0 : -1;
+    free(record);
+    return ret;
+}
+
+// Juntar as medições que os processos filhos deixaram no registo, um registo por processo.
+static int readProfileLog(Histogram *stages)
+{
+    FILE *log = fopen(logPath, "rb");
+    if (log == NULL)
+    {
+        perror("fopen() error");
+        return -1;
+    }
+
+    int ret = 0;
+    uint32_t recordLength;
+    while (ret == 0 && fread(&recordLength, sizeof(recordLength), 1, log) == 1)
+    {
+        processCount++;
+        unsigned char *record = (recordLength >= sizeof(recordLength)) ? malloc(recordLength) : NULL;
+        if (record == NULL)
+        {
+            ret = -1;
+            break;
+        }
+        memcpy(record, &recordLength, sizeof(recordLength));
+        if (fread(record + sizeof(recordLength), 1, recordLength - sizeof(recordLength), log) != recordLength - sizeof(recordLength) ||
+            decodeProfile(stages, record, recordLength) != 0)
+            ret = -1;
+        free(record);
+    }
+
+    fclose(log);
+    return ret;
+}
+
+/*
+ * Num processo de "--shards", no fim de cada unidade: as medições feitas desde a última chamada, num registo que
+ * o coordenador junta às suas com addProfile() só se a unidade terminar. NULL sem "--profile" ou em caso de erro.
+ */
+unsigned char *takeProfile(size_t *length)
+{
+    if (!enabled)
+        return NULL;
+
+    Histogram *stages = calloc(PROFILE_STAGES, sizeof(Histogram));
+    if (stages == NULL)
+        return NULL;
+    mergeThreads(stages);
+
+    pthread_mutex_lock(&profilesLock);
+    for (ThreadProfile *profile = threadProfiles; profile != NULL; profile = profile->next)
+        memset(profile->stages, 0, sizeof(profile->stages));
+    memset(finishedThreads, 0, sizeof(finishedThreads));
+    pthread_mutex_unlock(&profilesLock);
+
+    unsigned char *record = encodeProfile(stages, length);
+    free(stages);
+    return record;
+}
+
+// No coordenador de "--shards": juntar o registo de takeProfile() de uma unidade terminada.
+int addProfile(const unsigned char *record, size_t length)
+{
+    if (!enabled)
+        return 0;
+
+    pthread_mutex_lock(&profilesLock);
+    int ret = decodeProfile(finishedThreads, record, length);
+    pthread_mutex_unlock(&profilesLock);
+    return ret;
+}
+
+// Duração (em µs) abaixo da qual estão q das medições, limitada ao máximo exato.
+static double percentile(const Histogram *histogram, double q)
+{
+    if (histogram->count == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(q * histogram->count);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < PROFILE_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= target)
+        {
+            double value = bucketValue(i);
+            return ((value < histogram->max) ? value : histogram->max) / 1e3;
+        }
+    }
+    return histogram->max / 1e3;
+}
+
+static int writeReport(const Histogram *stages)
+{
+    FILE *report = fopen(reportPath, "w");
+    if (report == NULL)
+    {
+        perror("fopen() error");
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall = (now.tv_sec - startTime.tv_sec) + (now.tv_nsec - startTime.tv_nsec) / 1e9;
+
+    uint64_t measured = 0;
+    for (int s = 0; s < PROFILE_STAGES; s++)
+        measured += stages[s].total;
+
+    fprintf(report, "{\n  \"wall_seconds\": %.6f,\n  \"processes\": %u,\n  \"measured_seconds\": %.6f,\n  \"stages\": {\n",
+            wall, processCount, measured / 1e9);
+    for (int s = 0; s < PROFILE_STAGES; s++)
+    {
+        const Histogram *histogram = &stages[s];
+        fprintf(report, "    \"%s\": {\"count\": %llu, \"total_seconds\": %.6f, \"mean_us\": %.3f, "
+                        "\"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}%s\n",
+                stageNames[s], (unsigned long long)histogram->count, histogram->total / 1e9,
+                histogram->count ? histogram->total / 1e3 / histogram->count : 0.0,
+                percentile(histogram, 0.50), percentile(histogram, 0.99), histogram->max / 1e3,
+                (s + 1 < PROFILE_STAGES) ? "," : "");
+    }
+    fprintf(report, "  }\n}\n");
+
+    return (fclose(report) == 0) ? 0 : -1;
+}
+
+/*
+ * No fim da análise: um processo filho acrescenta as suas medições ao registo; o processo inicial junta-as às suas
+ * e escreve o relatório (JSON) com, por etapa, o número de medições, o tempo total, a média, p50, p99 e máximo.
+ */
+int closeProfile(void)
+{
+    if (!enabled)
+        return 0;
+
+    Histogram *stages = calloc(PROFILE_STAGES, sizeof(Histogram));
+    if (stages == NULL)
+    {
+        discardProfile();
+        return -1;
+    }
+    mergeThreads(stages);
+
+    int ret;
+    if (reportPath == NULL)
+        ret = appendProfile(stages);
+    else
+    {
+        ret = readProfileLog(stages);
+        if (ret == 0)
+            ret = writeReport(stages);
+    }
+
+    free(stages);
+    discardProfile();
+    return ret;
+}
+
+// Terminar sem relatório (ou depois de o escrever): o processo inicial apaga o registo temporário.
+void discardProfile(void)
+{
+    if (!enabled)
+        return;
+
+    if (logFd != -1)
+    {
+        if (reportPath != NULL)
+            unlink(logPath);
+        close(logFd);
+        logFd = -1;
+    }
+    free(logPath);
+    free(reportPath);
+    logPath = NULL;
+    reportPath = NULL;
+    enabled = 0;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "dateFormat.h"
+#include "manifest.h"
+
+/*
+    forensic-query index.idx path 'caminho'
+    forensic-query index.idx prefix 'prefixo'
+    forensic-query index.idx digest 'md5/sha1/sha256 em hexadecimal'
+
+    Consultas ao índice escrito por "forensic --index". O índice é mapeado com mmap() e cada consulta
+    lê apenas os blocos de que precisa.
+
+    Output (uma linha por ficheiro encontrado):
+        file_name,file_type,file_size,file_access,file_access_date,file_change_date,file_modification_date,digests...
+
+    Termina com 0 se encontrar algum ficheiro, 1 se não encontrar nenhum.
+*/
+
+// Datas no mesmo formato do output do forensic
+static char *formatDate(int64_t seconds)
+{
+    time_t time = seconds;
+    struct tm ts;
+    char *formattedDate = NULL;
+    if (localtime_r(&time, &ts) == NULL || GetFormattedDate(&ts, &formattedDate) != 0)
+    {
+        free(formattedDate);
+        return NULL;
+    }
+    return formattedDate;
+}
+
+static void printRecord(const ManifestRecord *record, void *context)
+{
+    (void)context;
+
+    char *atimeStr = formatDate(record->atime);
+    char *ctimeStr = formatDate(record->ctime);
+    char *mtimeStr = formatDate(record->mtime);
+
+    printf("%s,%s,%llu,%s%s%s%s%s%s%s%s%s%s,%s,%s,%s",
+           record->path,
+           record->fileType,
+           (unsigned long long)record->size,
+           (S_ISDIR(record->mode)) ? "d" : "-",
+           (record->mode & S_IRUSR) ? "r" : "-",
+           (record->mode & S_IWUSR) ? "w" : "-",
+           (record->mode & S_IXUSR) ? "x" : "-",
+
+           (record->mode & S_IRGRP) ? "r" : "-",
+           (record->mode & S_IWGRP) ? "w" : "-",
+           (record->mode & S_IXGRP) ? "x" : "-",
+
+           (record->mode & S_IROTH) ? "r" : "-",
+           (record->mode & S_IWOTH) ? "w" : "-",
+           (record->mode & S_IXOTH) ? "x" : "-",
+           atimeStr ? atimeStr : "?",
+           ctimeStr ? ctimeStr : "?",
+           mtimeStr ? mtimeStr : "?");
+    free(atimeStr);
+    free(ctimeStr);
+    free(mtimeStr);
+
+    for (size_t i = 0; i < record->digestCount; i++)
+    {
+        putchar(',');
+        for (size_t b = 0; b < record->digestLength[i]; b++)
+            printf("%02x", record->digests[i][b]);
+    }
+    putchar('\n');
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        printf("Uso: %s índice path|prefix|digest valor\n", argv[0]);
+        return -1;
+    }
+
+    Manifest manifest;
+    if (openManifest(&manifest, argv[1]) != 0)
+    {
+        printf("Não foi possível abrir o índice '%s': %s\n", argv[1], strerror(errno));
+        return -1;
+    }
+
+    int found;
+    if (strcmp(argv[2], "path") == 0)
+        found = findManifestPath(&manifest, argv[3], printRecord, NULL);
+    else if (strcmp(argv[2], "prefix") == 0)
+        found = scanManifestPrefix(&manifest, argv[3], printRecord, NULL);
+    else if (strcmp(argv[2], "digest") == 0)
+    {
+        unsigned char digest[MANIFEST_DIGEST_BYTES];
+        int length = parseManifestDigest(argv[3], digest);
+        if (length == -1)
+        {
+            printf("Sumário inválido: '%s' (md5, sha1 ou sha256 em hexadecimal)\n", argv[3]);
+            closeManifest(&manifest);
+            return -1;
+        }
+        found = findManifestDigest(&manifest, digest, length, printRecord, NULL);
+    }
+    else
+    {
+        printf("Consulta inválida: '%s' (path, prefix, digest)\n", argv[2]);
+        closeManifest(&manifest);
+        return -1;
+    }
+
+    closeManifest(&manifest);
+
+    if (found == -1)
+    {
+        printf("Índice '%s' corrompido!\n", argv[1]);
+        return -1;
+    }
+    return (found > 0) ? 0 : 1;
+}
\ No newline at end of file
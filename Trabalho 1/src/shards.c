@@ -0,0 +1,842 @@
+#define _GNU_SOURCE // MSG_NOSIGNAL, SOCK_CLOEXEC
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "fileAnalysis.h"
+#include "manifest.h"
+#include "profile.h"
+#include "timeline.h"
+#include "shards.h"
+
+// Máximo de ficheiros de um diretório numa unidade de trabalho
+#define SHARD_UNIT_FILES 256
+
+// Unidades distribuídas à frente da mais antiga ainda por escrever, por processo de análise
+#define SHARD_WINDOW_PER_WORKER 16
+
+// Vezes que uma unidade é analisada antes de se desistir dela (o processo que a analisava terminou)
+#define SHARD_MAX_ATTEMPTS 2
+
+// Tipos das mensagens trocadas com os processos de análise
+#define SHARD_FRAME_UNIT 1   // Coordenador -> processo: entradas a analisar
+#define SHARD_FRAME_RECORD 2 // Processo -> coordenador: uma linha do output
+#define SHARD_FRAME_DONE 3   // Processo -> coordenador: unidade terminada
+
+// Processo -> coordenador: o que a unidade acrescentaria aos registos partilhados, só escrito quando ela termina
+#define SHARD_FRAME_TIMELINE 4 // Eventos de "--timeline"
+#define SHARD_FRAME_INDEX 5    // Registos de "--index"
+#define SHARD_FRAME_PROFILE 6  // Medições de "--profile"
+#define SHARD_LOGS 3
+#define SHARD_LOG(type) ((type) - SHARD_FRAME_TIMELINE)
+
+// Tipo de cada entrada de uma unidade
+#define SHARD_ENTRY_TARGET 't' // Alvo da linha de comandos, analisado tal como foi dado
+#define SHARD_ENTRY_FILE 'e'   // Entrada de um diretório, sujeita aos filtros
+
+typedef struct
+{
+    uint32_t type;
+    uint32_t length;
+} ShardFrame;
+
+// Ficheiros analisados por um processo de uma só vez, com o output guardado até chegar a sua vez
+typedef struct
+{
+    uint64_t seq;
+    char *entries; // "tipo caminho\0" por entrada
+    size_t length;
+    unsigned int attempts;
+    int done;
+
+    char *output;
+    size_t outputLength;
+    size_t outputCapacity;
+
+    // Registos partilhados da unidade, por tipo (a partir de SHARD_FRAME_TIMELINE)
+    unsigned char *logs[SHARD_LOGS];
+    size_t logLength[SHARD_LOGS];
+} ShardUnit;
+
+typedef struct
+{
+    pid_t pid;
+    int fd;          // Lado do coordenador do socketpair, -1 se o processo não estiver a correr
+    ShardUnit *unit; // Unidade em análise, NULL se estiver livre
+
+    unsigned char *input;
+    size_t inputLength;
+    size_t inputCapacity;
+} ShardWorker;
+
+/*
+ * Produz as unidades pela ordem canónica: os alvos pela ordem da linha de comandos e, em cada diretório, os
+ * ficheiros ordenados pelo nome seguidos dos sub-diretórios, também ordenados. Só o diretório a ser
+ * distribuído é lido, os restantes ficam numa pilha.
+ */
+typedef struct
+{
+    Flags *flags;
+    char **targets;
+    int targetCount;
+    int nextTarget;
+
+    char **stack; // Diretórios por visitar, o próximo no topo
+    size_t stackCount;
+    size_t stackCapacity;
+
+    char **files; // Ficheiros do diretório atual
+    size_t fileCount;
+    size_t nextFile;
+
+    uint64_t nextSeq;
+} ShardSource;
+
+static int comparePaths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int pushDirectory(ShardSource *source, char *path)
+{
+    if (source->stackCount == source->stackCapacity)
+    {
+        size_t capacity = (source->stackCapacity == 0) ? 64 : source->stackCapacity * 2;
+        char **stack = realloc(source->stack, capacity * sizeof(char *));
+        if (stack == NULL)
+            return -1;
+        source->stack = stack;
+        source->stackCapacity = capacity;
+    }
+    source->stack[source->stackCount++] = path;
+    return 0;
+}
+
+static int appendPath(char ***paths, size_t *count, size_t *capacity, char *path)
+{
+    if (*count == *capacity)
+    {
+        size_t newCapacity = (*capacity == 0) ? 64 : *capacity * 2;
+        char **newPaths = realloc(*paths, newCapacity * sizeof(char *));
+        if (newPaths == NULL)
+            return -1;
+        *paths = newPaths;
+        *capacity = newCapacity;
+    }
+    (*paths)[(*count)++] = path;
+    return 0;
+}
+
+static struct dirent *readEntry(DIR *dir)
+{
+    struct timespec start;
+    profileStart(&start);
+    struct dirent *dent = readdir(dir);
+    profileEnd(PROFILE_READDIR, &start);
+    return dent;
+}
+
+// Ler um diretório: os ficheiros ficam para as próximas unidades, os sub-diretórios vão para a pilha.
+static int readShardDirectory(ShardSource *source, const char *targetLocation)
+{
+    DIR *dir;
+    if ((dir = opendir(targetLocation)) == NULL)
+    {
+        perror("Opendir() error");
+        printf("Failed to analyse directory '%s'\n", targetLocation);
+        return 0;
+    }
+
+    char **dirs = NULL;
+    size_t dirCount = 0, dirCapacity = 0, fileCapacity = 0;
+    int ret = 0;
+    struct dirent *dent;
+    while (ret == 0 && (dent = readEntry(dir)) != NULL)
+    {
+        if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
+            continue;
+
+        char *path = malloc(strlen(targetLocation) + strlen(dent->d_name) + 1 + 1);
+        if (path == NULL)
+        {
+            ret = -1;
+            break;
+        }
+        sprintf(path, "%s/%s", targetLocation, dent->d_name);
+
+        // Entradas excluídas (e, no caso de diretórios, toda a sub-árvore) são ignoradas sem serem abertas.
+        if (filterExcludes(&source->flags->filter, path))
+        {
+            free(path);
+            continue;
+        }
+
+        // Tal como na análise por processos, as ligações para diretórios são seguidas
+        int isDir = (dent->d_type == DT_DIR);
+        struct stat dirStat;
+        if ((dent->d_type == DT_LNK || dent->d_type == DT_UNKNOWN) && stat(path, &dirStat) == 0)
+            isDir = S_ISDIR(dirStat.st_mode);
+
+        if ((isDir ? appendPath(&dirs, &dirCount, &dirCapacity, path)
+                   : appendPath(&source->files, &source->fileCount, &fileCapacity, path)) != 0)
+        {
+            free(path);
+            ret = -1;
+        }
+    }
+    closedir(dir);
+
+    // Sem entradas as listas ainda não foram alocadas
+    if (source->fileCount > 1)
+        qsort(source->files, source->fileCount, sizeof(char *), comparePaths);
+    if (dirCount > 1)
+        qsort(dirs, dirCount, sizeof(char *), comparePaths);
+
+    // Ao contrário, para o primeiro sub-diretório ficar no topo da pilha
+    for (size_t i = dirCount; i > 0; i--)
+    {
+        if (ret == 0 && pushDirectory(source, dirs[i - 1]) != 0)
+            ret = -1;
+        if (ret != 0)
+            free(dirs[i - 1]);
+    }
+    free(dirs);
+    return ret;
+}
+
+static ShardUnit *newShardUnit(ShardSource *source, char type, char *paths[], size_t count)
+{
+    ShardUnit *unit = calloc(1, sizeof(ShardUnit));
+    if (unit == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < count; i++)
+        unit->length += 1 + strlen(paths[i]) + 1;
+    if ((unit->entries = malloc(unit->length)) == NULL)
+    {
+        free(unit);
+        return NULL;
+    }
+
+    char *next = unit->entries;
+    for (size_t i = 0; i < count; i++)
+    {
+        *next++ = type;
+        size_t length = strlen(paths[i]) + 1;
+        memcpy(next, paths[i], length);
+        next += length;
+    }
+
+    unit->seq = source->nextSeq++;
+    return unit;
+}
+
+static void freeSourceFiles(ShardSource *source)
+{
+    for (size_t i = 0; i < source->fileCount; i++)
+        free(source->files[i]);
+    free(source->files);
+    source->files = NULL;
+    source->fileCount = 0;
+    source->nextFile = 0;
+}
+
+// Próxima unidade pela ordem canónica. *unit fica a NULL quando já não há mais.
+static int nextShardUnit(ShardSource *source, ShardUnit **unit)
+{
+    *unit = NULL;
+    while (1)
+    {
+        if (source->nextFile < source->fileCount)
+        {
+            size_t count = source->fileCount - source->nextFile;
+            if (count > SHARD_UNIT_FILES)
+                count = SHARD_UNIT_FILES;
+            if ((*unit = newShardUnit(source, SHARD_ENTRY_FILE, source->files + source->nextFile, count)) == NULL)
+                return -1;
+            source->nextFile += count;
+            return 0;
+        }
+        freeSourceFiles(source);
+
+        if (source->stackCount > 0)
+        {
+            char *path = source->stack[--source->stackCount];
+            int ret = readShardDirectory(source, path);
+            free(path);
+            if (ret != 0)
+                return -1;
+            continue;
+        }
+
+        if (source->nextTarget == source->targetCount)
+            return 0;
+
+        // Com "-r" os diretórios dados são percorridos, os restantes alvos são analisados como sem partição.
+        char *target = source->targets[source->nextTarget++];
+        struct stat targetStat;
+        if (source->flags->targetIsFolder && stat(target, &targetStat) == 0 && S_ISDIR(targetStat.st_mode))
+        {
+            char *path = malloc(strlen(target) + 1);
+            if (path == NULL || pushDirectory(source, strcpy(path, target)) != 0)
+            {
+                free(path);
+                return -1;
+            }
+            continue;
+        }
+
+        *unit = newShardUnit(source, SHARD_ENTRY_TARGET, &target, 1);
+        return (*unit == NULL) ? -1 : 0;
+    }
+}
+
+// 1 se leu tudo, 0 no fim dos dados antes do primeiro byte, -1 em erro.
+static int readFully(int fd, void *buffer, size_t length)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t count = read(fd, (char *)buffer + done, length - done);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return (count == 0 && done == 0) ? 0 : -1;
+        done += count;
+    }
+    return 1;
+}
+
+// Enviar tudo, esperando que o socket tenha espaço se não for bloqueante.
+static int sendFully(int fd, const void *buffer, size_t length)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t count = send(fd, (const char *)buffer + done, length - done, MSG_NOSIGNAL);
+        if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return -1;
+        done += count;
+    }
+    return 0;
+}
+
+// Analisar uma entrada no processo de análise, com o output escrito em stream.
+static void analyseShardEntry(Flags *flags, char *hashFunctions, FILE *stream, char type, char *path)
+{
+    struct stat fileStat;
+    if (type == SHARD_ENTRY_FILE)
+    {
+        // Como na análise do diretório: metadados seguindo as ligações, filtros e apenas ficheiros regulares
+        struct timespec start;
+        profileStart(&start);
+        int isLink = 0;
+        if (lstat(path, &fileStat) == -1)
+        {
+            perror("lstat() error");
+            return;
+        }
+        if (S_ISLNK(fileStat.st_mode))
+        {
+            isLink = 1;
+            if (stat(path, &fileStat) == -1)
+            {
+                perror("stat() error");
+                return;
+            }
+        }
+        profileEnd(PROFILE_STAT, &start);
+        if (!S_ISREG(fileStat.st_mode))
+        {
+            fprintf(stderr, "%s\nErro!\n", path);
+            return;
+        }
+        if (!filterAccepts(&flags->filter, path, &fileStat, isLink))
+            return;
+    }
+    else if (flags->timelineMode && stat(path, &fileStat) == -1)
+    {
+        fprintf(stderr, "Failed to analyse file '%s'\n", path);
+        return;
+    }
+
+    if (flags->timelineMode)
+    {
+        if (addTimelineEvents(path, &fileStat) == -1)
+            fprintf(stderr, "Failed to analyse file '%s'\n", path);
+    }
+    else if (analyseFile(flags, hashFunctions, stream, path, (type == SHARD_ENTRY_FILE) ? &fileStat : NULL, NULL) == -1)
+        fprintf(stderr, "Failed to analyse file '%s'\n", path);
+}
+
+/*
+ * Analisar as entradas de uma unidade e enviar ao coordenador o que ficou para os registos partilhados e o output,
+ * um registo por linha.
+ */
+static int analyseShardUnit(int fd, Flags *flags, char *hashFunctions, char *entries, size_t length)
+{
+    char *output = NULL;
+    size_t outputLength = 0;
+    FILE *stream = open_memstream(&output, &outputLength);
+    if (stream == NULL)
+        return -1;
+
+    for (char *entry = entries; entry < entries + length; entry += strlen(entry) + 1)
+        analyseShardEntry(flags, hashFunctions, stream, entry[0], entry + 1);
+    if (fclose(stream) != 0)
+    {
+        free(output);
+        return -1;
+    }
+
+    unsigned char *logs[SHARD_LOGS];
+    size_t logLength[SHARD_LOGS] = {0};
+    logs[SHARD_LOG(SHARD_FRAME_TIMELINE)] = takeTimelineEvents(&logLength[SHARD_LOG(SHARD_FRAME_TIMELINE)]);
+    logs[SHARD_LOG(SHARD_FRAME_INDEX)] = takeManifestRecords(&logLength[SHARD_LOG(SHARD_FRAME_INDEX)]);
+    logs[SHARD_LOG(SHARD_FRAME_PROFILE)] = takeProfile(&logLength[SHARD_LOG(SHARD_FRAME_PROFILE)]);
+    size_t logsLength = 0;
+    for (int i = 0; i < SHARD_LOGS; i++)
+        logsLength += (logs[i] != NULL) ? sizeof(ShardFrame) + logLength[i] : 0;
+
+    // Registos: cabeçalho e linha sem o '\n', terminados pela mensagem de fim da unidade
+    size_t lines = 0;
+    for (size_t i = 0; i < outputLength; i++)
+        lines += (output[i] == '\n');
+    char *frames = malloc(logsLength + outputLength + (lines + 1) * sizeof(ShardFrame));
+    if (frames == NULL)
+    {
+        for (int i = 0; i < SHARD_LOGS; i++)
+            free(logs[i]);
+        free(output);
+        return -1;
+    }
+
+    size_t framesLength = 0;
+    for (int i = 0; i < SHARD_LOGS; i++)
+        if (logs[i] != NULL)
+        {
+            ShardFrame frame = {SHARD_FRAME_TIMELINE + i, logLength[i]};
+            memcpy(frames + framesLength, &frame, sizeof(frame));
+            memcpy(frames + framesLength + sizeof(frame), logs[i], logLength[i]);
+            framesLength += sizeof(frame) + logLength[i];
+            free(logs[i]);
+        }
+    for (char *line = output, *end; line < output + outputLength; line = end + 1)
+    {
+        if ((end = memchr(line, '\n', output + outputLength - line)) == NULL)
+            end = output + outputLength;
+        ShardFrame frame = {SHARD_FRAME_RECORD, end - line};
+        memcpy(frames + framesLength, &frame, sizeof(frame));
+        memcpy(frames + framesLength + sizeof(frame), line, frame.length);
+        framesLength += sizeof(frame) + frame.length;
+    }
+    ShardFrame done = {SHARD_FRAME_DONE, 0};
+    memcpy(frames + framesLength, &done, sizeof(done));
+    framesLength += sizeof(done);
+
+    int ret = sendFully(fd, frames, framesLength);
+    free(frames);
+    free(output);
+    return ret;
+}
+
+// Ciclo de um processo de análise: até o coordenador fechar o socket, analisar as unidades que recebe.
+static void runShardWorker(int fd, Flags *flags, char *hashFunctions)
+{
+    int status = EXIT_SUCCESS;
+    char *entries = NULL;
+    forkProfile();
+    captureTimelineEvents();
+    captureManifestRecords();
+
+    // Os registos só chegam ao coordenador pelo socket. As mensagens de erro (também as escritas com printf() durante
+    // a análise) vão para o stderr, senão seriam escritas no meio dos registos que o coordenador escreve no stdout.
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    ShardFrame frame;
+    int ret;
+    while ((ret = readFully(fd, &frame, sizeof(frame))) == 1)
+    {
+        char *buffer = (frame.type == SHARD_FRAME_UNIT) ? realloc(entries, frame.length) : NULL;
+        if (buffer == NULL || readFully(fd, buffer, frame.length) != 1 ||
+            analyseShardUnit(fd, flags, hashFunctions, buffer, frame.length) != 0)
+        {
+            free(buffer);
+            entries = NULL;
+            status = EXIT_FAILURE;
+            break;
+        }
+        entries = buffer;
+    }
+    if (ret == -1)
+        status = EXIT_FAILURE;
+    free(entries);
+    if (closeProfile() != 0)
+        status = EXIT_FAILURE;
+
+    // Sem exit(): os buffers herdados do coordenador (output, stdout) não podem ser escritos outra vez
+    fflush(stdout);
+    _exit(status);
+}
+
+static int startShardWorker(ShardWorker *workers, unsigned int count, unsigned int index, Flags *flags, char *hashFunctions)
+{
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1)
+    {
+        perror("socketpair() error");
+        return -1;
+    }
+
+    // O que está no buffer do stdout seria escrito também pelo processo de análise
+    fflush(stdout);
+
+    pid_t pid;
+    if ((pid = fork()) < 0)
+    {
+        perror("fork() error");
+        close(sockets[0]);
+        close(sockets[1]);
+        return -1;
+    }
+    else if (pid == 0)
+    {
+        close(sockets[0]);
+        for (unsigned int i = 0; i < count; i++)
+            if (workers[i].fd != -1)
+                close(workers[i].fd);
+        runShardWorker(sockets[1], flags, hashFunctions);
+    }
+
+    close(sockets[1]);
+    fcntl(sockets[0], F_SETFL, O_NONBLOCK);
+    workers[index].pid = pid;
+    workers[index].fd = sockets[0];
+    workers[index].unit = NULL;
+    workers[index].inputLength = 0;
+    return 0;
+}
+
+static int sendShardUnit(ShardWorker *worker, ShardUnit *unit)
+{
+    ShardFrame frame = {SHARD_FRAME_UNIT, unit->length};
+    if (sendFully(worker->fd, &frame, sizeof(frame)) != 0 || sendFully(worker->fd, unit->entries, unit->length) != 0)
+        return -1;
+    worker->unit = unit;
+    return 0;
+}
+
+static int appendOutput(ShardUnit *unit, const unsigned char *line, size_t length)
+{
+    if (unit->outputLength + length + 1 > unit->outputCapacity)
+    {
+        size_t capacity = (unit->outputCapacity == 0) ? 4096 : unit->outputCapacity;
+        while (capacity < unit->outputLength + length + 1)
+            capacity *= 2;
+        char *output = realloc(unit->output, capacity);
+        if (output == NULL)
+            return -1;
+        unit->output = output;
+        unit->outputCapacity = capacity;
+    }
+    memcpy(unit->output + unit->outputLength, line, length);
+    unit->output[unit->outputLength + length] = '\n';
+    unit->outputLength += length + 1;
+    return 0;
+}
+
+static int appendLog(ShardUnit *unit, unsigned int type, const unsigned char *data, size_t length)
+{
+    size_t index = SHARD_LOG(type);
+    if (length == 0)
+        return 0;
+    unsigned char *log = realloc(unit->logs[index], unit->logLength[index] + length);
+    if (log == NULL)
+        return -1;
+    memcpy(log + unit->logLength[index], data, length);
+    unit->logs[index] = log;
+    unit->logLength[index] += length;
+    return 0;
+}
+
+static void discardLogs(ShardUnit *unit)
+{
+    for (int i = 0; i < SHARD_LOGS; i++)
+    {
+        free(unit->logs[i]);
+        unit->logs[i] = NULL;
+        unit->logLength[i] = 0;
+    }
+}
+
+// A unidade terminou: o que ela deixou para os registos partilhados é escrito, uma só vez.
+static int commitLogs(ShardUnit *unit)
+{
+    int ret = 0;
+    unsigned char **logs = unit->logs;
+    size_t *length = unit->logLength;
+    if (logs[SHARD_LOG(SHARD_FRAME_TIMELINE)] != NULL &&
+        writeTimelineEvents(logs[SHARD_LOG(SHARD_FRAME_TIMELINE)], length[SHARD_LOG(SHARD_FRAME_TIMELINE)]) != 0)
+        ret = -1;
+    if (logs[SHARD_LOG(SHARD_FRAME_INDEX)] != NULL &&
+        writeManifestRecords(logs[SHARD_LOG(SHARD_FRAME_INDEX)], length[SHARD_LOG(SHARD_FRAME_INDEX)]) != 0)
+        ret = -1;
+    if (logs[SHARD_LOG(SHARD_FRAME_PROFILE)] != NULL &&
+        addProfile(logs[SHARD_LOG(SHARD_FRAME_PROFILE)], length[SHARD_LOG(SHARD_FRAME_PROFILE)]) != 0)
+        ret = -1;
+    discardLogs(unit);
+    return ret;
+}
+
+// Ler o que o processo enviou e juntar os registos completos à sua unidade. -1 se terminou ou enviou lixo.
+static int readShardWorker(ShardWorker *worker)
+{
+    int closed = 0;
+    while (!closed)
+    {
+        if (worker->inputCapacity - worker->inputLength < 4096)
+        {
+            size_t capacity = (worker->inputCapacity == 0) ? 65536 : worker->inputCapacity * 2;
+            unsigned char *input = realloc(worker->input, capacity);
+            if (input == NULL)
+                return -1;
+            worker->input = input;
+            worker->inputCapacity = capacity;
+        }
+
+        ssize_t count = read(worker->fd, worker->input + worker->inputLength, worker->inputCapacity - worker->inputLength);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (count <= 0)
+            closed = 1;
+        else
+            worker->inputLength += count;
+    }
+
+    size_t offset = 0;
+    ShardFrame frame;
+    while (worker->inputLength - offset >= sizeof(frame))
+    {
+        memcpy(&frame, worker->input + offset, sizeof(frame));
+        if (worker->inputLength - offset - sizeof(frame) < frame.length)
+            break;
+
+        // Só são esperados registos da unidade que o processo está a analisar
+        const unsigned char *data = worker->input + offset + sizeof(frame);
+        if (worker->unit == NULL || frame.type < SHARD_FRAME_RECORD || frame.type >= SHARD_FRAME_TIMELINE + SHARD_LOGS)
+            return -1;
+        if (frame.type == SHARD_FRAME_RECORD && appendOutput(worker->unit, data, frame.length) != 0)
+            return -1;
+        if (frame.type >= SHARD_FRAME_TIMELINE && appendLog(worker->unit, frame.type, data, frame.length) != 0)
+            return -1;
+        if (frame.type == SHARD_FRAME_DONE)
+        {
+            if (commitLogs(worker->unit) != 0)
+                printf("Failed to write the shared logs of '%s'\n", worker->unit->entries + 1);
+            worker->unit->done = 1;
+            worker->unit = NULL;
+        }
+        offset += sizeof(frame) + frame.length;
+    }
+
+    memmove(worker->input, worker->input + offset, worker->inputLength - offset);
+    worker->inputLength -= offset;
+    return closed ? -1 : 0;
+}
+
+/*
+ * O processo terminou (ou deixou de respeitar o protocolo): apenas a unidade que estava a analisar é repetida,
+ * num processo novo. O output parcial e o que ia para os registos partilhados (linha temporal, índice, medições)
+ * são descartados, por isso não há linhas nem registos repetidos ou em falta.
+ */
+static int restartShardWorker(ShardWorker *workers, unsigned int count, unsigned int index, Flags *flags, char *hashFunctions,
+                              ShardUnit **retry, size_t *retryCount)
+{
+    ShardWorker *worker = &workers[index];
+    kill(worker->pid, SIGKILL);
+    waitpid(worker->pid, NULL, 0);
+    close(worker->fd);
+    worker->fd = -1;
+
+    ShardUnit *unit = worker->unit;
+    worker->unit = NULL;
+    if (unit != NULL)
+    {
+        unit->outputLength = 0;
+        discardLogs(unit);
+        if (++unit->attempts < SHARD_MAX_ATTEMPTS)
+        {
+            printf("Analysis process %d stopped, analysing its files again\n", (int)worker->pid);
+            retry[(*retryCount)++] = unit;
+        }
+        else
+        {
+            printf("Failed to analyse '%s' (analysis process stopped)\n", unit->entries + 1);
+            unit->done = 1;
+        }
+    }
+
+    return startShardWorker(workers, count, index, flags, hashFunctions);
+}
+
+/*
+ * Com "--shards N" a análise é feita por N processos de análise, ligados ao coordenador (o processo inicial) por
+ * socketpairs. O coordenador percorre os alvos e divide-os em unidades (até SHARD_UNIT_FILES ficheiros de um
+ * diretório), numeradas pela ordem canónica, e dá uma unidade de cada vez a cada processo livre. Cada processo
+ * devolve os registos binários das suas unidades pela ordem em que as recebeu, e o coordenador junta os N
+ * fluxos pelo número da unidade: o output é o mesmo seja qual for N e a rapidez de cada processo.
+ */
+int runShards(Flags *flags, char *hashFunctions, FILE *outputFile, char *targets[], int targetCount)
+{
+    unsigned int count = flags->shards;
+    size_t windowSize = (size_t)count * SHARD_WINDOW_PER_WORKER;
+    ShardWorker *workers = calloc(count, sizeof(ShardWorker));
+    ShardUnit **window = calloc(windowSize, sizeof(ShardUnit *));
+    ShardUnit **retry = malloc(count * sizeof(ShardUnit *));
+    struct pollfd *fds = malloc(count * sizeof(struct pollfd));
+    if (workers == NULL || window == NULL || retry == NULL || fds == NULL)
+    {
+        free(workers);
+        free(window);
+        free(retry);
+        free(fds);
+        return -1;
+    }
+
+    ShardSource source = {flags, targets, targetCount, 0, NULL, 0, 0, NULL, 0, 0, 0};
+    size_t retryCount = 0;
+    uint64_t writeSeq = 0;
+    int exhausted = 0;
+    int ret = 0;
+
+    for (unsigned int i = 0; i < count; i++)
+        workers[i].fd = -1;
+    for (unsigned int i = 0; i < count && ret == 0; i++)
+        ret = startShardWorker(workers, count, i, flags, hashFunctions);
+
+    while (ret == 0)
+    {
+        // Dar uma unidade a cada processo livre: primeiro as a repetir, depois as seguintes dentro da janela
+        for (unsigned int i = 0; i < count && ret == 0; i++)
+        {
+            if (workers[i].fd == -1 || workers[i].unit != NULL)
+                continue;
+
+            ShardUnit *unit = NULL;
+            if (retryCount > 0)
+                unit = retry[--retryCount];
+            else if (!exhausted && source.nextSeq < writeSeq + windowSize)
+            {
+                if (nextShardUnit(&source, &unit) != 0)
+                    ret = -1;
+                else if (unit == NULL)
+                    exhausted = 1;
+                else
+                    window[unit->seq % windowSize] = unit;
+            }
+            if (unit == NULL)
+                break;
+
+            if (sendShardUnit(&workers[i], unit) != 0)
+            {
+                workers[i].unit = unit;
+                ret = restartShardWorker(workers, count, i, flags, hashFunctions, retry, &retryCount);
+            }
+        }
+
+        nfds_t pending = 0;
+        for (unsigned int i = 0; i < count; i++)
+            if (workers[i].unit != NULL)
+            {
+                fds[pending].fd = workers[i].fd;
+                fds[pending].events = POLLIN;
+                fds[pending].revents = 0;
+                pending++;
+            }
+        if (ret != 0 || (pending == 0 && retryCount == 0))
+            break;
+
+        if (pending > 0 && poll(fds, pending, -1) == -1 && errno != EINTR)
+        {
+            perror("poll() error");
+            ret = -1;
+            break;
+        }
+
+        for (unsigned int i = 0; i < count && ret == 0; i++)
+        {
+            if (workers[i].unit == NULL)
+                continue;
+            for (nfds_t j = 0; j < pending; j++)
+                if (fds[j].fd == workers[i].fd && fds[j].revents != 0 && readShardWorker(&workers[i]) != 0)
+                    ret = restartShardWorker(workers, count, i, flags, hashFunctions, retry, &retryCount);
+        }
+
+        // Com "--unordered" o output das unidades é escrito logo que terminam, a janela continua a limitar a distribuição
+        if (flags->unorderedOutput)
+            for (size_t i = 0; i < windowSize; i++)
+                if (window[i] != NULL && window[i]->done && window[i]->outputLength > 0)
+                {
+                    fwrite(window[i]->output, 1, window[i]->outputLength, outputFile ? outputFile : stdout);
+                    window[i]->outputLength = 0;
+                }
+
+        // Escrever as unidades terminadas, pela ordem, até à primeira que ainda não terminou
+        ShardUnit *unit;
+        while ((unit = window[writeSeq % windowSize]) != NULL && unit->done)
+        {
+            if (unit->outputLength > 0) // Com "--timeline" as unidades não têm output
+                fwrite(unit->output, 1, unit->outputLength, outputFile ? outputFile : stdout);
+            window[writeSeq % windowSize] = NULL;
+            writeSeq++;
+            free(unit->entries);
+            free(unit->output);
+            free(unit);
+        }
+    }
+
+    // Fechar os sockets: os processos de análise veem o fim dos dados e terminam
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (workers[i].fd == -1)
+            continue;
+        close(workers[i].fd);
+        waitpid(workers[i].pid, NULL, 0);
+        free(workers[i].input);
+    }
+    for (size_t i = 0; i < windowSize; i++)
+        if (window[i] != NULL)
+        {
+            discardLogs(window[i]);
+            free(window[i]->entries);
+            free(window[i]->output);
+            free(window[i]);
+        }
+    while (source.stackCount > 0)
+        free(source.stack[--source.stackCount]);
+    free(source.stack);
+    freeSourceFiles(&source);
+    free(workers);
+    free(window);
+    free(retry);
+    free(fds);
+
+    return ret;
+}
\ No newline at end of file
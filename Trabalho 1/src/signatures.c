@@ -0,0 +1,583 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "signatures.h"
+
+// Marca nas transições que chegam a um estado com regras encontradas
+#define SIGNATURE_MATCH 0x80000000u
+#define SIGNATURE_NONE 0xffffffffu
+
+// Variável de ambiente com o descritor do autómato construído pelo processo inicial
+#define SIGNATURES_FD_ENV "FORENSIC_SIGNATURES_FD"
+
+typedef struct
+{
+    uint32_t rule;
+    uint32_t next;
+} SignatureOutput;
+
+struct Signatures
+{
+    char **ruleIds;
+    size_t ruleCount;
+
+    // Os bytes que não aparecem em nenhuma assinatura partilham a mesma coluna da tabela
+    unsigned char classOf[256];
+    size_t classCount;
+
+    // Transições [estado * classCount + classe], guardadas já como início da linha do estado de destino
+    uint32_t *next;
+    size_t stateCount;
+
+    uint32_t *outputHead; // Regras que terminam em cada estado
+    uint32_t *outputLink; // Estado seguinte com regras na cadeia de falhas
+    SignatureOutput *outputs;
+    size_t outputCount;
+
+    // Tabelas e ids no ficheiro partilhado pelo processo inicial, não são libertados
+    void *shared;
+    size_t sharedSize;
+};
+
+// Ids das regras -> índice, durante a leitura (endereçamento aberto, -1 nos lugares livres)
+typedef struct
+{
+    int *slots;
+    size_t capacity;
+} RuleIndex;
+
+/*
+ * Ficheiro partilhado: cabeçalho com os tamanhos, classOf, transições, outputHead, outputLink, outputs e os ids
+ * das regras, terminados por '\0', pela ordem das regras.
+ */
+typedef struct
+{
+    uint64_t ruleCount;
+    uint64_t classCount;
+    uint64_t stateCount;
+    uint64_t outputCount;
+    uint64_t idsLength;
+} SharedHeader;
+
+typedef struct
+{
+    unsigned char *bytes;
+    size_t length;
+    uint32_t rule;
+} Pattern;
+
+/*
+ * Leitura do ficheiro de assinaturas, uma por linha: "id texto" ou "id hex:4d5a90".
+ * Linhas vazias ou começadas por '#' são ignoradas. Várias linhas podem ter o mesmo id.
+ */
+static int parsePattern(const char *text, Pattern *pattern)
+{
+    if (strncmp(text, "hex:", strlen("hex:")) == 0)
+    {
+        text += strlen("hex:");
+        size_t length = strlen(text);
+        if (length == 0 || length % 2 != 0)
+            return -1;
+        if ((pattern->bytes = malloc(length / 2)) == NULL)
+            return -1;
+        for (size_t i = 0; i < length / 2; i++)
+        {
+            // O sscanf() aceitaria "+f" ou " f", e um só dígito seguido de outro carácter
+            unsigned int byte;
+            if (!isxdigit((unsigned char)text[i * 2]) || !isxdigit((unsigned char)text[i * 2 + 1]) ||
+                sscanf(text + i * 2, "%2x", &byte) != 1)
+            {
+                free(pattern->bytes);
+                return -1;
+            }
+            pattern->bytes[i] = byte;
+        }
+        pattern->length = length / 2;
+    }
+    else
+    {
+        pattern->length = strlen(text);
+        if (pattern->length == 0 || (pattern->bytes = malloc(pattern->length)) == NULL)
+            return -1;
+        memcpy(pattern->bytes, text, pattern->length);
+    }
+    return 0;
+}
+
+static size_t hashId(const char *id)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *c = (const unsigned char *)id; *c != '\0'; c++)
+        hash = (hash ^ *c) * 1099511628211ULL;
+    return (size_t)hash;
+}
+
+static int *findSlot(const Signatures *signatures, const RuleIndex *index, const char *id)
+{
+    size_t slot = hashId(id) & (index->capacity - 1);
+    while (index->slots[slot] != -1 && strcmp(signatures->ruleIds[index->slots[slot]], id) != 0)
+        slot = (slot + 1) & (index->capacity - 1);
+    return &index->slots[slot];
+}
+
+static int growIndex(const Signatures *signatures, RuleIndex *index)
+{
+    RuleIndex grown = {NULL, (index->capacity == 0) ? 64 : index->capacity * 2};
+    if ((grown.slots = malloc(grown.capacity * sizeof(int))) == NULL)
+        return -1;
+    memset(grown.slots, 0xff, grown.capacity * sizeof(int));
+    for (size_t rule = 0; rule < signatures->ruleCount; rule++)
+        *findSlot(signatures, &grown, signatures->ruleIds[rule]) = rule;
+
+    free(index->slots);
+    *index = grown;
+    return 0;
+}
+
+// Índice da regra com este id, acrescentada se ainda não existir.
+static int findRule(Signatures *signatures, RuleIndex *index, const char *id)
+{
+    // Manter a ocupação abaixo de 70%
+    if ((signatures->ruleCount + 1) * 10 > index->capacity * 7 && growIndex(signatures, index) != 0)
+        return -1;
+
+    int *slot = findSlot(signatures, index, id);
+    if (*slot != -1)
+        return *slot;
+
+    char **ruleIds = realloc(signatures->ruleIds, (signatures->ruleCount + 1) * sizeof(char *));
+    if (ruleIds == NULL)
+        return -1;
+    signatures->ruleIds = ruleIds;
+    if ((ruleIds[signatures->ruleCount] = malloc(strlen(id) + 1)) == NULL)
+        return -1;
+    strcpy(ruleIds[signatures->ruleCount], id);
+    *slot = signatures->ruleCount;
+    return signatures->ruleCount++;
+}
+
+static int readPatterns(Signatures *signatures, const char *path, Pattern **patterns, size_t *count)
+{
+    RuleIndex index = {NULL, 0};
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror("fopen() error");
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t lineCapacity = 0, capacity = 0;
+    int ret = 0;
+    for (size_t lineNumber = 1; ret == 0 && getline(&line, &lineCapacity, file) != -1; lineNumber++)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        char *separator = line + strcspn(line, " \t");
+        if (*separator == '\0')
+        {
+            printf("Assinatura sem padrão na linha %zu de '%s'!\n", lineNumber, path);
+            ret = -1;
+            break;
+        }
+        *separator = '\0';
+
+        if (*count == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            Pattern *grown = realloc(*patterns, capacity * sizeof(Pattern));
+            if (grown == NULL)
+            {
+                ret = -1;
+                break;
+            }
+            *patterns = grown;
+        }
+
+        int rule = findRule(signatures, &index, line);
+        if (rule == -1 || parsePattern(separator + 1, &(*patterns)[*count]) != 0)
+        {
+            printf("Assinatura inválida na linha %zu de '%s'!\n", lineNumber, path);
+            ret = -1;
+            break;
+        }
+        (*patterns)[(*count)++].rule = rule;
+    }
+
+    free(index.slots);
+    free(line);
+    fclose(file);
+    if (ret == 0 && *count == 0)
+    {
+        printf("Nenhuma assinatura em '%s'!\n", path);
+        ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * Construção do autómato
+ */
+
+static int addState(Signatures *signatures, size_t *capacity)
+{
+    if (signatures->stateCount == *capacity)
+    {
+        size_t grown = *capacity * 2;
+        if (grown * signatures->classCount >= SIGNATURE_MATCH)
+            return -1;
+
+        uint32_t *next = realloc(signatures->next, grown * signatures->classCount * sizeof(uint32_t));
+        if (next != NULL)
+            signatures->next = next;
+        uint32_t *outputHead = realloc(signatures->outputHead, grown * sizeof(uint32_t));
+        if (outputHead != NULL)
+            signatures->outputHead = outputHead;
+        if (next == NULL || outputHead == NULL)
+            return -1;
+        *capacity = grown;
+    }
+
+    memset(signatures->next + signatures->stateCount * signatures->classCount, 0, signatures->classCount * sizeof(uint32_t));
+    signatures->outputHead[signatures->stateCount] = SIGNATURE_NONE;
+    return signatures->stateCount++;
+}
+
+static int addOutput(Signatures *signatures, uint32_t state, uint32_t rule)
+{
+    for (uint32_t o = signatures->outputHead[state]; o != SIGNATURE_NONE; o = signatures->outputs[o].next)
+        if (signatures->outputs[o].rule == rule)
+            return 0;
+
+    SignatureOutput *outputs = realloc(signatures->outputs, (signatures->outputCount + 1) * sizeof(SignatureOutput));
+    if (outputs == NULL)
+        return -1;
+    signatures->outputs = outputs;
+    outputs[signatures->outputCount].rule = rule;
+    outputs[signatures->outputCount].next = signatures->outputHead[state];
+    signatures->outputHead[state] = signatures->outputCount++;
+    return 0;
+}
+
+// Completar a trie com as ligações de falha, em largura, até cada estado ter transição para todas as classes.
+static int linkStates(Signatures *signatures)
+{
+    size_t classes = signatures->classCount;
+    uint32_t *next = signatures->next;
+    uint32_t *fail = calloc(signatures->stateCount, sizeof(uint32_t));
+    uint32_t *queue = malloc(signatures->stateCount * sizeof(uint32_t));
+    signatures->outputLink = malloc(signatures->stateCount * sizeof(uint32_t));
+    if (fail == NULL || queue == NULL || signatures->outputLink == NULL)
+    {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    size_t head = 0, tail = 0;
+    signatures->outputLink[0] = SIGNATURE_NONE;
+    queue[tail++] = 0;
+    while (head < tail)
+    {
+        uint32_t state = queue[head++];
+        for (size_t c = 0; c < classes; c++)
+        {
+            uint32_t child = next[state * classes + c];
+            if (child == 0) // Sem filho na trie: seguir a transição do estado de falha (já completo)
+            {
+                next[state * classes + c] = (state == 0) ? 0 : next[fail[state] * classes + c];
+                continue;
+            }
+
+            fail[child] = (state == 0) ? 0 : next[fail[state] * classes + c];
+            signatures->outputLink[child] = (signatures->outputHead[fail[child]] != SIGNATURE_NONE) ? fail[child] : signatures->outputLink[fail[child]];
+            queue[tail++] = child;
+        }
+    }
+
+    // Guardar o início da linha do destino e marcar os estados onde alguma regra termina
+    for (size_t i = 0; i < signatures->stateCount * classes; i++)
+    {
+        uint32_t target = next[i];
+        int matches = signatures->outputHead[target] != SIGNATURE_NONE || signatures->outputLink[target] != SIGNATURE_NONE;
+        next[i] = target * classes | (matches ? SIGNATURE_MATCH : 0);
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+static int buildAutomaton(Signatures *signatures, const Pattern *patterns, size_t count)
+{
+    // Classes de bytes: a 0 para os bytes que não aparecem em nenhuma assinatura (se existirem)
+    unsigned char used[256] = {0};
+    size_t usedCount = 0;
+    for (size_t i = 0; i < count; i++)
+        for (size_t b = 0; b < patterns[i].length; b++)
+            if (!used[patterns[i].bytes[b]])
+            {
+                used[patterns[i].bytes[b]] = 1;
+                usedCount++;
+            }
+
+    signatures->classCount = (usedCount == 256) ? 256 : usedCount + 1;
+    for (int byte = 0, nextClass = (usedCount == 256) ? 0 : 1; byte < 256; byte++)
+        signatures->classOf[byte] = used[byte] ? nextClass++ : 0;
+
+    size_t capacity = 64;
+    signatures->next = malloc(capacity * signatures->classCount * sizeof(uint32_t));
+    signatures->outputHead = malloc(capacity * sizeof(uint32_t));
+    if (signatures->next == NULL || signatures->outputHead == NULL || addState(signatures, &capacity) != 0)
+        return -1;
+
+    // Trie com todas as assinaturas
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t state = 0;
+        for (size_t b = 0; b < patterns[i].length; b++)
+        {
+            uint32_t *transition = &signatures->next[state * signatures->classCount + signatures->classOf[patterns[i].bytes[b]]];
+            if (*transition == 0)
+            {
+                int child = addState(signatures, &capacity);
+                if (child == -1)
+                {
+                    printf("Demasiadas assinaturas!\n");
+                    return -1;
+                }
+                // A tabela pode ter mudado de sítio
+                transition = &signatures->next[state * signatures->classCount + signatures->classOf[patterns[i].bytes[b]]];
+                *transition = child;
+            }
+            state = *transition;
+        }
+        if (addOutput(signatures, state, patterns[i].rule) != 0)
+            return -1;
+    }
+
+    return linkStates(signatures);
+}
+
+/*
+ * Partilha com os processos filhos
+ */
+
+// Escrever o autómato num ficheiro já apagado, herdado pelos processos filhos como os DFA dos filtros.
+static void shareSignatures(const Signatures *signatures)
+{
+    SharedHeader header = {signatures->ruleCount, signatures->classCount, signatures->stateCount, signatures->outputCount, 0};
+    for (size_t rule = 0; rule < signatures->ruleCount; rule++)
+        header.idsLength += strlen(signatures->ruleIds[rule]) + 1;
+
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL)
+        tmp = "/tmp";
+    char path[strlen(tmp) + strlen("/forensic-signatures-XXXXXX") + 1];
+    sprintf(path, "%s/forensic-signatures-XXXXXX", tmp);
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return; // Os filhos constroem o autómato de novo
+    unlink(path);
+
+    size_t states = signatures->stateCount;
+    FILE *file = fdopen(dup(fd), "w");
+    int ok = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(signatures->classOf, sizeof(signatures->classOf), 1, file) == 1 &&
+             fwrite(signatures->next, sizeof(uint32_t), states * signatures->classCount, file) == states * signatures->classCount &&
+             fwrite(signatures->outputHead, sizeof(uint32_t), states, file) == states &&
+             fwrite(signatures->outputLink, sizeof(uint32_t), states, file) == states &&
+             fwrite(signatures->outputs, sizeof(SignatureOutput), signatures->outputCount, file) == signatures->outputCount;
+    for (size_t rule = 0; rule < signatures->ruleCount && ok; rule++)
+        ok = fwrite(signatures->ruleIds[rule], 1, strlen(signatures->ruleIds[rule]) + 1, file) == strlen(signatures->ruleIds[rule]) + 1;
+    if (file != NULL && fclose(file) != 0)
+        ok = 0;
+
+    if (!ok)
+    {
+        close(fd);
+        return;
+    }
+    char fdString[16];
+    sprintf(fdString, "%d", fd);
+    setenv(SIGNATURES_FD_ENV, fdString, 1);
+}
+
+// Usar o autómato do processo inicial em vez de ler e construir as mesmas assinaturas em cada processo.
+static int attachSignatures(Signatures *signatures, const char *fdString)
+{
+    int fd = atoi(fdString);
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(SharedHeader) + 256)
+        return -1;
+    void *base = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    SharedHeader header;
+    memcpy(&header, base, sizeof(header));
+    unsigned char *next = (unsigned char *)base + sizeof(header) + 256;
+    size_t remaining = fileStat.st_size - sizeof(header) - 256;
+    int valid = header.ruleCount > 0 && header.classCount > 0 && header.classCount <= 256 && header.stateCount > 0 &&
+                header.stateCount * header.classCount < SIGNATURE_MATCH &&
+                remaining == header.stateCount * (header.classCount + 2) * sizeof(uint32_t) +
+                                 header.outputCount * sizeof(SignatureOutput) + header.idsLength;
+    const char *ids = valid ? (const char *)next + remaining - header.idsLength : NULL;
+    size_t idCount = 0;
+    for (size_t i = 0; valid && i < header.idsLength; i++)
+        idCount += (ids[i] == '\0');
+    if (!valid || idCount != header.ruleCount || ids[header.idsLength - 1] != '\0' ||
+        (signatures->ruleIds = malloc(header.ruleCount * sizeof(char *))) == NULL)
+    {
+        munmap(base, fileStat.st_size);
+        return -1;
+    }
+
+    memcpy(signatures->classOf, (unsigned char *)base + sizeof(header), 256);
+    signatures->classCount = header.classCount;
+    signatures->stateCount = header.stateCount;
+    signatures->outputCount = header.outputCount;
+    signatures->next = (uint32_t *)next;
+    signatures->outputHead = signatures->next + header.stateCount * header.classCount;
+    signatures->outputLink = signatures->outputHead + header.stateCount;
+    signatures->outputs = (SignatureOutput *)(signatures->outputLink + header.stateCount);
+    for (const char *id = ids; signatures->ruleCount < header.ruleCount; id += strlen(id) + 1)
+        signatures->ruleIds[signatures->ruleCount++] = (char *)id;
+
+    signatures->shared = base;
+    signatures->sharedSize = fileStat.st_size;
+    return 0;
+}
+
+// O autómato é construído pelo processo inicial; os processos filhos (um por sub-diretório) mapeiam o resultado.
+Signatures *loadSignatures(const char *path)
+{
+    Signatures *signatures = calloc(1, sizeof(Signatures));
+    if (signatures == NULL)
+        return NULL;
+
+    char *existing = getenv(SIGNATURES_FD_ENV);
+    if (existing != NULL && attachSignatures(signatures, existing) == 0)
+        return signatures;
+
+    Pattern *patterns = NULL;
+    size_t count = 0;
+    int ret = readPatterns(signatures, path, &patterns, &count);
+    if (ret == 0)
+        ret = buildAutomaton(signatures, patterns, count);
+
+    for (size_t i = 0; i < count; i++)
+        free(patterns[i].bytes);
+    free(patterns);
+
+    if (ret != 0)
+    {
+        freeSignatures(signatures);
+        return NULL;
+    }
+    if (existing == NULL)
+        shareSignatures(signatures);
+    return signatures;
+}
+
+void freeSignatures(Signatures *signatures)
+{
+    if (signatures == NULL)
+        return;
+    if (signatures->shared != NULL)
+    {
+        munmap(signatures->shared, signatures->sharedSize);
+        free(signatures->ruleIds);
+        free(signatures);
+        return;
+    }
+    for (size_t i = 0; i < signatures->ruleCount; i++)
+        free(signatures->ruleIds[i]);
+    free(signatures->ruleIds);
+    free(signatures->next);
+    free(signatures->outputHead);
+    free(signatures->outputLink);
+    free(signatures->outputs);
+    free(signatures);
+}
+
+/*
+ * Pesquisa
+ */
+
+int initSignatureScan(SignatureScan *scan, const Signatures *signatures)
+{
+    scan->signatures = signatures;
+    scan->state = 0;
+    scan->matchCount = 0;
+    scan->matched = calloc((signatures->ruleCount + 7) / 8, 1);
+    return (scan->matched == NULL) ? -1 : 0;
+}
+
+static void markMatches(SignatureScan *scan, uint32_t state)
+{
+    const Signatures *signatures = scan->signatures;
+    for (; state != SIGNATURE_NONE; state = signatures->outputLink[state])
+        for (uint32_t o = signatures->outputHead[state]; o != SIGNATURE_NONE; o = signatures->outputs[o].next)
+        {
+            uint32_t rule = signatures->outputs[o].rule;
+            if (!(scan->matched[rule / 8] & (1 << (rule % 8))))
+            {
+                scan->matched[rule / 8] |= 1 << (rule % 8);
+                scan->matchCount++;
+            }
+        }
+}
+
+// Consumidor da leitura do ficheiro: uma consulta à tabela por byte, o estado continua entre blocos.
+void consumeSignatureScan(void *context, const unsigned char *data, size_t length)
+{
+    SignatureScan *scan = context;
+    const uint32_t *next = scan->signatures->next;
+    const unsigned char *classOf = scan->signatures->classOf;
+    uint32_t row = scan->state;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint32_t target = next[row + classOf[data[i]]];
+        row = target & ~SIGNATURE_MATCH;
+        if (target & SIGNATURE_MATCH)
+            markMatches(scan, row / scan->signatures->classCount);
+    }
+
+    scan->state = row;
+}
+
+// Ids das regras encontradas, separados por ';' pela ordem do ficheiro de assinaturas
+char *signatureMatches(const SignatureScan *scan)
+{
+    size_t length = 1;
+    for (size_t rule = 0; rule < scan->signatures->ruleCount; rule++)
+        if (scan->matched[rule / 8] & (1 << (rule % 8)))
+            length += strlen(scan->signatures->ruleIds[rule]) + 1;
+
+    char *matches = malloc(length);
+    if (matches == NULL)
+        return NULL;
+    matches[0] = '\0';
+    for (size_t rule = 0; rule < scan->signatures->ruleCount; rule++)
+        if (scan->matched[rule / 8] & (1 << (rule % 8)))
+        {
+            if (matches[0] != '\0')
+                strcat(matches, ";");
+            strcat(matches, scan->signatures->ruleIds[rule]);
+        }
+    return matches;
+}
+
+void freeSignatureScan(SignatureScan *scan)
+{
+    free(scan->matched);
+    scan->matched = NULL;
+}
\ No newline at end of file
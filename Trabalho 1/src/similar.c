@@ -0,0 +1,247 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "ctph.h"
+#include "similar.h"
+
+// Ficheiro de um output com sumário "ctph"
+typedef struct
+{
+    char *path;
+    CtphDigest digest;
+} SimilarEntry;
+
+typedef struct
+{
+    SimilarEntry *entries;
+    size_t count;
+    size_t capacity;
+} SimilarList;
+
+// Chave (tamanho de pedaço e 7 caracteres de uma parte) de um ficheiro de referência
+typedef struct
+{
+    uint64_t key;
+    uint32_t entry;
+} SimilarPosting;
+
+typedef struct
+{
+    SimilarPosting *postings;
+    size_t count;
+    size_t capacity;
+} SimilarIndex;
+
+static void freeList(SimilarList *list)
+{
+    for (size_t i = 0; i < list->count; i++)
+        free(list->entries[i].path);
+    free(list->entries);
+}
+
+/*
+ * Ler um output de "forensic -h ...ctph...": o caminho é o primeiro campo e o sumário o último campo
+ * com o formato "tamanho:parte1:parte2". As linhas sem sumário (diretórios do --merkle, ...) são ignoradas.
+ */
+static int loadManifest(const char *path, SimilarList *list)
+{
+    memset(list, 0, sizeof(SimilarList));
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t lineLength;
+    int ret = 0;
+    while (ret == 0 && (lineLength = getline(&line, &lineCapacity, file)) != -1)
+    {
+        if (lineLength > 0 && line[lineLength - 1] == '\n')
+            line[--lineLength] = '\0';
+
+        char *pathEnd = strchr(line, ',');
+        if (pathEnd == NULL)
+            continue;
+
+        CtphDigest digest;
+        int found = 0;
+        for (char *fieldEnd = line + lineLength; !found && fieldEnd > pathEnd;)
+        {
+            char *field = fieldEnd;
+            while (field[-1] != ',')
+                field--;
+            found = (parseCtph(field, fieldEnd - field, &digest) == 0);
+            fieldEnd = field - 1;
+        }
+        if (!found)
+            continue;
+
+        if (list->count == list->capacity)
+        {
+            size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+            SimilarEntry *grown = realloc(list->entries, capacity * sizeof(SimilarEntry));
+            if (grown == NULL)
+            {
+                ret = -1;
+                break;
+            }
+            list->entries = grown;
+            list->capacity = capacity;
+        }
+
+        *pathEnd = '\0';
+        if ((list->entries[list->count].path = strdup(line)) == NULL)
+            ret = -1;
+        else
+            list->entries[list->count++].digest = digest;
+    }
+
+    free(line);
+    fclose(file);
+    if (ret != 0)
+        freeList(list);
+    return ret;
+}
+
+static uint64_t hashKey(unsigned char tag, uint64_t blockSize, const char *text, size_t length)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    hash = (hash ^ tag) * 1099511628211ULL;
+    for (size_t i = 0; i < 8; i++)
+        hash = (hash ^ ((blockSize >> (8 * i)) & 0xff)) * 1099511628211ULL;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+    return hash;
+}
+
+/*
+ * Dois sumários só têm pontuação acima de 0 se forem iguais, ou se tiverem uma parte com o mesmo tamanho de
+ * pedaço e 7 caracteres seguidos em comum. As chaves de um sumário são por isso o sumário inteiro e cada
+ * sequência de 7 caracteres de cada parte, junto com o tamanho de pedaço dessa parte.
+ */
+static size_t digestKeys(const CtphDigest *digest, uint64_t *keys)
+{
+    size_t count = 0;
+    keys[count++] = hashKey(0, digest->blockSize, digest->part1, digest->length1) ^
+                    hashKey(1, digest->blockSize, digest->part2, digest->length2);
+    for (size_t i = 0; i + CTPH_ROLLING_WINDOW <= digest->length1; i++)
+        keys[count++] = hashKey(2, digest->blockSize, digest->part1 + i, CTPH_ROLLING_WINDOW);
+    for (size_t i = 0; i + CTPH_ROLLING_WINDOW <= digest->length2; i++)
+        keys[count++] = hashKey(2, (uint64_t)digest->blockSize * 2, digest->part2 + i, CTPH_ROLLING_WINDOW);
+    return count;
+}
+
+// Máximo de chaves de um sumário
+#define SIMILAR_MAX_KEYS (1 + 2 * CTPH_SPAMSUM_LENGTH)
+
+static int comparePostings(const void *a, const void *b)
+{
+    uint64_t keyA = ((const SimilarPosting *)a)->key, keyB = ((const SimilarPosting *)b)->key;
+    return (keyA > keyB) - (keyA < keyB);
+}
+
+static int buildIndex(const SimilarList *list, SimilarIndex *index)
+{
+    memset(index, 0, sizeof(SimilarIndex));
+    for (size_t i = 0; i < list->count; i++)
+    {
+        uint64_t keys[SIMILAR_MAX_KEYS];
+        size_t keyCount = digestKeys(&list->entries[i].digest, keys);
+        if (index->count + keyCount > index->capacity)
+        {
+            size_t capacity = index->capacity ? index->capacity * 2 : 4096;
+            while (capacity < index->count + keyCount)
+                capacity *= 2;
+            SimilarPosting *grown = realloc(index->postings, capacity * sizeof(SimilarPosting));
+            if (grown == NULL)
+                return -1;
+            index->postings = grown;
+            index->capacity = capacity;
+        }
+        for (size_t k = 0; k < keyCount; k++)
+        {
+            index->postings[index->count].key = keys[k];
+            index->postings[index->count++].entry = i;
+        }
+    }
+    qsort(index->postings, index->count, sizeof(SimilarPosting), comparePostings);
+    return 0;
+}
+
+// Primeira entrada com a chave, ou count se não existir
+static size_t findKey(const SimilarIndex *index, uint64_t key)
+{
+    size_t low = 0, high = index->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (index->postings[middle].key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/*
+ * Comparar cada ficheiro do output com os da referência que partilham alguma chave (em vez de todos com
+ * todos) e escrever "referência,ficheiro,pontuação" para as pontuações de pelo menos minScore.
+ */
+int findSimilar(const char *referencePath, const char *manifestPath, unsigned int minScore, FILE *outputFile)
+{
+    SimilarList reference, manifest;
+    if (loadManifest(referencePath, &reference) != 0)
+    {
+        printf("Não foi possível ler '%s': %s\n", referencePath, strerror(errno));
+        return -1;
+    }
+    if (loadManifest(manifestPath, &manifest) != 0)
+    {
+        printf("Não foi possível ler '%s': %s\n", manifestPath, strerror(errno));
+        freeList(&reference);
+        return -1;
+    }
+
+    // Comparar um output consigo próprio só dispensa cada ficheiro de ser comparado com o mesmo registo
+    struct stat referenceStat, manifestStat;
+    int sameInput = stat(referencePath, &referenceStat) == 0 && stat(manifestPath, &manifestStat) == 0 &&
+                    referenceStat.st_dev == manifestStat.st_dev && referenceStat.st_ino == manifestStat.st_ino;
+
+    SimilarIndex index = {NULL, 0, 0};
+    uint32_t *seen = calloc(reference.count ? reference.count : 1, sizeof(uint32_t));
+    int ret = (seen == NULL || buildIndex(&reference, &index) != 0) ? -1 : 0;
+
+    FILE *output = outputFile ? outputFile : stdout;
+    for (size_t i = 0; ret == 0 && i < manifest.count; i++)
+    {
+        const SimilarEntry *entry = &manifest.entries[i];
+        uint64_t keys[SIMILAR_MAX_KEYS];
+        size_t keyCount = digestKeys(&entry->digest, keys);
+
+        for (size_t k = 0; k < keyCount; k++)
+            for (size_t p = findKey(&index, keys[k]); p < index.count && index.postings[p].key == keys[k]; p++)
+            {
+                // Cada candidato é pontuado uma única vez por ficheiro
+                uint32_t candidate = index.postings[p].entry;
+                if (seen[candidate] == i + 1)
+                    continue;
+                seen[candidate] = i + 1;
+
+                if (sameInput && candidate == i)
+                    continue;
+                const SimilarEntry *other = &reference.entries[candidate];
+                int score = compareCtph(&other->digest, &entry->digest);
+                if (score > 0 && (unsigned int)score >= minScore)
+                    fprintf(output, "%s,%s,%d\n", other->path, entry->path, score);
+            }
+    }
+
+    free(seen);
+    free(index.postings);
+    freeList(&reference);
+    freeList(&manifest);
+    return ret;
+}
\ No newline at end of file
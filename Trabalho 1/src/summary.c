@@ -0,0 +1,457 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "summary.h"
+
+#define SUMMARY_MAP_INITIAL_CAPACITY 64
+
+#define DAY_SECS (24 * 60 * 60)
+
+// Limite superior (exclusivo) de cada intervalo do histograma de idades, o último não tem limite
+static const time_t AGE_LIMITS[SUMMARY_AGE_BUCKETS - 1] = {DAY_SECS, 7 * DAY_SECS, 30 * DAY_SECS, 365 * DAY_SECS, 5 * 365 * DAY_SECS};
+static const char *AGE_LABELS[SUMMARY_AGE_BUCKETS] = {"<1d", "<1w", "<1m", "<1y", "<5y", ">=5y"};
+
+/*
+ * Tabela de dispersão
+ */
+
+static size_t hashKey(const char *key)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++)
+        hash = (hash ^ *c) * 1099511628211ULL;
+    return (size_t)hash;
+}
+
+static int initMap(SummaryMap *map)
+{
+    map->count = 0;
+    map->buckets = calloc(SUMMARY_MAP_INITIAL_CAPACITY, sizeof(SummaryBucket));
+    map->capacity = (map->buckets == NULL) ? 0 : SUMMARY_MAP_INITIAL_CAPACITY; // freeMap() pode ser chamada na mesma
+    return (map->buckets == NULL) ? -1 : 0;
+}
+
+static SummaryBucket *findSlot(SummaryBucket *buckets, size_t capacity, const char *key)
+{
+    size_t slot = hashKey(key) & (capacity - 1);
+    while (buckets[slot].key != NULL && strcmp(buckets[slot].key, key) != 0)
+        slot = (slot + 1) & (capacity - 1);
+    return &buckets[slot];
+}
+
+static int growMap(SummaryMap *map)
+{
+    size_t capacity = map->capacity * 2;
+    SummaryBucket *buckets = calloc(capacity, sizeof(SummaryBucket));
+    if (buckets == NULL)
+        return -1;
+
+    for (size_t i = 0; i < map->capacity; i++)
+        if (map->buckets[i].key != NULL)
+            *findSlot(buckets, capacity, map->buckets[i].key) = map->buckets[i];
+
+    free(map->buckets);
+    map->buckets = buckets;
+    map->capacity = capacity;
+    return 0;
+}
+
+static int addToMap(SummaryMap *map, const char *key, unsigned long long files, unsigned long long bytes)
+{
+    // Manter a ocupação abaixo de 70%
+    if ((map->count + 1) * 10 > map->capacity * 7 && growMap(map) != 0)
+        return -1;
+
+    SummaryBucket *bucket = findSlot(map->buckets, map->capacity, key);
+    if (bucket->key == NULL)
+    {
+        if ((bucket->key = malloc(strlen(key) + 1)) == NULL)
+            return -1;
+        strcpy(bucket->key, key);
+        map->count++;
+    }
+    bucket->files += files;
+    bucket->bytes += bytes;
+    return 0;
+}
+
+static void freeMap(SummaryMap *map)
+{
+    for (size_t i = 0; i < map->capacity; i++)
+        free(map->buckets[i].key);
+    free(map->buckets);
+    map->buckets = NULL;
+    map->capacity = map->count = 0;
+}
+
+/*
+ * Min-heap dos maiores ficheiros
+ */
+
+static void siftDown(SummaryFile *heap, size_t count, size_t i)
+{
+    while (1)
+    {
+        size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < count && heap[left].size < heap[smallest].size)
+            smallest = left;
+        if (right < count && heap[right].size < heap[smallest].size)
+            smallest = right;
+        if (smallest == i)
+            return;
+
+        SummaryFile tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void siftUp(SummaryFile *heap, size_t i)
+{
+    while (i > 0 && heap[(i - 1) / 2].size > heap[i].size)
+    {
+        SummaryFile tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+static int addLargest(Summary *summary, const char *path, off_t size)
+{
+    if (summary->topN == 0)
+        return 0;
+
+    // Heap cheio: só entra se for maior que o menor dos guardados
+    if (summary->largestCount == summary->topN && size <= summary->largest[0].size)
+        return 0;
+
+    char *copy = malloc(strlen(path) + 1);
+    if (copy == NULL)
+        return -1;
+    strcpy(copy, path);
+
+    if (summary->largestCount < summary->topN)
+    {
+        summary->largest[summary->largestCount].path = copy;
+        summary->largest[summary->largestCount].size = size;
+        siftUp(summary->largest, summary->largestCount++);
+    }
+    else
+    {
+        free(summary->largest[0].path);
+        summary->largest[0].path = copy;
+        summary->largest[0].size = size;
+        siftDown(summary->largest, summary->largestCount, 0);
+    }
+    return 0;
+}
+
+/*
+ * Acumulação
+ */
+
+int initSummary(Summary *summary, size_t topN)
+{
+    memset(summary, 0, sizeof(Summary));
+    summary->topN = topN;
+    if (topN > 0 && (summary->largest = malloc(topN * sizeof(SummaryFile))) == NULL)
+        return -1;
+
+    if (initMap(&summary->byType) != 0 || initMap(&summary->byTopDir) != 0 || initMap(&summary->byExtension) != 0)
+        return -1;
+
+    return 0;
+}
+
+static const char *getExtension(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    name = (name == NULL) ? path : name + 1;
+
+    const char *dot = strrchr(name, '.');
+    return (dot == NULL || dot == name) ? "" : dot + 1;
+}
+
+int addToSummary(Summary *summary, const char *path, const char *fileType, const struct stat *fileStat)
+{
+    unsigned long long bytes = fileStat->st_size;
+    summary->files++;
+    summary->bytes += bytes;
+
+    time_t age = time(NULL) - fileStat->st_mtime;
+    size_t bucket = 0;
+    while (bucket < SUMMARY_AGE_BUCKETS - 1 && age >= AGE_LIMITS[bucket])
+        bucket++;
+    summary->ageHistogram[bucket]++;
+
+    // Os ficheiros deste diretório contam como "." nos diretórios de topo
+    if (addToMap(&summary->byType, fileType, 1, bytes) != 0 ||
+        addToMap(&summary->byTopDir, ".", 1, bytes) != 0 ||
+        addToMap(&summary->byExtension, getExtension(path), 1, bytes) != 0)
+        return -1;
+
+    return addLargest(summary, path, fileStat->st_size);
+}
+
+static int mergeMap(SummaryMap *map, const SummaryMap *other)
+{
+    for (size_t i = 0; i < other->capacity; i++)
+        if (other->buckets[i].key != NULL &&
+            addToMap(map, other->buckets[i].key, other->buckets[i].files, other->buckets[i].bytes) != 0)
+            return -1;
+    return 0;
+}
+
+/*
+ * Juntar other a summary. topDir é o nome do sub-diretório resumido em other, ou NULL quando other é o resumo de
+ * uma parte dos ficheiros do mesmo diretório (o de uma thread de "-j"), cujos diretórios de topo se mantêm.
+ */
+int mergeSummary(Summary *summary, const Summary *other, const char *topDir)
+{
+    summary->files += other->files;
+    summary->bytes += other->bytes;
+
+    for (size_t i = 0; i < SUMMARY_AGE_BUCKETS; i++)
+        summary->ageHistogram[i] += other->ageHistogram[i];
+
+    if (mergeMap(&summary->byType, &other->byType) != 0 || mergeMap(&summary->byExtension, &other->byExtension) != 0)
+        return -1;
+
+    // Tudo o que está abaixo de um sub-diretório conta para esse sub-diretório
+    if (topDir == NULL)
+    {
+        if (mergeMap(&summary->byTopDir, &other->byTopDir) != 0)
+            return -1;
+    }
+    else if (other->files > 0 && addToMap(&summary->byTopDir, topDir, other->files, other->bytes) != 0)
+        return -1;
+
+    for (size_t i = 0; i < other->largestCount; i++)
+        if (addLargest(summary, other->largest[i].path, other->largest[i].size) != 0)
+            return -1;
+
+    return 0;
+}
+
+// Uma chave por linha: as mudanças de linha (e as barras, que as indicam) vão escapadas
+static void serializeKey(FILE *stream, const char *key)
+{
+    for (const char *c = key; *c != '\0'; c++)
+    {
+        if (*c == '\n')
+            fputs("\\n", stream);
+        else if (*c == '\\')
+            fputs("\\\\", stream);
+        else
+            fputc(*c, stream);
+    }
+    fputc('\n', stream);
+}
+
+static char *parseKey(char *key)
+{
+    char *out = key;
+    for (const char *c = key; *c != '\0'; c++)
+    {
+        if (*c == '\\' && (c[1] == 'n' || c[1] == '\\'))
+            *out++ = (*++c == 'n') ? '\n' : '\\';
+        else
+            *out++ = *c;
+    }
+    *out = '\0';
+    return key;
+}
+
+/*
+ * Passagem do resumo de um processo filho para o pai, em texto:
+ *   T ficheiros bytes
+ *   A intervalo ficheiros
+ *   Y ficheiros bytes tipo
+ *   E ficheiros bytes extensão
+ *   L tamanho caminho
+ * Os diretórios de topo não são enviados: o pai junta tudo o que o filho contou sob o nome do filho.
+ */
+char *serializeSummary(const Summary *summary)
+{
+    char *buffer = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&buffer, &length);
+    if (stream == NULL)
+        return NULL;
+
+    fprintf(stream, "T %llu %llu\n", summary->files, summary->bytes);
+    for (size_t i = 0; i < SUMMARY_AGE_BUCKETS; i++)
+        fprintf(stream, "A %zu %llu\n", i, summary->ageHistogram[i]);
+
+    for (size_t i = 0; i < summary->byType.capacity; i++)
+        if (summary->byType.buckets[i].key != NULL)
+        {
+            fprintf(stream, "Y %llu %llu ", summary->byType.buckets[i].files, summary->byType.buckets[i].bytes);
+            serializeKey(stream, summary->byType.buckets[i].key);
+        }
+
+    for (size_t i = 0; i < summary->byExtension.capacity; i++)
+        if (summary->byExtension.buckets[i].key != NULL)
+        {
+            fprintf(stream, "E %llu %llu ", summary->byExtension.buckets[i].files, summary->byExtension.buckets[i].bytes);
+            serializeKey(stream, summary->byExtension.buckets[i].key);
+        }
+
+    for (size_t i = 0; i < summary->largestCount; i++)
+    {
+        fprintf(stream, "L %ld ", summary->largest[i].size);
+        serializeKey(stream, summary->largest[i].path);
+    }
+
+    fclose(stream);
+    return buffer;
+}
+
+int parseSummary(Summary *summary, const char *buffer)
+{
+    const char *line = buffer;
+    while (line != NULL && *line != '\0')
+    {
+        const char *end = strchr(line, '\n');
+        size_t length = (end == NULL) ? strlen(line) : (size_t)(end - line);
+
+        char *text = malloc(length + 1);
+        if (text == NULL)
+            return -1;
+        memcpy(text, line, length);
+        text[length] = '\0';
+
+        unsigned long long files = 0, bytes = 0;
+        size_t bucket;
+        long size;
+        int offset = 0;
+        int ret = 0;
+
+        if (sscanf(text, "T %llu %llu", &files, &bytes) == 2)
+        {
+            summary->files += files;
+            summary->bytes += bytes;
+        }
+        else if (sscanf(text, "A %zu %llu", &bucket, &files) == 2 && bucket < SUMMARY_AGE_BUCKETS)
+            summary->ageHistogram[bucket] += files;
+        else if (sscanf(text, "Y %llu %llu %n", &files, &bytes, &offset) == 2 && offset > 0)
+            ret = addToMap(&summary->byType, parseKey(text + offset), files, bytes);
+        else if (sscanf(text, "E %llu %llu %n", &files, &bytes, &offset) == 2 && offset > 0)
+            ret = addToMap(&summary->byExtension, parseKey(text + offset), files, bytes);
+        else if (sscanf(text, "L %ld %n", &size, &offset) == 1 && offset > 0)
+            ret = addLargest(summary, parseKey(text + offset), size);
+
+        free(text);
+        if (ret != 0)
+            return -1;
+
+        line = (end == NULL) ? NULL : end + 1;
+    }
+    return 0;
+}
+
+/*
+ * Escrita do resumo final
+ */
+
+static int compareBucketsByBytes(const void *a, const void *b)
+{
+    const SummaryBucket *ba = a;
+    const SummaryBucket *bb = b;
+    if (ba->bytes != bb->bytes)
+        return (ba->bytes < bb->bytes) - (ba->bytes > bb->bytes);
+    return strcmp(ba->key, bb->key);
+}
+
+static int compareFilesBySize(const void *a, const void *b)
+{
+    const SummaryFile *fa = a;
+    const SummaryFile *fb = b;
+    if (fa->size != fb->size)
+        return (fa->size < fb->size) - (fa->size > fb->size);
+    return strcmp(fa->path, fb->path);
+}
+
+// Campo do CSV, entre aspas (e com as aspas duplicadas) se tiver vírgulas, aspas ou mudanças de linha
+static void printField(const char *field, FILE *outputFile)
+{
+    if (strpbrk(field, ",\"\r\n") == NULL)
+    {
+        fputs(field, outputFile);
+        return;
+    }
+
+    fputc('"', outputFile);
+    for (const char *c = field; *c != '\0'; c++)
+    {
+        if (*c == '"')
+            fputc('"', outputFile);
+        fputc(*c, outputFile);
+    }
+    fputc('"', outputFile);
+}
+
+static void printMap(const SummaryMap *map, const char *label, FILE *outputFile)
+{
+    SummaryBucket *sorted = malloc((map->count + 1) * sizeof(SummaryBucket));
+    if (sorted == NULL)
+        return;
+
+    size_t count = 0;
+    for (size_t i = 0; i < map->capacity; i++)
+        if (map->buckets[i].key != NULL)
+            sorted[count++] = map->buckets[i];
+    qsort(sorted, count, sizeof(SummaryBucket), compareBucketsByBytes);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        fprintf(outputFile, "%s,", label);
+        printField(sorted[i].key, outputFile);
+        fprintf(outputFile, ",%llu,%llu\n", sorted[i].files, sorted[i].bytes);
+    }
+
+    free(sorted);
+}
+
+void printSummary(const Summary *summary, FILE *outputFile)
+{
+    if (outputFile == NULL)
+        outputFile = stdout;
+
+    fprintf(outputFile, "total,,%llu,%llu\n", summary->files, summary->bytes);
+    printMap(&summary->byType, "type", outputFile);
+    printMap(&summary->byTopDir, "dir", outputFile);
+    printMap(&summary->byExtension, "ext", outputFile);
+
+    for (size_t i = 0; i < SUMMARY_AGE_BUCKETS; i++)
+        fprintf(outputFile, "age,%s,%llu\n", AGE_LABELS[i], summary->ageHistogram[i]);
+
+    SummaryFile *sorted = malloc((summary->largestCount + 1) * sizeof(SummaryFile));
+    if (sorted == NULL)
+        return;
+    memcpy(sorted, summary->largest, summary->largestCount * sizeof(SummaryFile));
+    qsort(sorted, summary->largestCount, sizeof(SummaryFile), compareFilesBySize);
+    for (size_t i = 0; i < summary->largestCount; i++)
+    {
+        fprintf(outputFile, "largest,");
+        printField(sorted[i].path, outputFile);
+        fprintf(outputFile, ",%ld\n", sorted[i].size);
+    }
+    free(sorted);
+}
+
+void freeSummary(Summary *summary)
+{
+    freeMap(&summary->byType);
+    freeMap(&summary->byTopDir);
+    freeMap(&summary->byExtension);
+    for (size_t i = 0; i < summary->largestCount; i++)
+        free(summary->largest[i].path);
+    free(summary->largest);
+    summary->largest = NULL;
+    summary->largestCount = 0;
+}
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "throttle.h"
+
+// Variável de ambiente com o descritor do estado partilhado por todos os processos da análise
+#define THROTTLE_FD_ENV "FORENSIC_THROTTLE_FD"
+
+// Rajada máxima acumulada pelos baldes, em segundos ao ritmo configurado
+#define THROTTLE_BURST 0.1
+
+// Número máximo de vezes que os limites podem ser reduzidos ou aumentados para metade / o dobro por sinal
+#define THROTTLE_MAX_SHIFT 10
+
+/*
+ * Estado partilhado (mmap) entre todos os processos e threads: um balde de bytes e outro de leituras, que
+ * enchem ao ritmo configurado. Cada leitura retira os seus tokens e, se o balde ficar negativo, espera o
+ * tempo necessário para o repor, pelo que o débito total nunca passa do limite, seja qual for o número de
+ * processos e de threads.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint64_t readRate;
+    unsigned int iops;
+    unsigned int cpuPercent;
+
+    // Cada sinal soma ou subtrai 1: os limites efetivos são os configurados a dividir por 2^shift
+    int shift;
+
+    double byteTokens;
+    double readTokens;
+    struct timespec lastRefill;
+} ThrottleState;
+
+static ThrottleState *state = NULL;
+static int stateFd = -1;
+
+static double seconds(const struct timespec *time)
+{
+    return time->tv_sec + time->tv_nsec / 1e9;
+}
+
+static void sleepFor(double duration)
+{
+    struct timespec remaining = {(time_t)duration, (long)((duration - (time_t)duration) * 1e9)};
+    while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR)
+        ;
+}
+
+// Só é alterado o contador, com uma operação atómica, por isso pode ser feito no handler.
+static void adjustHandler(int signo)
+{
+    int step = (signo == THROTTLE_SLOWER_SIGNAL) ? 1 : -1;
+    int shift = __atomic_add_fetch(&state->shift, step, __ATOMIC_RELAXED);
+    if (shift > THROTTLE_MAX_SHIFT || shift < -THROTTLE_MAX_SHIFT)
+        __atomic_sub_fetch(&state->shift, step, __ATOMIC_RELAXED);
+}
+
+static double currentScale(void)
+{
+    int shift = __atomic_load_n(&state->shift, __ATOMIC_RELAXED);
+    return (shift >= 0) ? 1.0 / (1 << shift) : (double)(1 << -shift);
+}
+
+// O lock é robusto: um processo que termine a meio (^C, ...) não bloqueia os restantes.
+static void lockState(void)
+{
+    if (pthread_mutex_lock(&state->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&state->lock);
+}
+
+static int createState(uint64_t readRate, unsigned int iops, unsigned int cpuPercent)
+{
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL)
+        tmp = "/tmp";
+    char path[strlen(tmp) + strlen("/forensic-throttle-XXXXXX") + 1];
+    sprintf(path, "%s/forensic-throttle-XXXXXX", tmp);
+
+    // O ficheiro é apagado logo: os filhos usam o descritor herdado
+    if ((stateFd = mkstemp(path)) == -1)
+    {
+        perror("mkstemp() error");
+        return -1;
+    }
+    unlink(path);
+    if (ftruncate(stateFd, sizeof(ThrottleState)) == -1)
+    {
+        perror("ftruncate() error");
+        return -1;
+    }
+
+    state = mmap(NULL, sizeof(ThrottleState), PROT_READ | PROT_WRITE, MAP_SHARED, stateFd, 0);
+    if (state == MAP_FAILED)
+    {
+        perror("mmap() error");
+        state = NULL;
+        return -1;
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&state->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    state->readRate = readRate;
+    state->iops = iops;
+    state->cpuPercent = cpuPercent;
+    state->shift = 0;
+    state->byteTokens = readRate * THROTTLE_BURST;
+    state->readTokens = iops * THROTTLE_BURST;
+    clock_gettime(CLOCK_MONOTONIC, &state->lastRefill);
+
+    char fdString[16];
+    sprintf(fdString, "%d", stateFd);
+    setenv(THROTTLE_FD_ENV, fdString, 1);
+    return 0;
+}
+
+static int attachState(const char *fdString)
+{
+    stateFd = atoi(fdString);
+    state = mmap(NULL, sizeof(ThrottleState), PROT_READ | PROT_WRITE, MAP_SHARED, stateFd, 0);
+    if (state == MAP_FAILED)
+    {
+        perror("mmap() error");
+        state = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void ignoreAdjustSignals(void)
+{
+    signal(THROTTLE_SLOWER_SIGNAL, SIG_IGN);
+    signal(THROTTLE_FASTER_SIGNAL, SIG_IGN);
+}
+
+// À volta de cada fork() os sinais ficam bloqueados, para o filho nunca correr o handler nem a ação por omissão.
+static void blockAdjustSignals(int how)
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, THROTTLE_SLOWER_SIGNAL);
+    sigaddset(&signals, THROTTLE_FASTER_SIGNAL);
+    pthread_sigmask(how, &signals, NULL);
+}
+
+static void beforeFork(void)
+{
+    blockAdjustSignals(SIG_BLOCK);
+}
+
+static void afterForkParent(void)
+{
+    blockAdjustSignals(SIG_UNBLOCK);
+}
+
+// Um sinal ignorado continua ignorado depois do exec(), nos processos filhos e nos comandos que estes executam
+static void afterForkChild(void)
+{
+    ignoreAdjustSignals();
+    blockAdjustSignals(SIG_UNBLOCK);
+}
+
+/*
+ * O processo inicial cria o estado partilhado e indica o descritor na variável de ambiente; os processos
+ * filhos usam esse estado. Só o processo inicial responde aos sinais de ajuste, para um sinal enviado a
+ * todo o grupo de processos contar uma única vez. Sem limites os sinais são ignorados, em vez de terminarem
+ * a análise.
+ */
+int openThrottle(uint64_t readRate, unsigned int iops, unsigned int cpuPercent)
+{
+    char *existing = getenv(THROTTLE_FD_ENV);
+    if (existing != NULL || (readRate == 0 && iops == 0 && cpuPercent >= 100))
+    {
+        ignoreAdjustSignals();
+        return (existing != NULL) ? attachState(existing) : 0;
+    }
+
+    if (createState(readRate, iops, cpuPercent) != 0)
+        return -1;
+    if (pthread_atfork(beforeFork, afterForkParent, afterForkChild) != 0)
+        return -1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = adjustHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(THROTTLE_SLOWER_SIGNAL, &action, NULL);
+    sigaction(THROTTLE_FASTER_SIGNAL, &action, NULL);
+    return 0;
+}
+
+static double takeTokens(double *tokens, double rate, double elapsed, double amount)
+{
+    *tokens += elapsed * rate;
+    if (*tokens > rate * THROTTLE_BURST)
+        *tokens = rate * THROTTLE_BURST;
+    *tokens -= amount;
+    return (*tokens < 0) ? -*tokens / rate : 0;
+}
+
+// Contar uma leitura de bytes e esperar, se for preciso, para respeitar os limites de débito e de leituras.
+void throttleRead(size_t bytes)
+{
+    if (state == NULL || (state->readRate == 0 && state->iops == 0))
+        return;
+
+    double scale = currentScale();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    lockState();
+    double elapsed = seconds(&now) - seconds(&state->lastRefill);
+    if (elapsed < 0)
+        elapsed = 0;
+    state->lastRefill = now;
+
+    double wait = 0, readWait = 0;
+    if (state->readRate > 0)
+        wait = takeTokens(&state->byteTokens, state->readRate * scale, elapsed, bytes);
+    if (state->iops > 0)
+        readWait = takeTokens(&state->readTokens, state->iops * scale, elapsed, 1);
+    pthread_mutex_unlock(&state->lock);
+
+    if (readWait > wait)
+        wait = readWait;
+    if (wait > 0)
+        sleepFor(wait);
+}
+
+/*
+ * Ciclo de trabalho dos sumários: depois de um bloco que gastou t segundos de CPU desde cpuStart, a thread
+ * espera t * (100 - p) / p, ficando a usar no máximo p% de um core.
+ */
+void throttleCpu(const struct timespec *cpuStart)
+{
+    if (state == NULL || state->cpuPercent >= 100)
+        return;
+
+    double percent = state->cpuPercent * currentScale();
+    if (percent >= 100)
+        return;
+    if (percent < 1)
+        percent = 1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    double used = seconds(&now) - seconds(cpuStart);
+    if (used > 0)
+        sleepFor(used * (100 - percent) / percent);
+}
+
+void closeThrottle(void)
+{
+    if (state != NULL)
+        munmap(state, sizeof(ThrottleState));
+    state = NULL;
+}
\ No newline at end of file
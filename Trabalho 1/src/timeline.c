@@ -0,0 +1,545 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "timeline.h"
+
+// Variável de ambiente com o registo onde todos os processos da análise acrescentam os eventos
+#define TIMELINE_LOG_ENV "FORENSIC_TIMELINE_LOG"
+
+// Memória usada para ordenar cada sequência antes de a escrever num ficheiro temporário
+#define TIMELINE_RUN_BYTES (64 << 20)
+
+// Sequências juntadas de cada vez (ficheiros abertos em simultâneo)
+#define TIMELINE_MERGE_FANIN 64
+
+// Actividades de um evento: datas iguais do mesmo ficheiro ficam no mesmo evento
+#define TIMELINE_MODIFY 0x1
+#define TIMELINE_ACCESS 0x2
+#define TIMELINE_CHANGE 0x4
+
+// Cabeçalho de cada evento nos ficheiros temporários, seguido do caminho (com o terminador)
+#define EVENT_HEADER_SIZE (sizeof(int64_t) + sizeof(uint64_t) + sizeof(uint32_t) + 1)
+
+typedef struct
+{
+    int64_t time;
+    uint64_t size;
+    uint32_t pathLength;
+    unsigned char activity;
+} EventHeader;
+
+// Evento dentro do buffer de uma sequência, para ordenar sem copiar os caminhos
+typedef struct
+{
+    int64_t time;
+    const char *path;
+    const unsigned char *record;
+    size_t length;
+} RunEvent;
+
+// Leitura sequencial de uma sequência ordenada durante a junção
+typedef struct
+{
+    FILE *file;
+    EventHeader header;
+    char *path;
+    size_t pathCapacity;
+} RunReader;
+
+static int logFd = -1;
+static char *tempDir = NULL;
+static size_t runCount = 0;
+
+// Nos processos de "--shards" os eventos de cada unidade ficam em memória até a unidade terminar
+static int capturing = 0;
+static unsigned char *captured = NULL;
+static size_t capturedLength = 0;
+static size_t capturedCapacity = 0;
+
+/*
+ * Registo dos eventos
+ */
+
+/*
+ * O processo inicial cria uma pasta temporária com o registo e indica-o na variável de ambiente, para os processos
+ * filhos acrescentarem aí os seus eventos. Devolve 1 no processo que deve escrever a linha temporal.
+ */
+int openTimelineLog(void)
+{
+    char *existing = getenv(TIMELINE_LOG_ENV);
+    if (existing != NULL)
+    {
+        if ((logFd = open(existing, O_WRONLY | O_APPEND | O_CLOEXEC)) == -1)
+        {
+            perror("open() error");
+            return -1;
+        }
+        return 0;
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL)
+        tmp = "/tmp";
+    tempDir = malloc(strlen(tmp) + strlen("/forensic-timeline-XXXXXX") + 1);
+    if (tempDir == NULL)
+        return -1;
+    sprintf(tempDir, "%s/forensic-timeline-XXXXXX", tmp);
+    if (mkdtemp(tempDir) == NULL)
+    {
+        perror("mkdtemp() error");
+        free(tempDir);
+        tempDir = NULL;
+        return -1;
+    }
+
+    char logPath[strlen(tempDir) + strlen("/events") + 1];
+    sprintf(logPath, "%s/events", tempDir);
+    if ((logFd = open(logPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600)) == -1)
+    {
+        perror("open() error");
+        discardTimeline();
+        return -1;
+    }
+    setenv(TIMELINE_LOG_ENV, logPath, 1);
+
+    return 1;
+}
+
+static void encodeHeader(unsigned char *buffer, const EventHeader *header)
+{
+    unsigned char *next = buffer;
+    memcpy(next, &header->time, sizeof(header->time));
+    next += sizeof(header->time);
+    memcpy(next, &header->size, sizeof(header->size));
+    next += sizeof(header->size);
+    memcpy(next, &header->pathLength, sizeof(header->pathLength));
+    next += sizeof(header->pathLength);
+    *next = header->activity;
+}
+
+static void decodeHeader(const unsigned char *buffer, EventHeader *header)
+{
+    memcpy(&header->time, buffer, sizeof(header->time));
+    buffer += sizeof(header->time);
+    memcpy(&header->size, buffer, sizeof(header->size));
+    buffer += sizeof(header->size);
+    memcpy(&header->pathLength, buffer, sizeof(header->pathLength));
+    buffer += sizeof(header->pathLength);
+    header->activity = *buffer;
+}
+
+// Os eventos de um ficheiro são escritos com um único write(), para não se misturarem com os de outros processos.
+int addTimelineEvents(const char *path, const struct stat *fileStat)
+{
+    const time_t times[3] = {fileStat->st_mtime, fileStat->st_atime, fileStat->st_ctime};
+    const unsigned char activities[3] = {TIMELINE_MODIFY, TIMELINE_ACCESS, TIMELINE_CHANGE};
+
+    size_t pathLength = strlen(path) + 1;
+    unsigned char *buffer = malloc(3 * (EVENT_HEADER_SIZE + pathLength));
+    if (buffer == NULL)
+        return -1;
+
+    size_t length = 0;
+    unsigned char done = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (done & activities[i])
+            continue;
+
+        EventHeader header = {times[i], fileStat->st_size, pathLength, 0};
+        for (int j = i; j < 3; j++)
+            if (times[j] == times[i])
+                header.activity |= activities[j];
+        done |= header.activity;
+        encodeHeader(buffer + length, &header);
+        memcpy(buffer + length + EVENT_HEADER_SIZE, path, pathLength);
+        length += EVENT_HEADER_SIZE + pathLength;
+    }
+
+    if (capturing)
+    {
+        if (capturedLength + length > capturedCapacity)
+        {
+            size_t capacity = (capturedCapacity == 0) ? 4096 : capturedCapacity;
+            while (capacity < capturedLength + length)
+                capacity *= 2;
+            unsigned char *events = realloc(captured, capacity);
+            if (events == NULL)
+            {
+                free(buffer);
+                return -1;
+            }
+            captured = events;
+            capturedCapacity = capacity;
+        }
+        memcpy(captured + capturedLength, buffer, length);
+        capturedLength += length;
+        free(buffer);
+        return 0;
+    }
+
+    int ret = writeTimelineEvents(buffer, length);
+    free(buffer);
+
+    return ret;
+}
+
+// Acrescentar ao registo eventos já codificados, com um único write().
+int writeTimelineEvents(const void *events, size_t length)
+{
+    if (write(logFd, events, length) != (ssize_t)length)
+    {
+        perror("write() error");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Num processo de "--shards": guardar os eventos em memória em vez de os escrever no registo. O coordenador só os
+ * escreve (com writeTimelineEvents()) quando a unidade termina, e os de uma unidade repetida não ficam em dobro.
+ */
+void captureTimelineEvents(void)
+{
+    capturing = 1;
+}
+
+// Eventos guardados desde a última chamada (NULL se não houver), a libertar por quem chama.
+unsigned char *takeTimelineEvents(size_t *length)
+{
+    unsigned char *events = captured;
+    *length = capturedLength;
+    captured = NULL;
+    capturedLength = capturedCapacity = 0;
+    return events;
+}
+
+/*
+ * Ordenação externa
+ */
+
+static int compareEvents(int64_t time, const char *path, int64_t otherTime, const char *otherPath)
+{
+    if (time != otherTime)
+        return (time < otherTime) ? -1 : 1;
+    return strcmp(path, otherPath);
+}
+
+static int compareRunEvents(const void *a, const void *b)
+{
+    const RunEvent *first = a, *second = b;
+    return compareEvents(first->time, first->path, second->time, second->path);
+}
+
+static char *runPath(size_t run)
+{
+    char *path = malloc(strlen(tempDir) + 32);
+    if (path != NULL)
+        sprintf(path, "%s/run-%zu", tempDir, run);
+    return path;
+}
+
+static int writeRun(RunEvent *events, size_t count)
+{
+    qsort(events, count, sizeof(RunEvent), compareRunEvents);
+
+    char *path = runPath(runCount);
+    FILE *file = (path != NULL) ? fopen(path, "wb") : NULL;
+    free(path);
+    if (file == NULL)
+    {
+        perror("fopen() error");
+        return -1;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < count && ret == 0; i++)
+        if (fwrite(events[i].record, 1, events[i].length, file) != events[i].length)
+            ret = -1;
+    if (fclose(file) != 0)
+        ret = -1;
+
+    runCount++;
+    return ret;
+}
+
+// Ler o registo em blocos de memória limitada, escrevendo cada um ordenado numa sequência.
+static int createRuns(const char *logPath)
+{
+    int fd = open(logPath, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open() error");
+        return -1;
+    }
+
+    unsigned char *buffer = malloc(TIMELINE_RUN_BYTES);
+    RunEvent *events = NULL;
+    size_t used = 0, capacity = 0;
+    int ret = (buffer == NULL) ? -1 : 0;
+
+    while (ret == 0)
+    {
+        // Encher o buffer (ou ler até ao fim do registo)
+        ssize_t readBytes = 1;
+        while (used < TIMELINE_RUN_BYTES && (readBytes = read(fd, buffer + used, TIMELINE_RUN_BYTES - used)) > 0)
+            used += readBytes;
+        if (readBytes == -1)
+        {
+            perror("read() error");
+            ret = -1;
+            break;
+        }
+
+        // Separar os eventos completos, o resto passa para o início do próximo bloco
+        size_t count = 0, position = 0;
+        while (position + EVENT_HEADER_SIZE <= used)
+        {
+            EventHeader header;
+            decodeHeader(buffer + position, &header);
+            if (position + EVENT_HEADER_SIZE + header.pathLength > used)
+                break;
+
+            if (count == capacity)
+            {
+                capacity = (capacity == 0) ? 4096 : capacity * 2;
+                RunEvent *grown = realloc(events, capacity * sizeof(RunEvent));
+                if (grown == NULL)
+                {
+                    ret = -1;
+                    break;
+                }
+                events = grown;
+            }
+
+            events[count].time = header.time;
+            events[count].path = (const char *)buffer + position + EVENT_HEADER_SIZE;
+            events[count].record = buffer + position;
+            events[count].length = EVENT_HEADER_SIZE + header.pathLength;
+            count++;
+            position += EVENT_HEADER_SIZE + header.pathLength;
+        }
+
+        if (ret == 0 && count > 0 && writeRun(events, count) != 0)
+            ret = -1;
+
+        memmove(buffer, buffer + position, used - position);
+        used -= position;
+        if (readBytes == 0)
+            break;
+    }
+
+    free(buffer);
+    free(events);
+    close(fd);
+    return ret;
+}
+
+// Ler o evento seguinte da sequência: 1 se existe, 0 no fim, -1 em caso de erro
+static int readEvent(RunReader *reader)
+{
+    unsigned char buffer[EVENT_HEADER_SIZE];
+    size_t readBytes = fread(buffer, 1, EVENT_HEADER_SIZE, reader->file);
+    if (readBytes == 0)
+        return 0;
+    if (readBytes != EVENT_HEADER_SIZE)
+        return -1;
+    decodeHeader(buffer, &reader->header);
+
+    if (reader->header.pathLength > reader->pathCapacity)
+    {
+        char *path = realloc(reader->path, reader->header.pathLength);
+        if (path == NULL)
+            return -1;
+        reader->path = path;
+        reader->pathCapacity = reader->header.pathLength;
+    }
+    if (reader->header.pathLength == 0 || fread(reader->path, 1, reader->header.pathLength, reader->file) != reader->header.pathLength)
+        return -1;
+    reader->path[reader->header.pathLength - 1] = '\0';
+
+    return 1;
+}
+
+static int readerLess(const RunReader *a, const RunReader *b)
+{
+    return compareEvents(a->header.time, a->path, b->header.time, b->path) < 0;
+}
+
+static void siftDown(RunReader **heap, size_t count, size_t i)
+{
+    while (1)
+    {
+        size_t smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < count && readerLess(heap[left], heap[smallest]))
+            smallest = left;
+        if (right < count && readerLess(heap[right], heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            return;
+        RunReader *tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static int printEvent(FILE *outputFile, const RunReader *reader)
+{
+    char date[32];
+    time_t time = reader->header.time;
+    struct tm *ts = localtime(&time);
+    if (ts == NULL || strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", ts) == 0)
+        strcpy(date, "?");
+
+    return fprintf(outputFile, "%s,%c%c%c,%llu,%s\n", date,
+                   (reader->header.activity & TIMELINE_MODIFY) ? 'm' : '.',
+                   (reader->header.activity & TIMELINE_ACCESS) ? 'a' : '.',
+                   (reader->header.activity & TIMELINE_CHANGE) ? 'c' : '.',
+                   (unsigned long long)reader->header.size, reader->path) < 0
+               ? -1
+               : 0;
+}
+
+/*
+ * Juntar as sequências [first, first + count) com um heap: para uma nova sequência (output == NULL) ou,
+ * na última passagem, escrevendo as linhas da linha temporal.
+ */
+static int mergeRuns(size_t first, size_t count, FILE *outputFile)
+{
+    if (count == 0)
+        return 0;
+
+    RunReader *readers = calloc(count, sizeof(RunReader));
+    RunReader **heap = malloc(count * sizeof(RunReader *));
+    FILE *runFile = NULL;
+    size_t heapCount = 0;
+    int ret = (readers == NULL || heap == NULL) ? -1 : 0;
+
+    for (size_t i = 0; ret == 0 && i < count; i++)
+    {
+        char *path = runPath(first + i);
+        readers[i].file = (path != NULL) ? fopen(path, "rb") : NULL;
+        if (readers[i].file == NULL)
+            ret = -1;
+        else
+        {
+            unlink(path); // O ficheiro desaparece quando for fechado
+            int status = readEvent(&readers[i]);
+            if (status == 1)
+                heap[heapCount++] = &readers[i];
+            else if (status == -1)
+                ret = -1;
+        }
+        free(path);
+    }
+
+    if (ret == 0 && outputFile == NULL)
+    {
+        char *path = runPath(runCount++);
+        if (path == NULL || (runFile = fopen(path, "wb")) == NULL)
+            ret = -1;
+        free(path);
+    }
+
+    for (size_t i = heapCount / 2; i-- > 0;)
+        siftDown(heap, heapCount, i);
+
+    while (ret == 0 && heapCount > 0)
+    {
+        RunReader *reader = heap[0];
+        if (runFile != NULL)
+        {
+            unsigned char header[EVENT_HEADER_SIZE];
+            encodeHeader(header, &reader->header);
+            if (fwrite(header, 1, EVENT_HEADER_SIZE, runFile) != EVENT_HEADER_SIZE ||
+                fwrite(reader->path, 1, reader->header.pathLength, runFile) != reader->header.pathLength)
+                ret = -1;
+        }
+        else if (printEvent(outputFile, reader) != 0)
+            ret = -1;
+
+        int status = readEvent(reader);
+        if (status == -1)
+            ret = -1;
+        else if (status == 0)
+            heap[0] = heap[--heapCount];
+        siftDown(heap, heapCount, 0);
+    }
+
+    if (runFile != NULL && fclose(runFile) != 0)
+        ret = -1;
+    for (size_t i = 0; readers != NULL && i < count; i++)
+    {
+        if (readers[i].file != NULL)
+            fclose(readers[i].file);
+        free(readers[i].path);
+    }
+    free(readers);
+    free(heap);
+
+    return ret;
+}
+
+/*
+ * Ordenar todos os eventos por data com memória limitada: sequências ordenadas de TIMELINE_RUN_BYTES escritas em
+ * ficheiros temporários, juntadas TIMELINE_MERGE_FANIN de cada vez até restarem poucas para a junção final.
+ */
+int writeTimeline(FILE *outputFile)
+{
+    close(logFd);
+    logFd = -1;
+
+    const char *logPath = getenv(TIMELINE_LOG_ENV);
+    if (logPath == NULL || tempDir == NULL)
+        return -1;
+
+    int ret = createRuns(logPath);
+    unlink(logPath);
+
+    size_t first = 0;
+    while (ret == 0 && runCount - first > TIMELINE_MERGE_FANIN)
+    {
+        ret = mergeRuns(first, TIMELINE_MERGE_FANIN, NULL);
+        first += TIMELINE_MERGE_FANIN;
+    }
+    if (ret == 0)
+        ret = mergeRuns(first, runCount - first, outputFile ? outputFile : stdout);
+
+    discardTimeline();
+    return ret;
+}
+
+/*
+ * Apagar a pasta temporária do processo inicial com o que lá estiver (o registo e as sequências que ficaram por
+ * juntar depois de um erro). Sem efeito nos processos filhos ou depois de writeTimeline().
+ */
+void discardTimeline(void)
+{
+    if (logFd != -1)
+    {
+        close(logFd);
+        logFd = -1;
+    }
+    if (tempDir == NULL)
+        return;
+
+    char logPath[strlen(tempDir) + strlen("/events") + 1];
+    sprintf(logPath, "%s/events", tempDir);
+    unlink(logPath);
+    for (size_t run = 0; run < runCount; run++)
+    {
+        char *path = runPath(run);
+        if (path != NULL)
+            unlink(path);
+        free(path);
+    }
+    rmdir(tempDir);
+    free(tempDir);
+    tempDir = NULL;
+    unsetenv(TIMELINE_LOG_ENV);
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "compressedOutput.h"
+
+/*
+    forensic-unpack output.fz
+    forensic-unpack -j 4 output.fz
+
+    Escreve em stdout o output comprimido por "forensic -z". Os cabeçalhos dos blocos são percorridos
+    primeiro (só os tamanhos), depois cada grupo de blocos é descomprimido em paralelo em n threads e
+    escrito pela ordem original.
+
+    Termina com 0 se todos os blocos forem válidos.
+*/
+
+// Blocos descomprimidos por cada thread antes de serem escritos
+#define UNPACK_BLOCKS_PER_THREAD 8
+
+typedef struct
+{
+    FrameHeader header;
+    const unsigned char *payload;
+} Frame;
+
+typedef struct
+{
+    const Frame *frames;
+    unsigned char *output; // FRAME_BLOCK_SIZE bytes por bloco
+    size_t count;
+    int threaded; // Descomprimido numa thread própria
+    int error;
+} UnpackJob;
+
+static void *unpackWorker(void *arg)
+{
+    UnpackJob *job = arg;
+    for (size_t i = 0; i < job->count; i++)
+        if (decodeFrame(&job->frames[i].header, job->frames[i].payload, job->output + i * FRAME_BLOCK_SIZE) != 0)
+            job->error = 1;
+    return NULL;
+}
+
+// Percorrer os cabeçalhos, sem descomprimir. Devolve o número de blocos, ou -1 se o ficheiro estiver corrompido.
+static long findFrames(const unsigned char *data, size_t length, Frame **frames)
+{
+    size_t count = 0, capacity = 0;
+    *frames = NULL;
+
+    for (size_t offset = 0; offset < length;)
+    {
+        FrameHeader header;
+        if (parseFrameHeader(data + offset, length - offset, &header) != 0 ||
+            header.storedLength > length - offset - FRAME_HEADER_SIZE)
+            return -1;
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            Frame *grown = realloc(*frames, capacity * sizeof(Frame));
+            if (grown == NULL)
+                return -1;
+            *frames = grown;
+        }
+        (*frames)[count].header = header;
+        (*frames)[count].payload = data + offset + FRAME_HEADER_SIZE;
+        count++;
+
+        offset += FRAME_HEADER_SIZE + header.storedLength;
+    }
+    return count;
+}
+
+static int unpackFrames(const Frame *frames, size_t count, unsigned int jobs)
+{
+    size_t groupSize = (size_t)jobs * UNPACK_BLOCKS_PER_THREAD;
+    unsigned char *output = malloc(groupSize * FRAME_BLOCK_SIZE);
+    UnpackJob *group = calloc(jobs, sizeof(UnpackJob));
+    pthread_t *threads = calloc(jobs, sizeof(pthread_t));
+    int ret = (output == NULL || group == NULL || threads == NULL) ? -1 : 0;
+
+    for (size_t first = 0; ret == 0 && first < count; first += groupSize)
+    {
+        size_t inGroup = (count - first < groupSize) ? count - first : groupSize;
+        size_t perThread = (inGroup + jobs - 1) / jobs;
+
+        for (unsigned int t = 0; t < jobs && t * perThread < inGroup; t++)
+        {
+            group[t].frames = frames + first + t * perThread;
+            group[t].output = output + t * perThread * FRAME_BLOCK_SIZE;
+            group[t].count = (inGroup - t * perThread < perThread) ? inGroup - t * perThread : perThread;
+            group[t].error = 0;
+
+            // A primeira parte (ou uma que não tenha thread) é descomprimida nesta thread
+            group[t].threaded = (t != 0 && pthread_create(&threads[t], NULL, unpackWorker, &group[t]) == 0);
+            if (!group[t].threaded)
+                unpackWorker(&group[t]);
+        }
+
+        for (unsigned int t = 0; t < jobs && t * perThread < inGroup; t++)
+        {
+            if (group[t].threaded)
+                pthread_join(threads[t], NULL);
+            if (group[t].error)
+                ret = -1;
+        }
+
+        for (size_t i = 0; ret == 0 && i < inGroup; i++)
+            if (fwrite(output + i * FRAME_BLOCK_SIZE, 1, frames[first + i].header.rawLength, stdout) != frames[first + i].header.rawLength)
+                ret = -1;
+    }
+
+    free(output);
+    free(group);
+    free(threads);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int jobs = 1;
+    char *path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || value == 0 || value > 32)
+            {
+                fprintf(stderr, "Número de threads inválido: '%s' (1 a 32)\n", argv[i]);
+                return -1;
+            }
+            jobs = value;
+        }
+        else if (path == NULL)
+            path = argv[i];
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+
+    if (path == NULL)
+    {
+        fprintf(stderr, "Uso: %s [-j n] ficheiro\n", argv[0]);
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat fileStat;
+    if (fd == -1 || fstat(fd, &fileStat) == -1)
+    {
+        fprintf(stderr, "Não foi possível abrir '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // Ficheiro vazio: nada a escrever
+    if (fileStat.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    unsigned char *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Não foi possível mapear '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+
+    Frame *frames;
+    long count = findFrames(data, fileStat.st_size, &frames);
+    int ret = (count == -1) ? -1 : unpackFrames(frames, count, jobs);
+    if (ret != 0)
+        fprintf(stderr, "Ficheiro '%s' corrompido!\n", path);
+
+    free(frames);
+    munmap(data, fileStat.st_size);
+    return ret;
+}
\ No newline at end of file
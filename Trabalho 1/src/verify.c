@@ -0,0 +1,343 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "digest.h"
+#include "manifest.h"
+#include "throttle.h"
+#include "verify.h"
+
+// Tamanho das leituras ao recalcular o SHA-256
+#define VERIFY_READ_SIZE (1 << 20)
+
+enum
+{
+    VERIFIED,
+    MODIFIED,
+    MISSING,
+    EXTRA,
+    VERIFY_STATES
+};
+
+static const char *STATE_NAMES[VERIFY_STATES] = {"verified", "modified", "missing", "extra"};
+
+// Ficheiro do índice a verificar
+typedef struct
+{
+    char *path;
+    uint64_t size;
+    int64_t mtime;
+    unsigned char sha256[MANIFEST_DIGEST_BYTES];
+    int hasDigest;
+} VerifyEntry;
+
+typedef struct
+{
+    VerifyEntry *entries;
+    size_t count;
+    size_t capacity;
+    int error;
+
+    // Ficheiros cujos metadados coincidem, por verificar o conteúdo (dos maiores para os menores)
+    VerifyEntry **pending;
+    size_t pendingCount;
+
+    FILE *outputFile;
+    unsigned long long totals[VERIFY_STATES];
+
+    size_t next;          // Próximo trabalho a distribuir pelas threads
+    pthread_mutex_t lock; // Protege next, pending, totals e o output
+} Verification;
+
+// Escrever uma linha "estado,ficheiro[,motivo]" logo que o resultado é conhecido.
+static void report(Verification *verification, int state, const char *path, const char *reason)
+{
+    pthread_mutex_lock(&verification->lock);
+    verification->totals[state]++;
+    FILE *output = verification->outputFile ? verification->outputFile : stdout;
+    fprintf(output, "%s,%s%s%s\n", STATE_NAMES[state], path, reason ? "," : "", reason ? reason : "");
+    pthread_mutex_unlock(&verification->lock);
+}
+
+static void collectEntry(const ManifestRecord *record, void *context)
+{
+    Verification *verification = context;
+    if (verification->error)
+        return;
+
+    if (verification->count == verification->capacity)
+    {
+        size_t capacity = verification->capacity ? verification->capacity * 2 : 1024;
+        VerifyEntry *grown = realloc(verification->entries, capacity * sizeof(VerifyEntry));
+        if (grown == NULL)
+        {
+            verification->error = 1;
+            return;
+        }
+        verification->entries = grown;
+        verification->capacity = capacity;
+    }
+
+    VerifyEntry *entry = &verification->entries[verification->count];
+    if ((entry->path = strdup(record->path)) == NULL)
+    {
+        verification->error = 1;
+        return;
+    }
+    entry->size = record->size;
+    entry->mtime = record->mtime;
+
+    // O SHA-256 do conteúdo está sempre no índice, identificado pelo tamanho
+    entry->hasDigest = 0;
+    for (size_t i = 0; i < record->digestCount; i++)
+        if (record->digestLength[i] == MANIFEST_DIGEST_BYTES)
+        {
+            memcpy(entry->sha256, record->digests[i], MANIFEST_DIGEST_BYTES);
+            entry->hasDigest = 1;
+        }
+
+    verification->count++;
+}
+
+// Distribuir os índices 0..count-1 pelas threads, cada uma fica com o próximo que falta.
+static int nextJob(Verification *verification, size_t count, size_t *i)
+{
+    pthread_mutex_lock(&verification->lock);
+    *i = verification->next++;
+    pthread_mutex_unlock(&verification->lock);
+    return *i < count;
+}
+
+static void *statWorker(void *arg)
+{
+    Verification *verification = arg;
+    size_t i;
+    while (nextJob(verification, verification->count, &i))
+    {
+        VerifyEntry *entry = &verification->entries[i];
+        struct stat fileStat;
+        if (stat(entry->path, &fileStat) == -1)
+            report(verification, MISSING, entry->path, NULL);
+        else if ((uint64_t)fileStat.st_size != entry->size)
+            report(verification, MODIFIED, entry->path, "size");
+        else if (fileStat.st_mtime != entry->mtime)
+            report(verification, MODIFIED, entry->path, "mtime");
+        else if (!entry->hasDigest)
+            report(verification, VERIFIED, entry->path, NULL);
+        else
+        {
+            pthread_mutex_lock(&verification->lock);
+            verification->pending[verification->pendingCount++] = entry;
+            pthread_mutex_unlock(&verification->lock);
+        }
+    }
+    return NULL;
+}
+
+// Recalcular o SHA-256, parando assim que são lidos mais bytes do que os do índice.
+static const char *checkContent(const VerifyEntry *entry, unsigned char *buffer)
+{
+    int fd = open(entry->path, O_RDONLY);
+    if (fd == -1)
+        return "unreadable";
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    DigestCtx ctx;
+    digestInit(&ctx, DIGEST_SHA256);
+    uint64_t total = 0;
+    ssize_t readBytes;
+    while ((readBytes = read(fd, buffer, VERIFY_READ_SIZE)) != 0)
+    {
+        if (readBytes == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return "unreadable";
+        }
+        throttleRead(readBytes);
+        total += readBytes;
+        if (total > entry->size)
+        {
+            close(fd);
+            return "size";
+        }
+        struct timespec cpuStart;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+        digestUpdate(&ctx, buffer, readBytes);
+        throttleCpu(&cpuStart);
+    }
+    close(fd);
+
+    char hex[DIGEST_MAX_HEX_LEN + 1];
+    unsigned char digest[MANIFEST_DIGEST_BYTES];
+    digestFinalHex(&ctx, hex);
+    parseManifestDigest(hex, digest);
+    if (total != entry->size)
+        return "size";
+    return (memcmp(digest, entry->sha256, MANIFEST_DIGEST_BYTES) == 0) ? NULL : "content";
+}
+
+static void *hashWorker(void *arg)
+{
+    Verification *verification = arg;
+    unsigned char *buffer = malloc(VERIFY_READ_SIZE);
+    if (buffer == NULL)
+    {
+        pthread_mutex_lock(&verification->lock);
+        verification->error = 1;
+        pthread_mutex_unlock(&verification->lock);
+        return NULL;
+    }
+
+    size_t i;
+    while (nextJob(verification, verification->pendingCount, &i))
+    {
+        const char *reason = checkContent(verification->pending[i], buffer);
+        report(verification, reason ? MODIFIED : VERIFIED, verification->pending[i]->path, reason);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+static void runWorkers(Verification *verification, void *(*worker)(void *), size_t count, unsigned int jobs)
+{
+    size_t threadCount = (count < jobs) ? count : jobs;
+    pthread_t threads[threadCount > 0 ? threadCount : 1];
+    size_t started = 0;
+
+    verification->next = 0;
+    for (; started < threadCount; started++)
+        if (pthread_create(&threads[started], NULL, worker, verification) != 0)
+        {
+            perror("pthread_create() error");
+            break;
+        }
+    if (started == 0) // Sem threads, fazer o trabalho nesta
+        worker(verification);
+
+    for (size_t i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+static int compareEntryPaths(const void *a, const void *b)
+{
+    return strcmp((const char *)a, ((const VerifyEntry *)b)->path);
+}
+
+static int compareBySizeDesc(const void *a, const void *b)
+{
+    uint64_t sizeA = (*(VerifyEntry *const *)a)->size, sizeB = (*(VerifyEntry *const *)b)->size;
+    return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+// Percorrer o alvo com os mesmos caminhos que a análise e indicar os ficheiros que não estão no índice.
+static int findExtra(Verification *verification, char *path, const Filter *filter)
+{
+    struct stat fileStat;
+    if (lstat(path, &fileStat) == -1)
+        return 0;
+
+    if (S_ISDIR(fileStat.st_mode))
+    {
+        DIR *dir = opendir(path);
+        if (dir == NULL)
+        {
+            perror("Opendir() error");
+            return -1;
+        }
+
+        int ret = 0;
+        struct dirent *dent;
+        while (ret == 0 && (dent = readdir(dir)) != NULL)
+        {
+            if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
+                continue;
+
+            char *childPath = malloc(strlen(path) + strlen(dent->d_name) + 1 + 1);
+            if (childPath == NULL)
+                ret = -1;
+            else
+            {
+                sprintf(childPath, "%s/%s", path, dent->d_name);
+                if (!filterExcludes(filter, childPath))
+                    ret = findExtra(verification, childPath, filter);
+                free(childPath);
+            }
+        }
+        closedir(dir);
+        return ret;
+    }
+
+    // Como na análise, as ligações simbólicas são filtradas pelos dados do ficheiro para onde apontam
+    int isLink = S_ISLNK(fileStat.st_mode);
+    if (isLink && stat(path, &fileStat) == -1)
+        return 0;
+    if (filterAccepts(filter, path, &fileStat, isLink) &&
+        bsearch(path, verification->entries, verification->count, sizeof(VerifyEntry), compareEntryPaths) == NULL)
+        report(verification, EXTRA, path, NULL);
+    return 0;
+}
+
+/*
+ * Verificar o alvo contra um índice de "--index": primeiro o stat() de todos os ficheiros em paralelo, que
+ * indica logo os que faltam ou mudaram de tamanho ou data; depois o SHA-256 só dos que coincidem, dos maiores
+ * para os menores em todas as threads; por fim os ficheiros do alvo que não estão no índice.
+ * Devolve 0 se tudo coincidir, 1 se houver diferenças, -1 em caso de erro.
+ */
+int verifyManifest(const char *indexPath, char *targetLocation, const Filter *filter, unsigned int jobs, FILE *outputFile)
+{
+    Manifest manifest;
+    if (openManifest(&manifest, indexPath) != 0)
+    {
+        printf("Não foi possível abrir o índice '%s': %s\n", indexPath, strerror(errno));
+        return -1;
+    }
+
+    Verification verification;
+    memset(&verification, 0, sizeof(Verification));
+    verification.outputFile = outputFile;
+    pthread_mutex_init(&verification.lock, NULL);
+
+    // Os registos vêm ordenados pelo caminho, o que permite procurar os extra com bsearch()
+    int ret = scanManifestPrefix(&manifest, "", collectEntry, &verification);
+    closeManifest(&manifest);
+    if (ret == -1 || verification.error)
+    {
+        printf("Índice '%s' corrompido!\n", indexPath);
+        ret = -1;
+    }
+    else if ((verification.pending = malloc((verification.count ? verification.count : 1) * sizeof(VerifyEntry *))) == NULL)
+        ret = -1;
+    else
+    {
+        runWorkers(&verification, statWorker, verification.count, jobs);
+
+        qsort(verification.pending, verification.pendingCount, sizeof(VerifyEntry *), compareBySizeDesc);
+        runWorkers(&verification, hashWorker, verification.pendingCount, jobs);
+
+        ret = (findExtra(&verification, targetLocation, filter) != 0 || verification.error) ? -1 : 0;
+    }
+
+    if (ret == 0)
+    {
+        fprintf(outputFile ? outputFile : stdout, "Verificados: %llu, modificados: %llu, em falta: %llu, extra: %llu\n",
+                verification.totals[VERIFIED], verification.totals[MODIFIED],
+                verification.totals[MISSING], verification.totals[EXTRA]);
+        if (verification.totals[MODIFIED] || verification.totals[MISSING] || verification.totals[EXTRA])
+            ret = 1;
+    }
+
+    for (size_t i = 0; i < verification.count; i++)
+        free(verification.entries[i].path);
+    free(verification.entries);
+    free(verification.pending);
+    pthread_mutex_destroy(&verification.lock);
+
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Verificações de regressão: correr a partir de "Trabalho 1" com "make check"
+FORENSIC=./forensic
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failures=0
+
+fail()
+{
+    echo "FALHOU: $1"
+    failures=$((failures + 1))
+}
+
+# Um cabeçalho pax mal formado é reportado e o membro seguinte é analisado na mesma
+$FORENSIC --into-archives -h md5 teste/malformed-pax.tar >"$TMP/out" 2>"$TMP/err"
+grep -q "Malformed pax header" "$TMP/err" || fail "malformed-pax.tar: erro do cabeçalho pax não reportado"
+grep -q "^teste/malformed-pax.tar!/file.txt," "$TMP/out" || fail "malformed-pax.tar: membro file.txt não analisado"
+
+# Com "--profile" cada ficheiro tem uma só medição do stat, também com threads e processos de análise
+mkdir "$TMP/profile"
+for i in 1 2 3 4 5 6 7 8 9 10 11 12; do
+    echo "$i" >"$TMP/profile/file$i"
+done
+for mode in "" "-j 4" "--shards 3"; do
+    $FORENSIC -r -h md5 $mode --profile "$TMP/profile.json" "$TMP/profile" >/dev/null
+    count=$(sed -n 's/.*"stat": {"count": \([0-9]*\).*/\1/p' "$TMP/profile.json")
+    [ "$count" = 12 ] || fail "--profile $mode: $count medições do stat para 12 ficheiros"
+done
+
+if [ $failures -ne 0 ]; then
+    exit 1
+fi
+echo "OK"
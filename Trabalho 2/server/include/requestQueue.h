@@ -1,15 +1,29 @@
 #pragma once
 
-#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "types.h"
 
+/**
+ * @brief Bounded multi-producer multi-consumer request ring.
+ *
+ * Holds RequestSlab slot indexes in cache-line sized cells, each with its own sequence number,
+ * so producers and consumers never take a lock. Threads only sleep (futex) when the ring is
+ * empty (pop) or full (push).
+ */
 struct requestQueue
 {
-    int (*isEmpty)(void);
-    int (*isFull)(void);
-    int (*size)(void);
-    int (*push)(tlv_request_t* request);
-    int (*pop)(tlv_request_t* request);
+	int (*init)(size_t capacity);
+	void (*destroy)(void);
+	int (*isEmpty)(void);
+	int (*isFull)(void);
+	int (*size)(void);
+	size_t (*capacity)(void);
+	int (*tryPush)(uint32_t slot);
+	int (*tryPop)(uint32_t *slot);
+	int (*push)(uint32_t slot);
+	int (*pop)(uint32_t *slot);
+	void (*close)(void);
 };
 
-extern const struct requestQueue RequestQueue;
\ No newline at end of file
+extern const struct requestQueue RequestQueue;
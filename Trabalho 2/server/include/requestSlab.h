@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+#define SLAB_NO_SLOT UINT32_MAX
+
+/**
+ * @brief Preallocated pool of request slots.
+ *
+ * The reader decodes each request straight into a free slot and passes its index through the
+ * RequestQueue; the office that handles it gives the slot back. Free slots are kept in a
+ * lock-free stack, so no request is ever malloc'd or copied after being read.
+ */
+struct requestSlab
+{
+	int (*init)(size_t count);
+	void (*destroy)(void);
+	uint32_t (*acquire)(void);
+	void (*release)(uint32_t slot);
+	tlv_request_t *(*get)(uint32_t slot);
+};
+
+extern const struct requestSlab RequestSlab;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+#define SHA256_BLOCK_LEN 64
+#define SHA256_DIGEST_LEN 32
+
+/**
+ * @brief Incremental SHA-256 state. Lives on the caller's stack, no allocations.
+ */
+typedef struct sha256
+{
+	uint32_t state[8];
+	uint64_t length;
+	uint8_t buffer[SHA256_BLOCK_LEN];
+	size_t used;
+} sha256_t;
+
+/**
+ * @brief Reset a SHA-256 state.
+ *
+ * @param ctx State to reset
+ */
+void sha256Init(sha256_t *ctx);
+
+/**
+ * @brief Feed bytes into a SHA-256 state.
+ *
+ * @param ctx State
+ * @param data Bytes to hash
+ * @param length Number of bytes
+ */
+void sha256Update(sha256_t *ctx, const void *data, size_t length);
+
+/**
+ * @brief Pad the message and write the final digest.
+ *
+ * @param ctx State (must be reset before being reused)
+ * @param digest Output digest
+ */
+void sha256Final(sha256_t *ctx, uint8_t digest[SHA256_DIGEST_LEN]);
+
+/**
+ * @brief Write a digest as lowercase hexadecimal, like sha256sum does.
+ *
+ * @param digest Digest to convert
+ * @param hex Output string (HASH_LEN characters plus '\0')
+ */
+void sha256Hex(const uint8_t digest[SHA256_DIGEST_LEN], char hex[HASH_LEN + 1]);
@@ -1,56 +1,250 @@
-#include <string.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "requestQueue.h"
-#include "constants.h"
 
-tlv_request_t* requestArray[MAX_BANK_OFFICES];
-int front = 0;
-int rear = -1;
-int itemCount = 0;
+/**
+ * @brief One ring cell. The sequence number tells producers and consumers whose turn it is:
+ * equal to the position when free, position + 1 once a request is stored.
+ */
+typedef struct requestCell
+{
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t sequence;
+	uint32_t slot;
+} request_cell_t;
+
+/**
+ * @brief Ring state. Positions and futex words sit on their own cache lines so that producers
+ * and consumers do not bounce the same line.
+ */
+static struct
+{
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t enqueuePos;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t dequeuePos;
+	_Alignas(CACHE_LINE_SIZE) atomic_uint pushes; // futex word, bumped after every push
+	atomic_uint popWaiters;
+	_Alignas(CACHE_LINE_SIZE) atomic_uint pops; // futex word, bumped after every pop
+	atomic_uint pushWaiters;
+	_Alignas(CACHE_LINE_SIZE) atomic_int closed;
+	request_cell_t *cells;
+	size_t capacity;
+	size_t mask;
+} ring;
+
+static void futexWait(atomic_uint *word, unsigned int value)
+{
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futexWake(atomic_uint *word, int count)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
 
-int isEmpty(void) { return (itemCount == 0) ? 1 : 0; }
+static int init(size_t capacity)
+{
+	// Power of two, and at least two cells: with one, "stored at pos" and "free at pos + 1" look the same
+	size_t cells = 2;
+	while (cells < capacity)
+		cells <<= 1;
+
+	ring.cells = aligned_alloc(CACHE_LINE_SIZE, cells * sizeof(request_cell_t));
+	if (ring.cells == NULL)
+		return -1;
 
-int isFull(void) { return (itemCount == MAX_BANK_OFFICES) ? 1 : 0; }
+	for (size_t i = 0; i < cells; i++)
+		atomic_init(&ring.cells[i].sequence, i);
 
-int size(void) { return itemCount; }
+	ring.capacity = cells;
+	ring.mask = cells - 1;
+	atomic_init(&ring.enqueuePos, 0);
+	atomic_init(&ring.dequeuePos, 0);
+	atomic_init(&ring.pushes, 0);
+	atomic_init(&ring.popWaiters, 0);
+	atomic_init(&ring.pops, 0);
+	atomic_init(&ring.pushWaiters, 0);
+	atomic_init(&ring.closed, 0);
 
-int push(tlv_request_t* request)
+	return 0;
+}
+
+static void destroy(void)
 {
-	if(isFull())
-		return -1;
+	free(ring.cells);
+	ring.cells = NULL;
+}
 
-	if(rear == MAX_BANK_OFFICES - 1)
-		rear = -1;
+static int size(void)
+{
+	size_t dequeuePos = atomic_load(&ring.dequeuePos);
+	size_t enqueuePos = atomic_load(&ring.enqueuePos);
+
+	return (enqueuePos > dequeuePos) ? (int)(enqueuePos - dequeuePos) : 0;
+}
+
+static int isEmpty(void) { return (size() == 0) ? 1 : 0; }
 
-	requestArray[++rear] = request;
+static int isFull(void) { return ((size_t)size() >= ring.capacity) ? 1 : 0; }
 
-	itemCount++;
+static size_t capacity(void) { return ring.capacity; }
 
-	return itemCount;
+static int tryPush(uint32_t slot)
+{
+	request_cell_t *cell;
+	size_t pos = atomic_load_explicit(&ring.enqueuePos, memory_order_relaxed);
+
+	while (1)
+	{
+		cell = &ring.cells[pos & ring.mask];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&ring.enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return -1; // Full
+		else
+			pos = atomic_load_explicit(&ring.enqueuePos, memory_order_relaxed);
+	}
+
+	cell->slot = slot;
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+	atomic_fetch_add(&ring.pushes, 1);
+	if (atomic_load(&ring.popWaiters) > 0)
+		futexWake(&ring.pushes, 1);
+
+	return 0;
 }
 
-int pop(tlv_request_t* request)
+static int tryPop(uint32_t *slot)
 {
-	if(isEmpty())
-		return -1;
+	request_cell_t *cell;
+	size_t pos = atomic_load_explicit(&ring.dequeuePos, memory_order_relaxed);
+
+	while (1)
+	{
+		cell = &ring.cells[pos & ring.mask];
+		size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&ring.dequeuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return -1; // Empty
+		else
+			pos = atomic_load_explicit(&ring.dequeuePos, memory_order_relaxed);
+	}
+
+	*slot = cell->slot;
+	atomic_store_explicit(&cell->sequence, pos + ring.mask + 1, memory_order_release);
+
+	atomic_fetch_add(&ring.pops, 1);
+	if (atomic_load(&ring.pushWaiters) > 0)
+		futexWake(&ring.pops, 1);
+
+	return 0;
+}
 
-	memcpy(request, requestArray[front], sizeof(tlv_request_t));
-	free(requestArray[front]);
-	front++;
+/**
+ * @brief Push a request slot, sleeping while the ring is full
+ *
+ * @return int 0 on success, -1 if the queue was closed
+ */
+static int push(uint32_t slot)
+{
+	while (1)
+	{
+		if (tryPush(slot) == 0)
+			return 0;
+
+		// Read the futex word before the last check so that a pop in between wakes us up
+		unsigned int pops = atomic_load(&ring.pops);
+		atomic_fetch_add(&ring.pushWaiters, 1);
+
+		if (tryPush(slot) == 0)
+		{
+			atomic_fetch_sub(&ring.pushWaiters, 1);
+			return 0;
+		}
+
+		if (atomic_load(&ring.closed))
+		{
+			atomic_fetch_sub(&ring.pushWaiters, 1);
+			return -1;
+		}
+
+		futexWait(&ring.pops, pops);
+		atomic_fetch_sub(&ring.pushWaiters, 1);
+	}
+}
+
+/**
+ * @brief Pop a request slot, sleeping while the ring is empty
+ *
+ * @return int 0 on success, -1 once the queue is closed and drained
+ */
+static int pop(uint32_t *slot)
+{
+	while (1)
+	{
+		if (tryPop(slot) == 0)
+			return 0;
+
+		unsigned int pushes = atomic_load(&ring.pushes);
+		atomic_fetch_add(&ring.popWaiters, 1);
+
+		if (tryPop(slot) == 0)
+		{
+			atomic_fetch_sub(&ring.popWaiters, 1);
+			return 0;
+		}
+
+		if (atomic_load(&ring.closed))
+		{
+			atomic_fetch_sub(&ring.popWaiters, 1);
+			return -1;
+		}
+
+		futexWait(&ring.pushes, pushes);
+		atomic_fetch_sub(&ring.popWaiters, 1);
+	}
+}
 
-	if(front == MAX_BANK_OFFICES)
-		front = 0;
+/**
+ * @brief Wake every sleeping thread; pop() returns -1 once the remaining requests are taken
+ */
+static void closeQueue(void)
+{
+	atomic_store(&ring.closed, 1);
 
-	itemCount--;
+	atomic_fetch_add(&ring.pushes, 1);
+	futexWake(&ring.pushes, INT_MAX);
 
-	return itemCount;
+	atomic_fetch_add(&ring.pops, 1);
+	futexWake(&ring.pops, INT_MAX);
 }
 
 const struct requestQueue RequestQueue = {
-    .isEmpty = isEmpty,
-    .isFull = isFull,
-    .size = size,
-    .push = push,
-    .pop = pop
-};
\ No newline at end of file
+	.init = init,
+	.destroy = destroy,
+	.isEmpty = isEmpty,
+	.isFull = isFull,
+	.size = size,
+	.capacity = capacity,
+	.tryPush = tryPush,
+	.tryPop = tryPop,
+	.push = push,
+	.pop = pop,
+	.close = closeQueue};
@@ -0,0 +1,104 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "requestSlab.h"
+
+/**
+ * @brief One slot per cache line, so offices working on neighbouring slots do not share lines
+ */
+typedef struct requestSlot
+{
+	_Alignas(CACHE_LINE_SIZE) tlv_request_t request;
+} request_slot_t;
+
+/**
+ * @brief Slots plus the free stack. The head packs the top slot index (low 32 bits) with a
+ * counter (high 32 bits) bumped on every change, so a stale compare-and-swap cannot succeed (ABA).
+ */
+static struct
+{
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+	_Atomic uint32_t *next;
+	request_slot_t *slots;
+} slab;
+
+static uint64_t packHead(uint64_t head, uint32_t slot)
+{
+	return (((head >> 32) + 1) << 32) | slot;
+}
+
+static int init(size_t count)
+{
+	if (count == 0 || count >= SLAB_NO_SLOT)
+		return -1;
+
+	slab.slots = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(request_slot_t));
+	slab.next = malloc(count * sizeof(*slab.next));
+	if (slab.slots == NULL || slab.next == NULL)
+	{
+		free(slab.slots);
+		free(slab.next);
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		atomic_init(&slab.next[i], (i + 1 < count) ? (uint32_t)(i + 1) : SLAB_NO_SLOT);
+
+	atomic_init(&slab.head, 0);
+
+	return 0;
+}
+
+static void destroy(void)
+{
+	free(slab.slots);
+	free((void *)slab.next);
+	slab.slots = NULL;
+	slab.next = NULL;
+}
+
+/**
+ * @brief Take a free slot
+ *
+ * @return uint32_t Slot index, SLAB_NO_SLOT if all are in use
+ */
+static uint32_t acquire(void)
+{
+	uint64_t head = atomic_load_explicit(&slab.head, memory_order_acquire);
+	uint32_t slot;
+
+	do
+	{
+		slot = (uint32_t)head;
+		if (slot == SLAB_NO_SLOT)
+			return SLAB_NO_SLOT;
+	} while (!atomic_compare_exchange_weak_explicit(&slab.head, &head, packHead(head, atomic_load_explicit(&slab.next[slot], memory_order_relaxed)),
+													memory_order_acquire, memory_order_acquire));
+
+	return slot;
+}
+
+/**
+ * @brief Give a slot back to the free stack
+ */
+static void release(uint32_t slot)
+{
+	uint64_t head = atomic_load_explicit(&slab.head, memory_order_relaxed);
+
+	do
+	{
+		atomic_store_explicit(&slab.next[slot], (uint32_t)head, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak_explicit(&slab.head, &head, packHead(head, slot), memory_order_release, memory_order_relaxed));
+}
+
+static tlv_request_t *get(uint32_t slot)
+{
+	return &slab.slots[slot].request;
+}
+
+const struct requestSlab RequestSlab = {
+	.init = init,
+	.destroy = destroy,
+	.acquire = acquire,
+	.release = release,
+	.get = get};
@@ -1,7 +1,6 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,26 +9,28 @@
 
 #include "sope.h"
 #include "requestQueue.h"
+#include "requestSlab.h"
+#include "sha256.h"
 
-sem_t empty, full;
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 int fd_main_log, fd_server_fifo, fd_user_fifo;
 
 bank_office_t *officesArray[MAX_BANK_OFFICES] = {NULL};
 bank_account_t *accountsArray[MAX_BANK_ACCOUNTS] = {NULL};
 
 int shutdownSignal = 0;
-int shutdownReady = 0;
 
-int workingThreads;
-pthread_mutex_t cleanMutex = PTHREAD_MUTEX_INITIALIZER;
+// Log the request queue operations (SERVER_SYNC_LOG=1); off by default as it costs a write per operation
+int syncLog = 0;
+
+// Requests are answered with RC_SRV_BUSY once this many are waiting (SERVER_QUEUE_HIGH_WATERMARK)
+size_t queueHighWatermark;
 
 /**
  * @brief Function to generate the unique salt of each account based on pid, time and random hexadecimal characters
  * 
  * @param salt char array to be filled with salt
  */
-void generateUniqueSalt(char salt[SALT_LEN])
+void generateUniqueSalt(char salt[SALT_LEN + 1])
 {
 	time_t seconds;
 	seconds = time(NULL);
@@ -48,7 +49,12 @@ void generateUniqueSalt(char salt[SALT_LEN])
 	for (size_t i = 0; i < length; i++)
 		randHex[i] = str[rand() % 16];
 
-	snprintf(salt, SALT_LEN + 1, "%s%s%s", pid, randHex, sec);
+	// pid + randHex + sec add up to exactly SALT_LEN characters
+	size_t pidLength = strlen(pid);
+	memcpy(salt, pid, pidLength);
+	memcpy(salt + pidLength, randHex, length);
+	memcpy(salt + pidLength + length, sec, strlen(sec));
+	salt[SALT_LEN] = '\0';
 }
 
 /**
@@ -59,25 +65,18 @@ void generateUniqueSalt(char salt[SALT_LEN])
  * @param hash output hash string
  * @return ret_code_t RC_OK if success, RC_OTHER otherwise
  */
-ret_code_t cmd_sha256sum(const char *password, const char *salt, char hash[HASH_LEN])
+ret_code_t cmd_sha256sum(const char *password, const char *salt, char hash[HASH_LEN + 1])
 {
-	char command[MAX_PASSWORD_LEN + SALT_LEN + 31];
-	sprintf(command, "echo -n \"%s%s\" | sha256sum", password, salt);
+	// Same digest as "echo -n password+salt | sha256sum", computed in-process
+	sha256_t ctx;
+	uint8_t digest[SHA256_DIGEST_LEN];
 
-	// Run command
-	FILE *fp;
-	fp = popen(command, "r");
-	if (fp == NULL)
-	{
-		printf("Failed to run command\n");
-		return RC_OTHER;
-	}
+	sha256Init(&ctx);
+	sha256Update(&ctx, password, strlen(password));
+	sha256Update(&ctx, salt, strlen(salt));
+	sha256Final(&ctx, digest);
 
-	// Read command output
-	fgets(hash, HASH_LEN + 1, fp);
-
-	// Close pipe
-	pclose(fp);
+	sha256Hex(digest, hash);
 
 	return RC_OK;
 }
@@ -113,29 +112,30 @@ void createAccount(const uint32_t account_id, const uint32_t balance, const char
 }
 
 /**
- * @brief Start semaphores
+ * @brief Create the request queue and the slots the requests are read into
  * 
- * @param semSize Empty semaphore value
- * @return ret_code_t RC_OK if semaphores are created with success, RC_OTHER otherwise
+ * @param capacity Number of requests that can wait for a bank office
+ * @param officesCount Number of bank offices, each holding a slot while it works
+ * @return ret_code_t RC_OK if the queue is created with success, RC_OTHER otherwise
  */
-ret_code_t createSyncMechSem(size_t semSize)
+ret_code_t createRequestQueue(size_t capacity, size_t officesCount)
 {
-	logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_INIT, SYNC_ROLE_PRODUCER, 0, semSize);
-	if (sem_init(&empty, 0, semSize) == -1)
+	if (syncLog)
+		logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_INIT, SYNC_ROLE_PRODUCER, 0, capacity);
+
+	if (RequestQueue.init(capacity) == -1)
 	{
-		perror("createSyncMechSem - sem_init");
+		perror("createRequestQueue - init");
 		return RC_OTHER;
 	}
 
-	logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_INIT, SYNC_ROLE_PRODUCER, 0, 0);
-	if (sem_init(&full, 0, 0) == -1)
+	// Queued requests, the ones being handled and the one being read: the reader never runs out
+	if (RequestSlab.init(RequestQueue.capacity() + officesCount + 1) == -1)
 	{
-		perror("createSyncMechSem - sem_init");
+		perror("createRequestQueue - slab init");
 		return RC_OTHER;
 	}
 
-	workingThreads = semSize;
-
 	return RC_OK;
 }
 
@@ -247,7 +247,7 @@ ret_code_t validateShutdown(int *val, uint32_t delay, int fd, int id)
 	fchmod(fd_server_fifo, 0444);
 	shutdownSignal = 1;
 
-	sem_getvalue(&full, val);
+	*val = RequestQueue.size();
 
 	return RC_OK;
 }
@@ -295,78 +295,76 @@ ret_code_t validateRequest(const tlv_request_t *request, int id, int *val, int f
 	return ret;
 }
 
-void *officeWorker(void *arg)
+/**
+ * @brief Send the reply to a request through the user's FIFO and log it
+ * 
+ * @param request Request being answered
+ * @param ret Reply return code
+ * @param ret_value Extra value argument (except for create)
+ * @param fd Log file descriptor
+ * @param id Bank office/main thread ID
+ */
+void sendReply(const tlv_request_t *request, ret_code_t ret, int ret_value, int fd, int id)
 {
-	int fd_log_file = open(SERVER_LOGFILE, O_WRONLY | O_APPEND);
 	char reply_FIFO[USER_FIFO_PATH_LEN];
-	int id = *(int *)arg;
-
-	int sval = 0;
+	tlv_reply_t reply;
 
-	logBankOfficeOpen(fd_log_file, id, pthread_self());
-
-	while (1)
+	sprintf(reply_FIFO, "%s%0*d", USER_FIFO_PATH_PREFIX, WIDTH_ID, request->value.header.pid);
+	int fd_user_fifo = open(reply_FIFO, O_WRONLY | O_NONBLOCK);
+	if (fd_user_fifo == -1)
 	{
-		sem_getvalue(&full, &sval);
-		logSyncMechSem(fd_log_file, id, SYNC_OP_SEM_WAIT, SYNC_ROLE_CONSUMER, 0, sval);
-		sem_wait(&full);
+		fprintf(stderr, "PID %d : Request timeout!\n", request->value.header.pid);
+		ret = RC_USR_DOWN;
+		ret_value = 0;
+	}
 
-		if (shutdownReady == 1)
-			break;
+	prepareReply(&reply, request, ret, ret_value);
 
-		logSyncMech(fd_log_file, id, SYNC_OP_MUTEX_LOCK, SYNC_ROLE_CONSUMER, 0);
-		pthread_mutex_lock(&mutex);
-		tlv_request_t request;
-		RequestQueue.pop(&request);
+	if (ret != RC_USR_DOWN && write(fd_user_fifo, &reply, sizeof(tlv_reply_t)) == -1)
+	{
+		perror("write:");
+	}
 
-		msleep(request.value.header.op_delay_ms);
-		logSyncDelay(fd_log_file, id, request.value.header.account_id, request.value.header.op_delay_ms);
+	logReply(fd, id, &reply);
+	logReply(STDOUT_FILENO, id, &reply);
 
-		pthread_mutex_unlock(&mutex);
-		logSyncMech(fd_log_file, id, SYNC_OP_MUTEX_UNLOCK, SYNC_ROLE_CONSUMER, request.value.header.pid);
+	if (close(fd_user_fifo) == -1 && errno != EBADF)
+		perror("sendReply - Failed to close user fifo");
+}
 
-		sem_post(&empty);
-		sem_getvalue(&empty, &sval);
-		logSyncMechSem(fd_log_file, id, SYNC_OP_SEM_POST, SYNC_ROLE_CONSUMER, request.value.header.pid, sval);
+void *officeWorker(void *arg)
+{
+	int fd_log_file = open(SERVER_LOGFILE, O_WRONLY | O_APPEND);
+	int id = *(int *)arg;
 
-		logRequest(fd_log_file, id, &request);
-		logRequest(STDOUT_FILENO, id, &request);
+	logBankOfficeOpen(fd_log_file, id, pthread_self());
 
-		int ret_value = 0;
-		ret_code_t ret = validateRequest(&request, id, &ret_value, fd_log_file);
+	while (1)
+	{
+		if (syncLog)
+			logSyncMechSem(fd_log_file, id, SYNC_OP_SEM_WAIT, SYNC_ROLE_CONSUMER, 0, RequestQueue.size());
 
-		tlv_reply_t reply;
+		// Sleeps only while the queue is empty; fails once it is closed and drained
+		uint32_t slot;
+		if (RequestQueue.pop(&slot) == -1)
+			break;
 
-		sprintf(reply_FIFO, "%s%0*d", USER_FIFO_PATH_PREFIX, WIDTH_ID, request.value.header.pid);
-		int fd_user_fifo = open(reply_FIFO, O_WRONLY | O_NONBLOCK);
-		if (fd_user_fifo == -1)
-		{
-			fprintf(stderr, "PID %d : Request timeout!\n", request.value.header.pid);
-			ret = RC_USR_DOWN;
-			ret_value = 0;
-		}
+		const tlv_request_t *request = RequestSlab.get(slot);
 
-		prepareReply(&reply, &request, ret, ret_value);
+		if (syncLog)
+			logSyncMechSem(fd_log_file, id, SYNC_OP_SEM_POST, SYNC_ROLE_CONSUMER, request->value.header.pid, RequestQueue.size());
 
-		if (ret != RC_USR_DOWN && write(fd_user_fifo, &reply, sizeof(tlv_reply_t)) == -1)
-		{
-			perror("write:");
-		}
+		logRequest(fd_log_file, id, request);
+		logRequest(STDOUT_FILENO, id, request);
 
-		logReply(fd_log_file, id, &reply);
-		logReply(STDOUT_FILENO, id, &reply);
+		int ret_value = 0;
+		ret_code_t ret = validateRequest(request, id, &ret_value, fd_log_file);
 
-		if (close(fd_user_fifo) == -1 && errno != EBADF)
-			perror("officeWorker - Failed to close user fifo");
+		sendReply(request, ret, ret_value, fd_log_file, id);
 
-		if (shutdownReady == 1)
-			break;
+		RequestSlab.release(slot);
 	}
 
-	pthread_mutex_lock(&cleanMutex);
-	workingThreads--;
-	pthread_mutex_unlock(&cleanMutex);
-
 	logBankOfficeClose(fd_log_file, id, pthread_self());
 	pthread_exit(0);
 }
@@ -411,20 +409,26 @@ ret_code_t prepareRequestFIFO()
 
 void listenForRequests()
 {
-	int val = 0;
 	ssize_t readbytes = 0;
-	tlv_request_t request;
+	uint32_t slot = SLAB_NO_SLOT;
+	tlv_request_t *request = NULL;
 
 	while (1)
 	{
-		readbytes = read(fd_server_fifo, &(request.type), sizeof(request.type));
+		// Requests are decoded straight into a free slot, which is only replaced once queued
+		if (slot == SLAB_NO_SLOT)
+		{
+			slot = RequestSlab.acquire();
+			if (slot == SLAB_NO_SLOT)
+				continue;
+			request = RequestSlab.get(slot);
+		}
+
+		readbytes = read(fd_server_fifo, &(request->type), sizeof(request->type));
 		if (readbytes == 0)
 		{
 			if (shutdownSignal == 1 && RequestQueue.isEmpty())
-			{
-				shutdownReady = 1;
 				break;
-			}
 		}
 		else if (readbytes < 0)
 		{
@@ -433,51 +437,45 @@ void listenForRequests()
 		}
 		else
 		{
-			if(request.type >= __OP_MAX_NUMBER || request.type < 0)
+			if(request->type >= __OP_MAX_NUMBER || request->type < 0)
 			{
-				fprintf(stderr, "%d\n", request.type);
+				fprintf(stderr, "%d\n", request->type);
 				continue;
 			}
 			
-			readbytes = read(fd_server_fifo, &(request.length), sizeof(request.length));
-			if(request.length > sizeof(request.value) || request.length < sizeof(request.value.header))
+			readbytes = read(fd_server_fifo, &(request->length), sizeof(request->length));
+			if(request->length > sizeof(request->value) || request->length < sizeof(request->value.header))
 			{
-				fprintf(stderr, "%d\n", request.length);
+				fprintf(stderr, "%d\n", request->length);
 				continue;
 			}
 
-			readbytes = read(fd_server_fifo, &(request.value), request.length);
-			if(readbytes != request.length)
+			readbytes = read(fd_server_fifo, &(request->value), request->length);
+			if(readbytes != request->length)
 			{
 				fprintf(stderr, "%ld\n", readbytes);
-				fprintf(stderr, "%d\n", request.length);
+				fprintf(stderr, "%d\n", request->length);
 				continue;
 			}
 
-			tlv_request_t *new_request = malloc(sizeof(tlv_request_t));
-			memcpy(new_request, &request, sizeof(tlv_request_t));
+			logRequest(fd_main_log, MAIN_THREAD_ID, request);
 
-			logRequest(fd_main_log, MAIN_THREAD_ID, &request);
+			// Too many requests waiting: answer now so the user can retry instead of timing out
+			if ((size_t)RequestQueue.size() >= queueHighWatermark)
+			{
+				sendReply(request, RC_SRV_BUSY, 0, fd_main_log, MAIN_THREAD_ID);
+				continue;
+			}
 
 			// PRODUCE REQUEST
-			sem_getvalue(&empty, &val);
-			logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_WAIT, SYNC_ROLE_PRODUCER, request.value.header.pid, val);
-			// Wait if threads are all busy doing work
-			sem_wait(&empty);
-			// Try to get lock for mutex
-			pthread_mutex_lock(&mutex);
-			logSyncMech(fd_main_log, MAIN_THREAD_ID, SYNC_OP_MUTEX_LOCK, SYNC_ROLE_PRODUCER, request.value.header.pid);
-			msleep(new_request->value.header.op_delay_ms);
-			logSyncDelay(fd_main_log, MAIN_THREAD_ID, new_request->value.header.account_id, new_request->value.header.op_delay_ms);
-			// Enqueue request
-			RequestQueue.push(new_request);
-			// Release lock
-			pthread_mutex_unlock(&mutex);
-			logSyncMech(fd_main_log, MAIN_THREAD_ID, SYNC_OP_MUTEX_UNLOCK, SYNC_ROLE_PRODUCER, request.value.header.pid);
-			// Signal idle threads that there is work to be done
-			sem_post(&full);
-			sem_getvalue(&full, &val);
-			logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_POST, SYNC_ROLE_PRODUCER, request.value.header.pid, val);
+			if (syncLog)
+				logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_WAIT, SYNC_ROLE_PRODUCER, request->value.header.pid, RequestQueue.size());
+			// Hand the slot over; waits only if the ring is full
+			RequestQueue.push(slot);
+			if (syncLog)
+				logSyncMechSem(fd_main_log, MAIN_THREAD_ID, SYNC_OP_SEM_POST, SYNC_ROLE_PRODUCER, request->value.header.pid, RequestQueue.size());
+
+			slot = SLAB_NO_SLOT;
 		}
 		
 
@@ -534,10 +532,24 @@ int main(int argc, char *argv[])
 	if (verifyStringContainsWhitespaces(password))
 		return return_error(RC_BAD_REQ_ARGS, "USAGE: Password must NOT contain whitespace caracters\n");
 
+	const char *syncLogEnv = getenv("SERVER_SYNC_LOG");
+	syncLog = (syncLogEnv != NULL && strcmp(syncLogEnv, "1") == 0);
+
+	unsigned queueDepth = DEFAULT_QUEUE_DEPTH;
+	const char *queueDepthEnv = getenv("SERVER_QUEUE_DEPTH");
+	if (queueDepthEnv != NULL && verifyUnsignedArg(&queueDepth, queueDepthEnv, 1, MAX_QUEUE_DEPTH) == -1)
+		return return_error(RC_BAD_REQ_ARGS, "USAGE: SERVER_QUEUE_DEPTH must be between [1, %d]\n", MAX_QUEUE_DEPTH);
+
+	unsigned highWatermark = queueDepth;
+	const char *highWatermarkEnv = getenv("SERVER_QUEUE_HIGH_WATERMARK");
+	if (highWatermarkEnv != NULL && verifyUnsignedArg(&highWatermark, highWatermarkEnv, 1, queueDepth) == -1)
+		return return_error(RC_BAD_REQ_ARGS, "USAGE: SERVER_QUEUE_HIGH_WATERMARK must be between [1, %u]\n", queueDepth);
+	queueHighWatermark = highWatermark;
+
 	openLog(&fd_main_log, SERVER_LOGFILE, O_WRONLY | O_APPEND | O_CREAT, 0775, "Server Started");
 
-	// Create semaphores
-	if (createSyncMechSem(bank_offices) != RC_OK)
+	// Create request queue
+	if (createRequestQueue(queueDepth, bank_offices) != RC_OK)
 		return RC_OTHER;
 
 	// Create bank offices
@@ -557,16 +569,16 @@ int main(int argc, char *argv[])
 	// Return upon receiving shutdown operation and RequestQueue is empty
 	listenForRequests();
 
-	// Threads will exit their loop when shutdown is occuring and their work is finished
-	// Some threads are locked with sem_wait() so post to awake them
-	while (workingThreads > 0)
-	{
-		sem_post(&full);
-	}
+	// Threads will exit their loop once the queue is closed and drained
+	// Closing also wakes the ones sleeping on an empty queue
+	RequestQueue.close();
+
+	for (size_t i = 0; i < bank_offices; i++)
+		pthread_join(officesArray[i]->office_thread, NULL);
 
 	// Cleanup
-	sem_destroy(&empty);
-	sem_destroy(&full);
+	RequestQueue.destroy();
+	RequestSlab.destroy();
 
 	for (size_t i = 0; i < MAX_BANK_ACCOUNTS; i++)
 		if(accountsArray[i] != NULL)
@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_HAS_SHANI_PATH 1
+#endif
+
+#include "sha256.h"
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t H0[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+typedef void (*sha256_blocks_t)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+static sha256_blocks_t compressBlocks;
+static pthread_once_t compressOnce = PTHREAD_ONCE_INIT;
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * @brief Portable compression function (FIPS 180-4)
+ */
+static void sha256BlocksGeneric(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	uint32_t w[64];
+
+	for (; blocks > 0; blocks--, data += SHA256_BLOCK_LEN)
+	{
+		for (int i = 0; i < 16; i++)
+			w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 | (uint32_t)data[4 * i + 2] << 8 | data[4 * i + 3];
+
+		for (int i = 16; i < 64; i++)
+		{
+			uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int i = 0; i < 64; i++)
+		{
+			uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+			uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#ifdef SHA256_HAS_SHANI_PATH
+/**
+ * @brief Compression function using the x86 SHA extensions (two rounds per sha256rnds2)
+ */
+__attribute__((target("sha,ssse3,sse4.1"))) static void sha256BlocksShaNi(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// The instructions want the state as ABEF / CDGH
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+	__m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+	__m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+	for (; blocks > 0; blocks--, data += SHA256_BLOCK_LEN)
+	{
+		__m128i abefSave = abef, cdghSave = cdgh;
+		__m128i msg[4];
+
+		for (int i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwap);
+
+		// Four rounds per iteration; msg[] holds the message schedule as a sliding window of 16 words
+		for (int r = 0; r < 16; r++)
+		{
+			__m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i *)&K[4 * r]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+
+			if (r >= 3 && r < 15)
+			{
+				tmp = _mm_alignr_epi8(msg[r & 3], msg[(r - 1) & 3], 4);
+				msg[(r + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(msg[(r + 1) & 3], tmp), msg[r & 3]);
+			}
+
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+
+			if (r >= 1 && r < 13)
+				msg[(r - 1) & 3] = _mm_sha256msg1_epu32(msg[(r - 1) & 3], msg[r & 3]);
+		}
+
+		abef = _mm_add_epi32(abef, abefSave);
+		cdgh = _mm_add_epi32(cdgh, cdghSave);
+	}
+
+	// Back to ABCD / EFGH
+	tmp = _mm_shuffle_epi32(abef, 0x1B);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xF0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+/**
+ * @brief Check CPUID for the SHA extensions and the SSE levels the accelerated path uses
+ */
+static int cpuHasShaNi()
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+		return 0;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	return (ebx & bit_SHA) != 0;
+}
+#endif
+
+static void selectCompressBlocks()
+{
+	compressBlocks = sha256BlocksGeneric;
+
+#ifdef SHA256_HAS_SHANI_PATH
+	if (cpuHasShaNi())
+		compressBlocks = sha256BlocksShaNi;
+#endif
+}
+
+void sha256Init(sha256_t *ctx)
+{
+	pthread_once(&compressOnce, selectCompressBlocks);
+
+	memcpy(ctx->state, H0, sizeof(H0));
+	ctx->length = 0;
+	ctx->used = 0;
+}
+
+void sha256Update(sha256_t *ctx, const void *data, size_t length)
+{
+	const uint8_t *bytes = data;
+	ctx->length += length;
+
+	if (ctx->used > 0)
+	{
+		size_t fill = SHA256_BLOCK_LEN - ctx->used;
+		if (length < fill)
+		{
+			memcpy(ctx->buffer + ctx->used, bytes, length);
+			ctx->used += length;
+			return;
+		}
+
+		memcpy(ctx->buffer + ctx->used, bytes, fill);
+		compressBlocks(ctx->state, ctx->buffer, 1);
+		bytes += fill;
+		length -= fill;
+		ctx->used = 0;
+	}
+
+	if (length >= SHA256_BLOCK_LEN)
+	{
+		compressBlocks(ctx->state, bytes, length / SHA256_BLOCK_LEN);
+		bytes += length - length % SHA256_BLOCK_LEN;
+		length %= SHA256_BLOCK_LEN;
+	}
+
+	memcpy(ctx->buffer, bytes, length);
+	ctx->used = length;
+}
+
+void sha256Final(sha256_t *ctx, uint8_t digest[SHA256_DIGEST_LEN])
+{
+	uint64_t bits = ctx->length * 8;
+
+	ctx->buffer[ctx->used++] = 0x80;
+	if (ctx->used > SHA256_BLOCK_LEN - 8)
+	{
+		memset(ctx->buffer + ctx->used, 0, SHA256_BLOCK_LEN - ctx->used);
+		compressBlocks(ctx->state, ctx->buffer, 1);
+		ctx->used = 0;
+	}
+	memset(ctx->buffer + ctx->used, 0, SHA256_BLOCK_LEN - 8 - ctx->used);
+
+	for (int i = 0; i < 8; i++)
+		ctx->buffer[SHA256_BLOCK_LEN - 1 - i] = (uint8_t)(bits >> (8 * i));
+	compressBlocks(ctx->state, ctx->buffer, 1);
+
+	for (int i = 0; i < 8; i++)
+	{
+		digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+		digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+		digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+		digest[4 * i + 3] = (uint8_t)ctx->state[i];
+	}
+}
+
+void sha256Hex(const uint8_t digest[SHA256_DIGEST_LEN], char hex[HASH_LEN + 1])
+{
+	static const char digits[] = "0123456789abcdef";
+
+	for (int i = 0; i < SHA256_DIGEST_LEN; i++)
+	{
+		hex[2 * i] = digits[digest[i] >> 4];
+		hex[2 * i + 1] = digits[digest[i] & 0x0f];
+	}
+	hex[HASH_LEN] = '\0';
+}
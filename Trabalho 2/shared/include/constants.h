@@ -1,6 +1,8 @@
 #pragma once
 
 #define MAX_BANK_OFFICES 99
+#define DEFAULT_QUEUE_DEPTH 1024
+#define MAX_QUEUE_DEPTH 65536
 #define MAX_BANK_ACCOUNTS 4096
 #define MIN_BALANCE 1UL
 #define MAX_BALANCE 1000000000UL
@@ -36,4 +38,6 @@
 #define SERVER_EXPECTED_ARGC 3
 #define USER_EXPECTED_ARGC 6
 
-#define FORMAT_TEMP_BUFFER 32
\ No newline at end of file
+#define FORMAT_TEMP_BUFFER 32
+
+#define CACHE_LINE_SIZE 64
\ No newline at end of file
@@ -32,6 +32,7 @@ typedef enum ret_code
 	RC_TOO_HIGH,	 // final balance would be to high (greater than MAX_BALANCE)
 	RC_BAD_REQ_ARGS, // the request's arguments are malformed
 	RC_OTHER,		 // any other error code that is not defined
+	RC_SRV_BUSY,	 // the server has too many pending requests, try again later
 	__RC_MAX_NUMBER  // enables to determine how many return codes are defined
 } ret_code_t;
 
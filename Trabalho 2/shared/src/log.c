@@ -34,7 +34,8 @@ static const char *RC_STR[] = {
 	[RC_NO_FUNDS] = "NO_FUNDS",
 	[RC_TOO_HIGH] = "TOO_HIGH",
 	[RC_BAD_REQ_ARGS] = "BAD_REQ_ARGS",
-	[RC_OTHER] = "OTHER"};
+	[RC_OTHER] = "OTHER",
+	[RC_SRV_BUSY] = "SRV_BUSY"};
 
 static const char *SYNC_MECH_STR[] = {
 	[SYNC_OP_MUTEX_LOCK] = "MUTEX_LOCK",